@@ -0,0 +1,56 @@
+#include "shader.hlsl"
+
+cbuffer UniformBuffer : register(b0, space3)
+{
+    float3 PlayerPosition : packoffset(c0);
+};
+
+cbuffer UniformBuffer : register(b1, space3)
+{
+    float4 Sun : packoffset(c0);
+    float4 SkyTop : packoffset(c1);
+    float4 SkyHorizon : packoffset(c2);
+    float4 Ambient : packoffset(c3);
+};
+
+static const float3 kCloudColor = float3(1.0f, 1.0f, 1.0f);
+
+struct Input
+{
+    float4 Fragment : SV_Position;
+    float4 WorldPosition : TEXCOORD0;
+    nointerpolation float3 Normal : TEXCOORD1;
+};
+
+#ifdef GBUFFER
+struct Output
+{
+    float4 Albedo : SV_Target0;
+    float Depth : SV_Target1;
+    float4 Normal : SV_Target2;
+    float4 Light : SV_Target3;
+};
+#else
+struct Output
+{
+    float4 Color : SV_Target0;
+    float Depth : SV_Target1;
+};
+#endif
+
+Output main(Input input)
+{
+    Output output;
+    output.Depth = input.Fragment.z;
+#ifdef GBUFFER
+    output.Albedo = float4(kCloudColor, 1.0f);
+    output.Normal = float4(input.Normal * 0.5f + 0.5f, 1.0f);
+    output.Light = float4(0.0f, 0.0f, 0.0f, 1.0f);
+#else
+    float sunlight = GetSunlight(Sun.xyz, Sun.w, input.Normal, kBlockCloud);
+    float3 sky = GetSky(input.WorldPosition.xyz - PlayerPosition, SkyTop.xyz, SkyHorizon.xyz);
+    float fog = GetFog(distance(input.WorldPosition.xz, PlayerPosition.xz));
+    output.Color = float4(lerp(kCloudColor * (Ambient.xyz + sunlight), sky, fog), 1.0f);
+#endif
+    return output;
+}
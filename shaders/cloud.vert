@@ -0,0 +1,49 @@
+#include "shader.hlsl"
+
+cbuffer UniformBuffer : register(b0, space1)
+{
+    float4x4 Proj : packoffset(c0);
+};
+
+cbuffer UniformBuffer : register(b1, space1)
+{
+    float4x4 View : packoffset(c0);
+};
+
+static const float kCloudHeight = 155.0f;
+
+// matches the face order of kCubeIndices
+static const float3 kCloudNormals[6] =
+{
+    float3( 0.0f, 0.0f,-1.0f ),
+    float3( 0.0f, 0.0f, 1.0f ),
+    float3(-1.0f, 0.0f, 0.0f ),
+    float3( 1.0f, 0.0f, 0.0f ),
+    float3( 0.0f, 1.0f, 0.0f ),
+    float3( 0.0f,-1.0f, 0.0f ),
+};
+
+struct Input
+{
+    int4 Cloud : TEXCOORD0;
+};
+
+struct Output
+{
+    float4 Position : SV_Position;
+    float4 WorldPosition : TEXCOORD0;
+    nointerpolation float3 Normal : TEXCOORD1;
+};
+
+Output main(Input input, uint vertexID : SV_VertexID)
+{
+    Output output;
+    float3 size = float3(input.Cloud.z, input.Cloud.w * 2 + 1, 1.0f);
+    float3 origin = float3(input.Cloud.x, kCloudHeight - input.Cloud.w, input.Cloud.y);
+    output.WorldPosition.xyz = (GetCubePosition(vertexID) + 0.5f) * size + origin;
+    output.Position = mul(View, float4(output.WorldPosition.xyz, 1.0f));
+    output.WorldPosition.w = output.Position.z;
+    output.Position = mul(Proj, output.Position);
+    output.Normal = kCloudNormals[vertexID / 6];
+    return output;
+}
@@ -0,0 +1,45 @@
+#include "shader.hlsl"
+
+Texture2D<float4> albedoTexture : register(t0, space2);
+SamplerState albedoSampler : register(s0, space2);
+Texture2D<float> depthTexture : register(t1, space2);
+SamplerState depthSampler : register(s1, space2);
+Texture2D<float4> normalTexture : register(t2, space2);
+SamplerState normalSampler : register(s2, space2);
+Texture2D<float4> lightTexture : register(t3, space2);
+SamplerState lightSampler : register(s3, space2);
+
+cbuffer UniformBuffer : register(b0, space3)
+{
+    float3 PlayerPosition : packoffset(c0);
+    float4x4 InverseMatrix : packoffset(c1);
+};
+
+cbuffer UniformBuffer : register(b1, space3)
+{
+    float4 Sun : packoffset(c0);
+    float4 SkyTop : packoffset(c1);
+    float4 SkyHorizon : packoffset(c2);
+    float4 Ambient : packoffset(c3);
+};
+
+float4 main(float4 fragment : SV_Position) : SV_Target0
+{
+    int3 pixel = int3(fragment.xy, 0);
+    float4 albedo = albedoTexture.Load(pixel);
+    float depth = depthTexture.Load(pixel);
+    if (depth >= 1.0f)
+    {
+        return albedo;
+    }
+    float2 size;
+    depthTexture.GetDimensions(size.x, size.y);
+    float3 position = GetWorldPosition(InverseMatrix, fragment.xy / size, depth);
+    float4 normal = normalTexture.Load(pixel);
+    float4 light = lightTexture.Load(pixel);
+    normal.xyz = normalize(normal.xyz * 2.0f - 1.0f);
+    float sunlight = GetSunlight(Sun.xyz, Sun.w, normal.xyz, normal.w > 0.5f ? kBlockCloud : 0);
+    float3 sky = GetSky(position - PlayerPosition, SkyTop.xyz, SkyHorizon.xyz);
+    float fog = GetFog(distance(position.xz, PlayerPosition.xz));
+    return float4(lerp(albedo.rgb * (light.rgb + Ambient.xyz * light.a + sunlight), sky, fog), 1.0f);
+}
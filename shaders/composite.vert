@@ -0,0 +1,12 @@
+struct Output
+{
+    float4 Position : SV_Position;
+};
+
+Output main(uint vertexID : SV_VertexID)
+{
+    Output output;
+    float2 texcoord = float2((vertexID << 1) & 2, vertexID & 2);
+    output.Position = float4(texcoord * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f), 0.0f, 1.0f);
+    return output;
+}
@@ -0,0 +1,28 @@
+#include "shader.hlsl"
+
+Texture2DArray<float4> atlasTexture : register(t0, space2);
+SamplerState atlasSampler : register(s0, space2);
+StructuredBuffer<Material> materialBuffer : register(t1, space2);
+
+struct Input
+{
+    float4 Fragment : SV_Position;
+    float4 WorldPosition : TEXCOORD0;
+    float2 Texcoord : TEXCOORD1;
+    nointerpolation uint Voxel : TEXCOORD2;
+    float AO : TEXCOORD3;
+    float3 Light : TEXCOORD4;
+    nointerpolation int3 Chunk : TEXCOORD5;
+};
+
+void main(Input input)
+{
+    uint block = GetBlock(input.Voxel);
+    Material material = materialBuffer[block];
+    uint index = GetAtlasIndex(input.Voxel, material);
+    float3 texcoord = float3(input.Texcoord, index);
+    if (atlasTexture.Sample(atlasSampler, texcoord).a < kEpsilon)
+    {
+        discard;
+    }
+}
@@ -0,0 +1,43 @@
+#include "shader.hlsl"
+
+Texture2DArray<float4> atlasTexture : register(t0, space2);
+SamplerState atlasSampler : register(s0, space2);
+StructuredBuffer<Material> materialBuffer : register(t1, space2);
+
+struct Input
+{
+    float4 Fragment : SV_Position;
+    float4 WorldPosition : TEXCOORD0;
+    float2 Texcoord : TEXCOORD1;
+    nointerpolation uint Voxel : TEXCOORD2;
+    float AO : TEXCOORD3;
+    float3 Light : TEXCOORD4;
+};
+
+struct Output
+{
+    float4 Albedo : SV_Target0;
+    float Depth : SV_Target1;
+    float4 Normal : SV_Target2;
+    float4 Light : SV_Target3;
+};
+
+Output main(Input input)
+{
+    Output output;
+    uint block = GetBlock(input.Voxel);
+    Material material = materialBuffer[block];
+    uint index = GetAtlasIndex(input.Voxel, material);
+    float3 texcoord = float3(input.Texcoord, index);
+    float4 color = atlasTexture.Sample(atlasSampler, texcoord);
+    if (color.a < kEpsilon)
+    {
+        discard;
+        return output;
+    }
+    output.Albedo = float4(color.rgb, 1.0f);
+    output.Depth = input.Fragment.z;
+    output.Normal = float4(GetNormal(input.Voxel) * 0.5f + 0.5f, block == kBlockCloud);
+    output.Light = float4(input.Light, input.AO);
+    return output;
+}
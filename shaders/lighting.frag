@@ -0,0 +1,46 @@
+#include "shader.hlsl"
+
+Texture2D<float4> albedoTexture : register(t0, space2);
+SamplerState albedoSampler : register(s0, space2);
+Texture2D<float> depthTexture : register(t1, space2);
+SamplerState depthSampler : register(s1, space2);
+Texture2D<float4> normalTexture : register(t2, space2);
+SamplerState normalSampler : register(s2, space2);
+StructuredBuffer<Light> lightBuffer : register(t3, space2);
+
+cbuffer UniformBuffer : register(b0, space3)
+{
+    int2 ChunkPosition : packoffset(c0);
+    uint LightOffset : packoffset(c0.z);
+};
+
+cbuffer UniformBuffer : register(b1, space3)
+{
+    float3 PlayerPosition : packoffset(c0);
+    float4x4 InverseMatrix : packoffset(c1);
+};
+
+float4 main(float4 fragment : SV_Position) : SV_Target0
+{
+    static const int kWidth = LIGHT_CELL_WIDTH * LIGHT_GRID_WIDTH;
+    int3 pixel = int3(fragment.xy, 0);
+    float depth = depthTexture.Load(pixel);
+    if (depth >= 1.0f)
+    {
+        discard;
+    }
+    float2 size;
+    depthTexture.GetDimensions(size.x, size.y);
+    float3 position = GetWorldPosition(InverseMatrix, fragment.xy / size, depth);
+    float3 normal = normalize(normalTexture.Load(pixel).xyz * 2.0f - 1.0f);
+    // only the chunk that owns the surface shades it
+    int2 block = int2(floor(position.xz - normal.xz * 0.5f)) - ChunkPosition;
+    if (any(block < 0) || any(block >= kWidth))
+    {
+        discard;
+    }
+    float3 albedo = albedoTexture.Load(pixel).rgb;
+    float3 light = GetLight(lightBuffer, LightOffset, ChunkPosition, position.xyz, normal);
+    float fog = GetFog(distance(position.xz, PlayerPosition.xz));
+    return float4(albedo * light * (1.0f - fog), 0.0f);
+}
@@ -0,0 +1,31 @@
+#include "shader.hlsl"
+
+cbuffer UniformBuffer : register(b0, space1)
+{
+    float4x4 Proj;
+};
+
+cbuffer UniformBuffer : register(b1, space1)
+{
+    float4x4 View;
+};
+
+cbuffer UniformBuffer : register(b2, space1)
+{
+    int2 ChunkPosition;
+};
+
+struct Output
+{
+    float4 Position : SV_Position;
+};
+
+Output main(uint vertexID : SV_VertexID)
+{
+    static const float3 kSize = float3(LIGHT_CELL_WIDTH * LIGHT_GRID_WIDTH, LIGHT_CELL_HEIGHT * LIGHT_GRID_HEIGHT, LIGHT_CELL_WIDTH * LIGHT_GRID_WIDTH);
+    Output output;
+    float3 position = (GetCubePosition(vertexID) + 0.5f) * kSize;
+    position += float3(ChunkPosition.x, 0.0f, ChunkPosition.y);
+    output.Position = mul(Proj, mul(View, float4(position, 1.0f)));
+    return output;
+}
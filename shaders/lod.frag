@@ -0,0 +1,96 @@
+#include "shader.hlsl"
+
+Texture2DArray<float4> atlasTexture : register(t0, space2);
+SamplerState atlasSampler : register(s0, space2);
+StructuredBuffer<Material> materialBuffer : register(t1, space2);
+
+cbuffer UniformBuffer : register(b0, space3)
+{
+    int4 Coverage : packoffset(c0);
+    uint4 CoverageMask[4] : packoffset(c1);
+};
+
+cbuffer UniformBuffer : register(b1, space3)
+{
+    float3 PlayerPosition : packoffset(c0);
+};
+
+cbuffer UniformBuffer : register(b2, space3)
+{
+    float4 Sun : packoffset(c0);
+    float4 SkyTop : packoffset(c1);
+    float4 SkyHorizon : packoffset(c2);
+    float4 Ambient : packoffset(c3);
+};
+
+static const uint kDirectionUp = 4;
+
+struct Input
+{
+    float4 Fragment : SV_Position;
+    float4 WorldPosition : TEXCOORD0;
+    nointerpolation uint Block : TEXCOORD1;
+};
+
+#ifdef GBUFFER
+struct Output
+{
+    float4 Albedo : SV_Target0;
+    float Depth : SV_Target1;
+    float4 Normal : SV_Target2;
+    float4 Light : SV_Target3;
+};
+#else
+struct Output
+{
+    float4 Color : SV_Target0;
+    float Depth : SV_Target1;
+};
+#endif
+
+bool IsCovered(float2 position)
+{
+    // Coverage is (x, z, cell width, cell count) of the grid already drawn by finer geometry
+    int2 cell = int2(floor((position - Coverage.xy) / Coverage.z));
+    if (any(cell < 0) || any(cell >= Coverage.w))
+    {
+        return false;
+    }
+    uint index = cell.x * Coverage.w + cell.y;
+    return (CoverageMask[index / 128][(index / 32) % 4] >> (index % 32)) & 1;
+}
+
+Output main(Input input)
+{
+    Output output;
+    float3 position = input.WorldPosition.xyz;
+    float3 positionDx = ddx(position);
+    float3 positionDy = ddy(position);
+    float2 surfaceDx = positionDx.xz;
+    float2 surfaceDy = positionDy.xz;
+    output.Depth = input.Fragment.z;
+    if (IsCovered(position.xz))
+    {
+        discard;
+        return output;
+    }
+    float3 normal = normalize(cross(positionDy, positionDx));
+    if (normal.y < 0.0f)
+    {
+        normal = -normal;
+    }
+    Material material = materialBuffer[input.Block];
+    float3 texcoord = float3(frac(position.xz), material.Indices[kDirectionUp]);
+    float3 albedo = atlasTexture.SampleGrad(atlasSampler, texcoord, surfaceDx, surfaceDy).rgb;
+#ifdef GBUFFER
+    output.Albedo = float4(albedo, 1.0f);
+    output.Normal = float4(normal * 0.5f + 0.5f, 0.0f);
+    output.Light = float4(0.0f, 0.0f, 0.0f, 1.0f);
+#else
+    float sunlight = GetSunlight(Sun.xyz, Sun.w, normal, input.Block);
+    float3 sky = GetSky(position - PlayerPosition, SkyTop.xyz, SkyHorizon.xyz);
+    float fog = GetFog(distance(position.xz, PlayerPosition.xz));
+    output.Color = float4(lerp(albedo * (Ambient.xyz + sunlight), sky, fog), 1.0f);
+#endif
+    return output;
+}
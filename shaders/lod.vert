@@ -0,0 +1,38 @@
+#include "shader.hlsl"
+
+cbuffer UniformBuffer : register(b0, space1)
+{
+    float4x4 Proj : packoffset(c0);
+};
+
+cbuffer UniformBuffer : register(b1, space1)
+{
+    float4x4 View : packoffset(c0);
+};
+
+struct Input
+{
+    uint Vertex : TEXCOORD0;
+    int4 Tile : TEXCOORD1;
+};
+
+struct Output
+{
+    float4 Position : SV_Position;
+    float4 WorldPosition : TEXCOORD0;
+    nointerpolation uint Block : TEXCOORD1;
+};
+
+Output main(Input input)
+{
+    Output output;
+    float x = (input.Vertex >> LOD_X_OFFSET) & LOD_XZ_MASK;
+    float y = (input.Vertex >> LOD_Y_OFFSET) & LOD_Y_MASK;
+    float z = (input.Vertex >> LOD_Z_OFFSET) & LOD_XZ_MASK;
+    output.WorldPosition.xyz = float3(x * input.Tile.z + input.Tile.x, y, z * input.Tile.z + input.Tile.y);
+    output.Position = mul(View, float4(output.WorldPosition.xyz, 1.0f));
+    output.WorldPosition.w = output.Position.z;
+    output.Position = mul(Proj, output.Position);
+    output.Block = (input.Vertex >> LOD_BLOCK_OFFSET) & BLOCK_MASK;
+    return output;
+}
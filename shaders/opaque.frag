@@ -3,19 +3,16 @@
 Texture2DArray<float4> atlasTexture : register(t0, space2);
 SamplerState atlasSampler : register(s0, space2);
 StructuredBuffer<Material> materialBuffer : register(t1, space2);
+#ifndef UNLIT
 StructuredBuffer<Light> lightBuffer : register(t2, space2);
+#endif
 
 cbuffer UniformBuffer : register(b0, space3)
-{
-    int LightCount : packoffset(c0);
-};
-
-cbuffer UniformBuffer : register(b1, space3)
 {
     float3 PlayerPosition : packoffset(c0);
 };
 
-cbuffer UniformBuffer : register(b2, space3)
+cbuffer UniformBuffer : register(b1, space3)
 {
     float4 Sun : packoffset(c0);
     float4 SkyTop : packoffset(c1);
@@ -25,16 +22,19 @@ cbuffer UniformBuffer : register(b2, space3)
 
 struct Input
 {
+    float4 Fragment : SV_Position;
     float4 WorldPosition : TEXCOORD0;
     float2 Texcoord : TEXCOORD1;
     nointerpolation uint Voxel : TEXCOORD2;
     float AO : TEXCOORD3;
+    float3 Light : TEXCOORD4;
+    nointerpolation int3 Chunk : TEXCOORD5;
 };
 
 struct Output
 {
     float4 Color : SV_Target0;
-    float4 Position : SV_Target1;
+    float Depth : SV_Target1;
 };
 
 Output main(Input input)
@@ -45,7 +45,7 @@ Output main(Input input)
     uint index = GetAtlasIndex(input.Voxel, material);
     float3 texcoord = float3(input.Texcoord, index);
     float4 color = atlasTexture.Sample(atlasSampler, texcoord);
-    output.Position = input.WorldPosition;
+    output.Depth = input.Fragment.z;
     if (color.a < kEpsilon)
     {
         discard;
@@ -53,7 +53,10 @@ Output main(Input input)
     }
     float3 albedo = color.rgb;
     float3 normal = GetNormal(input.Voxel);
-    float3 light = GetLight(lightBuffer, LightCount, input.WorldPosition.xyz, normal);
+    float3 light = input.Light;
+#ifndef UNLIT
+    light += GetLight(lightBuffer, input.Chunk.z, input.Chunk.xy, input.WorldPosition.xyz, normal);
+#endif
     float3 ambient = Ambient.xyz;
     float sunlight = GetSunlight(Sun.xyz, Sun.w, normal, block);
     float3 sky = GetSky(input.WorldPosition.xyz - PlayerPosition, SkyTop.xyz, SkyHorizon.xyz);
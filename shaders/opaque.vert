@@ -10,14 +10,11 @@ cbuffer UniformBuffer : register(b1, space1)
     float4x4 View;
 };
 
-cbuffer UniformBuffer : register(b2, space1)
-{
-    int2 ChunkPosition;
-};
-
 struct Input
 {
     uint Voxel : TEXCOORD0;
+    int4 Chunk : TEXCOORD1;
+    uint Light : TEXCOORD2;
 };
 
 struct Output
@@ -27,18 +24,22 @@ struct Output
     float2 Texcoord : TEXCOORD1;
     nointerpolation uint Voxel : TEXCOORD2;
     float AO : TEXCOORD3;
+    float3 Light : TEXCOORD4;
+    nointerpolation int3 Chunk : TEXCOORD5;
 };
 
 Output main(Input input)
 {
     Output output;
-    int3 chunkPosition = int3(ChunkPosition.x, 0, ChunkPosition.y);
+    int3 chunkPosition = int3(input.Chunk.x, 0, input.Chunk.y);
     output.WorldPosition.xyz = GetPosition(input.Voxel) + chunkPosition;
     output.Position = mul(View, float4(output.WorldPosition.xyz, 1.0f));
     output.WorldPosition.w = output.Position.z;
     output.Position = mul(Proj, output.Position);
     output.Texcoord = GetTexcoord(input.Voxel);
     output.Voxel = input.Voxel;
+    output.Light = GetVoxelLight(input.Light);
+    output.Chunk = input.Chunk.xyz;
     output.AO = GetAO(input.Voxel);
     return output;
 }
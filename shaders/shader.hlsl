@@ -101,9 +101,20 @@ float GetAO(uint voxel)
     return kAO[(voxel >> AO_OFFSET) & AO_MASK];
 }
 
+float3 GetVoxelLight(uint light)
+{
+    return float3(light & 0xFF, (light >> 8) & 0xFF, (light >> 16) & 0xFF) / 255.0f;
+}
+
 float GetFog(float distance)
 {
-    return min(pow(distance / 250.0f, 2.5f), 1.0f);
+    return min(pow(distance / 2000.0f, 2.5f), 1.0f);
+}
+
+float3 GetWorldPosition(float4x4 inverseMatrix, float2 texcoord, float depth)
+{
+    float4 position = mul(inverseMatrix, float4(texcoord.x * 2.0f - 1.0f, 1.0f - texcoord.y * 2.0f, depth, 1.0f));
+    return position.xyz / position.w;
 }
 
 float3 GetSky(float3 position, float3 top, float3 horizon)
@@ -111,12 +122,19 @@ float3 GetSky(float3 position, float3 top, float3 horizon)
     return lerp(horizon, top, (atan2(position.y, length(position.xz)) + kPi / 2.0f) / kPi);
 }
 
-float3 GetLight(StructuredBuffer<Light> lights, uint count, float3 position, float3 normal)
+float3 GetLight(StructuredBuffer<Light> lights, uint offset, int2 chunkPosition, float3 position, float3 normal)
 {
     static const float3 kOffset = float3(0.0f, 0.5f, 0.0f);
     static const float kMinAngle = 0.25f;
+    static const int3 kCellSize = int3(LIGHT_CELL_WIDTH, LIGHT_CELL_HEIGHT, LIGHT_CELL_WIDTH);
+    static const int3 kGridSize = int3(LIGHT_GRID_WIDTH, LIGHT_GRID_HEIGHT, LIGHT_GRID_WIDTH);
     float3 final = float3(0.0f, 0.0f, 0.0f);
-    for (uint i = 0; i < count; i++)
+    int3 block = int3(floor(position - normal * 0.5f)) - int3(chunkPosition.x, 0, chunkPosition.y);
+    int3 cell = clamp(block, 0, kCellSize * kGridSize - 1) / kCellSize;
+    Light header = lights[offset + (cell.x * kGridSize.y + cell.y) * kGridSize.z + cell.z];
+    uint start = offset + header.Position.x;
+    uint end = start + header.Position.y;
+    for (uint i = start; i < end; i++)
     {
         Light light = lights[i];
         float radius = (light.Color & 0xFF000000) >> 24;
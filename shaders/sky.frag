@@ -8,7 +8,7 @@ struct Input
 struct Output
 {
     float4 Color : SV_Target0;
-    float4 Position : SV_Target1;
+    float Depth : SV_Target1;
 };
 
 cbuffer UniformBuffer : register(b0, space3)
@@ -23,6 +23,6 @@ Output main(Input input)
 {
     Output output;
     output.Color = float4(GetSky(input.LocalPosition, SkyTop.xyz, SkyHorizon.xyz), 1.0f);
-    output.Position = float4(0.0f, 0.0f, 0.0f, 0.0f);
+    output.Depth = 1.0f;
     return output;
 }
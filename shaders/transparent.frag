@@ -2,22 +2,20 @@
 
 Texture2DArray<float4> atlasTexture : register(t0, space2);
 SamplerState atlasSampler : register(s0, space2);
-Texture2D<float4> positionTexture : register(t1, space2);
-SamplerState positionSampler : register(s1, space2);
+Texture2D<float> depthTexture : register(t1, space2);
+SamplerState depthSampler : register(s1, space2);
 StructuredBuffer<Material> materialBuffer : register(t2, space2);
+#ifndef UNLIT
 StructuredBuffer<Light> lightBuffer : register(t3, space2);
+#endif
 
 cbuffer UniformBuffer : register(b0, space3)
-{
-    int LightCount : packoffset(c0.x);
-};
-
-cbuffer UniformBuffer : register(b1, space3)
 {
     float3 PlayerPosition : packoffset(c0);
+    float4x4 InverseMatrix : packoffset(c1);
 };
 
-cbuffer UniformBuffer : register(b2, space3)
+cbuffer UniformBuffer : register(b1, space3)
 {
     float4 Sun : packoffset(c0);
     float4 SkyTop : packoffset(c1);
@@ -31,6 +29,8 @@ struct Input
     float2 Texcoord : TEXCOORD1;
     nointerpolation uint Voxel : TEXCOORD2;
     noperspective float2 Fragment : TEXCOORD3;
+    float3 Light : TEXCOORD4;
+    nointerpolation int3 Chunk : TEXCOORD5;
 };
 
 float4 main(Input input) : SV_Target0
@@ -39,11 +39,26 @@ float4 main(Input input) : SV_Target0
     Material material = materialBuffer[block];
     uint index = GetAtlasIndex(input.Voxel, material);
     float3 texcoord = float3(input.Texcoord, index);
-    float4 color = atlasTexture.Sample(atlasSampler, texcoord);
+    float3 normal = GetNormal(input.Voxel);
+    float2 surface = input.WorldPosition.xz;
+    float2 surfaceDx = ddx(surface);
+    float2 surfaceDy = ddy(surface);
+    float4 color;
+    if (block == kBlockWater && normal.y > 0.0f)
+    {
+        // merged water quads span many blocks, so the texture repeats in world space
+        color = atlasTexture.SampleGrad(atlasSampler, float3(frac(surface), index), surfaceDx, surfaceDy);
+    }
+    else
+    {
+        color = atlasTexture.Sample(atlasSampler, texcoord);
+    }
     float4 position = input.WorldPosition;
     float3 albedo = color.rgb;
-    float3 normal = GetNormal(input.Voxel);
-    float3 light = GetLight(lightBuffer, LightCount, position.xyz, normal);
+    float3 light = input.Light;
+#ifndef UNLIT
+    light += GetLight(lightBuffer, input.Chunk.z, input.Chunk.xy, position.xyz, normal);
+#endif
     float3 ambient = Ambient.xyz;
     float sunlight = GetSunlight(Sun.xyz, Sun.w, normal, block);
     float3 sky = GetSky(input.WorldPosition.xyz - PlayerPosition, SkyTop.xyz, SkyHorizon.xyz);
@@ -51,9 +66,10 @@ float4 main(Input input) : SV_Target0
     float alpha = color.a;
     if (block == kBlockWater)
     {
-        float4 seabed = positionTexture.Sample(positionSampler, input.Fragment);
-        if (seabed.w != 0.0f)
+        float depth = depthTexture.Sample(depthSampler, input.Fragment);
+        if (depth < 1.0f)
         {
+            float3 seabed = GetWorldPosition(InverseMatrix, input.Fragment, depth);
             alpha += max(0.0f, input.WorldPosition.y - seabed.y) / 10.0f;
             alpha = saturate(alpha);
         }
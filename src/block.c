@@ -233,26 +233,18 @@ SDL_GPUBuffer* Block_GetBuffer(SDL_GPUDevice* device)
     SDL_COMPILE_TIME_ASSERT("", sizeof(Material) == sizeof(Uint32) * 16);
     CPUBuffer cpu_blocks;
     GPUBuffer gpu_blocks;
-    CPUBuffer_Init(&cpu_blocks, device, sizeof(Material));
+    CPUBuffer_Init(&cpu_blocks, sizeof(Material));
     GPUBuffer_Init(&gpu_blocks, device, SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ);
-    if (!GPUBuffer_BeginUpload(&gpu_blocks))
-    {
-        CPUBuffer_Free(&cpu_blocks);
-        GPUBuffer_Free(&gpu_blocks);
-        return NULL;
-    }
     for (int i = 0; i < BLOCK_COUNT; i++)
     {
         CPUBuffer_Append(&cpu_blocks, &BLOCKS[i]);
     }
     if (!GPUBuffer_Upload(&gpu_blocks, &cpu_blocks))
     {
-        GPUBuffer_EndUpload();
         CPUBuffer_Free(&cpu_blocks);
         GPUBuffer_Free(&gpu_blocks);
         return NULL;
     }
-    GPUBuffer_EndUpload();
     SDL_GPUBuffer* buffer = gpu_blocks.buffer;
     gpu_blocks.buffer = NULL;
     CPUBuffer_Free(&cpu_blocks);
@@ -2,14 +2,341 @@
 
 #include "buffer.h"
 
-static _Thread_local SDL_GPUCommandBuffer* upload_command_buffer;
-static _Thread_local SDL_GPUCopyPass* upload_copy_pass;
+#define GPU_HEAP_ALIGNMENT 256
+#define STAGING_SIZE (32 << 20)
+#define STAGING_ALIGNMENT 16
+#define STAGING_FENCES 8
 
-void CPUBuffer_Init(CPUBuffer* buffer, SDL_GPUDevice* device, Uint32 stride)
+// a copy out of the staging ring, or out of its own transfer buffer when it did not fit
+typedef struct StagingCopy
+{
+    SDL_GPUTransferBuffer* source;
+    Uint32 source_offset;
+    SDL_GPUBuffer* destination;
+    Uint32 destination_offset;
+    Uint32 size;
+    bool cycle;
+} StagingCopy;
+
+// the ring space before head is free again once the fence signals
+typedef struct StagingFence
+{
+    SDL_GPUFence* fence;
+    Uint64 head;
+} StagingFence;
+
+static SDL_Mutex* staging_mutex;
+static SDL_GPUTransferBuffer* staging_buffer;
+static Uint8* staging_data;
+static Uint64 staging_head;
+static Uint64 staging_tail;
+static StagingFence staging_fences[STAGING_FENCES];
+static int staging_fence_count;
+static StagingCopy* copies;
+static int copy_count;
+static int copy_capacity;
+static SDL_GPUBuffer** releases;
+static int release_count;
+static int release_capacity;
+static SDL_AtomicInt device_allocations;
+
+static int GetSizeClass(Uint32 size)
+{
+    int size_class = 0;
+    while ((1ull << size_class) < size)
+    {
+        size_class++;
+    }
+    return size_class;
+}
+
+bool Buffer_Init(SDL_GPUDevice* device)
+{
+    staging_mutex = SDL_CreateMutex();
+    if (!staging_mutex)
+    {
+        SDL_Log("Failed to create mutex: %s", SDL_GetError());
+        return false;
+    }
+    SDL_GPUTransferBufferCreateInfo info = {0};
+    info.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
+    info.size = STAGING_SIZE;
+    staging_buffer = SDL_CreateGPUTransferBuffer(device, &info);
+    if (!staging_buffer)
+    {
+        SDL_Log("Failed to create transfer buffer: %s", SDL_GetError());
+        return false;
+    }
+    SDL_AddAtomicInt(&device_allocations, 1);
+    staging_data = NULL;
+    staging_head = 0;
+    staging_tail = 0;
+    staging_fence_count = 0;
+    return true;
+}
+
+void Buffer_Free(SDL_GPUDevice* device)
+{
+    // anything still queued targets buffers that are already released
+    for (int i = 0; i < copy_count; i++)
+    {
+        if (copies[i].source != staging_buffer)
+        {
+            SDL_ReleaseGPUTransferBuffer(device, copies[i].source);
+        }
+    }
+    for (int i = 0; i < release_count; i++)
+    {
+        SDL_ReleaseGPUBuffer(device, releases[i]);
+    }
+    for (int i = 0; i < staging_fence_count; i++)
+    {
+        SDL_WaitForGPUFences(device, true, &staging_fences[i].fence, 1);
+        SDL_ReleaseGPUFence(device, staging_fences[i].fence);
+    }
+    if (staging_data)
+    {
+        SDL_UnmapGPUTransferBuffer(device, staging_buffer);
+    }
+    SDL_ReleaseGPUTransferBuffer(device, staging_buffer);
+    SDL_DestroyMutex(staging_mutex);
+    SDL_free(copies);
+    SDL_free(releases);
+    staging_mutex = NULL;
+    staging_buffer = NULL;
+    staging_data = NULL;
+    staging_fence_count = 0;
+    copies = NULL;
+    copy_count = 0;
+    copy_capacity = 0;
+    releases = NULL;
+    release_count = 0;
+    release_capacity = 0;
+}
+
+static void ReclaimStaging(SDL_GPUDevice* device)
+{
+    while (staging_fence_count && SDL_QueryGPUFence(device, staging_fences[0].fence))
+    {
+        staging_tail = staging_fences[0].head;
+        SDL_ReleaseGPUFence(device, staging_fences[0].fence);
+        staging_fence_count--;
+        SDL_memmove(&staging_fences[0], &staging_fences[1], staging_fence_count * sizeof(StagingFence));
+    }
+}
+
+// returns the ring offset of size contiguous bytes, or -1 when the ring is too full
+static Sint64 ReserveStaging(SDL_GPUDevice* device, Uint32 size)
+{
+    Uint64 aligned = (size + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+    if (aligned > STAGING_SIZE)
+    {
+        return -1;
+    }
+    ReclaimStaging(device);
+    Uint64 offset = staging_head % STAGING_SIZE;
+    Uint64 skip = offset + aligned > STAGING_SIZE ? STAGING_SIZE - offset : 0;
+    if (staging_head + skip + aligned - staging_tail > STAGING_SIZE)
+    {
+        return -1;
+    }
+    if (!staging_data)
+    {
+        // never cycled since earlier copies in the ring may still be in flight
+        staging_data = SDL_MapGPUTransferBuffer(device, staging_buffer, false);
+        if (!staging_data)
+        {
+            SDL_Log("Failed to map transfer buffer: %s", SDL_GetError());
+            return -1;
+        }
+    }
+    staging_head += skip;
+    offset = staging_head % STAGING_SIZE;
+    staging_head += aligned;
+    return offset;
+}
+
+static SDL_GPUTransferBuffer* CreateTransferBuffer(SDL_GPUDevice* device, const void* data, Uint32 size)
+{
+    SDL_GPUTransferBufferCreateInfo info = {0};
+    info.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
+    info.size = size;
+    SDL_GPUTransferBuffer* buffer = SDL_CreateGPUTransferBuffer(device, &info);
+    if (!buffer)
+    {
+        SDL_Log("Failed to create transfer buffer: %s", SDL_GetError());
+        return NULL;
+    }
+    SDL_AddAtomicInt(&device_allocations, 1);
+    void* mapped = SDL_MapGPUTransferBuffer(device, buffer, false);
+    if (!mapped)
+    {
+        SDL_Log("Failed to map transfer buffer: %s", SDL_GetError());
+        SDL_ReleaseGPUTransferBuffer(device, buffer);
+        return NULL;
+    }
+    SDL_memcpy(mapped, data, size);
+    SDL_UnmapGPUTransferBuffer(device, buffer);
+    return buffer;
+}
+
+static bool PushCopy(const StagingCopy* copy)
+{
+    if (copy_count == copy_capacity)
+    {
+        int capacity = SDL_max(64, copy_capacity * 2);
+        StagingCopy* data = SDL_realloc(copies, capacity * sizeof(StagingCopy));
+        if (!data)
+        {
+            SDL_Log("Failed to allocate staging copies");
+            return false;
+        }
+        copies = data;
+        copy_capacity = capacity;
+    }
+    copies[copy_count++] = *copy;
+    return true;
+}
+
+// queues a copy into destination for the next Buffer_Flush
+static bool Stage(SDL_GPUDevice* device, const void* data, Uint32 size, SDL_GPUBuffer* destination, Uint32 destination_offset, bool cycle)
+{
+    SDL_assert(staging_mutex);
+    StagingCopy copy = {0};
+    copy.destination = destination;
+    copy.destination_offset = destination_offset;
+    copy.size = size;
+    copy.cycle = cycle;
+    SDL_LockMutex(staging_mutex);
+    Sint64 offset = ReserveStaging(device, size);
+    if (offset >= 0)
+    {
+        SDL_memcpy(staging_data + offset, data, size);
+        copy.source = staging_buffer;
+        copy.source_offset = offset;
+    }
+    else
+    {
+        copy.source = CreateTransferBuffer(device, data, size);
+    }
+    bool success = copy.source && PushCopy(&copy);
+    if (!success && copy.source && copy.source != staging_buffer)
+    {
+        SDL_ReleaseGPUTransferBuffer(device, copy.source);
+    }
+    SDL_UnlockMutex(staging_mutex);
+    return success;
+}
+
+// released after the next flush since queued copies may still target it
+static void ReleaseBuffer(SDL_GPUBuffer* buffer)
+{
+    if (!buffer)
+    {
+        return;
+    }
+    SDL_LockMutex(staging_mutex);
+    if (release_count == release_capacity)
+    {
+        int capacity = SDL_max(8, release_capacity * 2);
+        SDL_GPUBuffer** data = SDL_realloc(releases, capacity * sizeof(SDL_GPUBuffer*));
+        if (!data)
+        {
+            SDL_Log("Failed to allocate buffer releases");
+            SDL_UnlockMutex(staging_mutex);
+            return;
+        }
+        releases = data;
+        release_capacity = capacity;
+    }
+    releases[release_count++] = buffer;
+    SDL_UnlockMutex(staging_mutex);
+}
+
+void Buffer_Flush(SDL_GPUDevice* device)
+{
+    SDL_LockMutex(staging_mutex);
+    ReclaimStaging(device);
+    if (!copy_count)
+    {
+        SDL_UnlockMutex(staging_mutex);
+        return;
+    }
+    if (staging_data)
+    {
+        SDL_UnmapGPUTransferBuffer(device, staging_buffer);
+        staging_data = NULL;
+    }
+    SDL_GPUCommandBuffer* command_buffer = SDL_AcquireGPUCommandBuffer(device);
+    if (!command_buffer)
+    {
+        SDL_Log("Failed to acquire command buffer: %s", SDL_GetError());
+        SDL_UnlockMutex(staging_mutex);
+        return;
+    }
+    SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(command_buffer);
+    if (!copy_pass)
+    {
+        SDL_Log("Failed to begin copy pass: %s", SDL_GetError());
+        SDL_CancelGPUCommandBuffer(command_buffer);
+        SDL_UnlockMutex(staging_mutex);
+        return;
+    }
+    for (int i = 0; i < copy_count; i++)
+    {
+        const StagingCopy* copy = &copies[i];
+        SDL_GPUTransferBufferLocation location = {0};
+        SDL_GPUBufferRegion region = {0};
+        location.transfer_buffer = copy->source;
+        location.offset = copy->source_offset;
+        region.buffer = copy->destination;
+        region.offset = copy->destination_offset;
+        region.size = copy->size;
+        SDL_UploadToGPUBuffer(copy_pass, &location, &region, copy->cycle);
+    }
+    SDL_EndGPUCopyPass(copy_pass);
+    if (staging_fence_count == STAGING_FENCES)
+    {
+        SDL_WaitForGPUFences(device, true, &staging_fences[0].fence, 1);
+        ReclaimStaging(device);
+    }
+    SDL_GPUFence* fence = SDL_SubmitGPUCommandBufferAndAcquireFence(command_buffer);
+    if (fence)
+    {
+        staging_fences[staging_fence_count].fence = fence;
+        staging_fences[staging_fence_count].head = staging_head;
+        staging_fence_count++;
+    }
+    else
+    {
+        SDL_Log("Failed to submit command buffer: %s", SDL_GetError());
+        SDL_WaitForGPUIdle(device);
+        staging_tail = staging_head;
+    }
+    for (int i = 0; i < copy_count; i++)
+    {
+        if (copies[i].source != staging_buffer)
+        {
+            SDL_ReleaseGPUTransferBuffer(device, copies[i].source);
+        }
+    }
+    for (int i = 0; i < release_count; i++)
+    {
+        SDL_ReleaseGPUBuffer(device, releases[i]);
+    }
+    copy_count = 0;
+    release_count = 0;
+    SDL_UnlockMutex(staging_mutex);
+}
+
+void Buffer_GetStats(BufferStats* stats)
+{
+    stats->device_allocations += SDL_GetAtomicInt(&device_allocations);
+}
+
+void CPUBuffer_Init(CPUBuffer* buffer, Uint32 stride)
 {
     SDL_assert(stride);
-    buffer->device = device;
-    buffer->buffer = NULL;
     buffer->data = NULL;
     buffer->capacity = 0;
     buffer->size = 0;
@@ -18,9 +345,7 @@ void CPUBuffer_Init(CPUBuffer* buffer, SDL_GPUDevice* device, Uint32 stride)
 
 void CPUBuffer_Free(CPUBuffer* buffer)
 {
-    SDL_ReleaseGPUTransferBuffer(buffer->device, buffer->buffer);
-    buffer->device = NULL;
-    buffer->buffer = NULL;
+    SDL_free(buffer->data);
     buffer->data = NULL;
     buffer->capacity = 0;
     buffer->size = 0;
@@ -29,48 +354,20 @@ void CPUBuffer_Free(CPUBuffer* buffer)
 
 void CPUBuffer_Append(CPUBuffer* buffer, const void* item)
 {
-    if (!buffer->data && buffer->buffer)
-    {
-        SDL_assert(!buffer->size);
-        buffer->data = SDL_MapGPUTransferBuffer(buffer->device, buffer->buffer, true);
-        if (!buffer->data)
-        {
-            SDL_Log("Failed to map transfer buffer: %s", SDL_GetError());
-            return;
-        }
-    }
     SDL_assert(buffer->size <= buffer->capacity);
     if (buffer->size == buffer->capacity)
     {
-        int capacity = SDL_max(64, buffer->size * 2);
-        SDL_GPUTransferBufferCreateInfo info = {0};
-        info.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
-        info.size = capacity * buffer->stride;
-        SDL_GPUTransferBuffer* transfer_buffer = SDL_CreateGPUTransferBuffer(buffer->device, &info);
-        if (!transfer_buffer)
-        {
-            SDL_Log("Failed to create transfer buffer: %s", SDL_GetError());
-            return;
-        }
-        void* data = SDL_MapGPUTransferBuffer(buffer->device, transfer_buffer, false);
+        Uint32 capacity = SDL_max(64, buffer->capacity * 2);
+        Uint8* data = SDL_realloc(buffer->data, capacity * buffer->stride);
         if (!data)
         {
-            SDL_Log("Failed to map transfer buffer: %s", SDL_GetError());
-            SDL_ReleaseGPUTransferBuffer(buffer->device, transfer_buffer);
+            SDL_Log("Failed to allocate cpu buffer");
             return;
         }
-        if (buffer->data)
-        {
-            SDL_memcpy(data, buffer->data, buffer->size * buffer->stride);
-            SDL_UnmapGPUTransferBuffer(buffer->device, buffer->buffer);
-        }
-        SDL_ReleaseGPUTransferBuffer(buffer->device, buffer->buffer);
-        buffer->capacity = capacity;
-        buffer->buffer = transfer_buffer;
         buffer->data = data;
+        buffer->capacity = capacity;
     }
-    SDL_assert(buffer->data);
-    SDL_memcpy((Uint8*)buffer->data + buffer->size * buffer->stride, item, buffer->stride);
+    SDL_memcpy(buffer->data + buffer->size * buffer->stride, item, buffer->stride);
     buffer->size++;
 }
 
@@ -85,7 +382,7 @@ void GPUBuffer_Init(GPUBuffer* buffer, SDL_GPUDevice* device, SDL_GPUBufferUsage
 
 void GPUBuffer_Free(GPUBuffer* buffer)
 {
-    SDL_ReleaseGPUBuffer(buffer->device, buffer->buffer);
+    ReleaseBuffer(buffer->buffer);
     buffer->usage = 0;
     buffer->buffer = NULL;
     buffer->capacity = 0;
@@ -100,7 +397,7 @@ bool GPUBuffer_Reserve(GPUBuffer* buffer, Uint32 capacity, Uint32 stride)
     {
         return true;
     }
-    SDL_ReleaseGPUBuffer(buffer->device, buffer->buffer);
+    ReleaseBuffer(buffer->buffer);
     buffer->buffer = NULL;
     buffer->capacity = 0;
     buffer->size = 0;
@@ -113,48 +410,28 @@ bool GPUBuffer_Reserve(GPUBuffer* buffer, Uint32 capacity, Uint32 stride)
         SDL_Log("Failed to create buffer: %s", SDL_GetError());
         return false;
     }
+    SDL_AddAtomicInt(&device_allocations, 1);
     buffer->capacity = capacity;
     return true;
 }
 
 bool GPUBuffer_Upload(GPUBuffer* destination, CPUBuffer* source)
 {
-    SDL_assert(upload_command_buffer);
-    SDL_assert(upload_copy_pass);
     destination->size = 0;
-    if (source->data)
-    {
-        SDL_UnmapGPUTransferBuffer(destination->device, source->buffer);
-        source->data = NULL;
-    }
     if (!source->size)
     {
         return true;
     }
     Uint32 size = source->size;
     source->size = 0;
-    if (size > destination->capacity)
-    {
-        SDL_ReleaseGPUBuffer(destination->device, destination->buffer);
-        destination->buffer = NULL;
-        destination->capacity = 0;
-        SDL_GPUBufferCreateInfo info = {0};
-        info.usage = destination->usage;
-        info.size = source->capacity * source->stride;
-        destination->buffer = SDL_CreateGPUBuffer(destination->device, &info);
-        if (!destination->buffer)
-        {
-            SDL_Log("Failed to create buffer: %s", SDL_GetError());
-            return false;
-        }
-        destination->capacity = source->capacity;
-    }
-    SDL_GPUTransferBufferLocation location = {0};
-    SDL_GPUBufferRegion region = {0};
-    location.transfer_buffer = source->buffer;
-    region.buffer = destination->buffer;
-    region.size = size * source->stride;
-    SDL_UploadToGPUBuffer(upload_copy_pass, &location, &region, true);
+    if (size > destination->capacity && !GPUBuffer_Reserve(destination, source->capacity, source->stride))
+    {
+        return false;
+    }
+    if (!Stage(destination->device, source->data, size * source->stride, destination->buffer, 0, true))
+    {
+        return false;
+    }
     destination->size = size;
     return true;
 }
@@ -164,33 +441,239 @@ void GPUBuffer_Clear(GPUBuffer* buffer)
     buffer->size = 0;
 }
 
-bool GPUBuffer_BeginUpload(GPUBuffer* buffer)
+bool GPUHeap_Init(GPUHeap* heap, SDL_GPUDevice* device, SDL_GPUBufferUsageFlags usage, Uint32 stride, Uint32 page_size)
+{
+    SDL_assert(stride);
+    SDL_assert(page_size);
+    SDL_zerop(heap);
+    heap->device = device;
+    heap->usage = usage;
+    heap->stride = stride;
+    heap->page_size = page_size;
+    heap->mutex = SDL_CreateMutex();
+    if (!heap->mutex)
+    {
+        SDL_Log("Failed to create mutex: %s", SDL_GetError());
+        return false;
+    }
+    return true;
+}
+
+void GPUHeap_Free(GPUHeap* heap)
 {
-    SDL_assert(!upload_command_buffer);
-    SDL_assert(!upload_copy_pass);
-    upload_command_buffer = SDL_AcquireGPUCommandBuffer(buffer->device);
-    if (!upload_command_buffer)
+    for (int i = 0; i < heap->page_count; i++)
     {
-        SDL_Log("Failed to acquire command buffer: %s", SDL_GetError());
+        SDL_ReleaseGPUBuffer(heap->device, heap->pages[i].buffer);
+        SDL_free(heap->pages[i].ranges);
+    }
+    SDL_DestroyMutex(heap->mutex);
+    SDL_zerop(heap);
+}
+
+static bool InsertRange(GPUHeapPage* page, int index, Uint32 offset, Uint32 size)
+{
+    if (page->range_count == page->range_capacity)
+    {
+        int capacity = SDL_max(8, page->range_capacity * 2);
+        GPUHeapRange* ranges = SDL_realloc(page->ranges, capacity * sizeof(GPUHeapRange));
+        if (!ranges)
+        {
+            SDL_Log("Failed to allocate heap ranges");
+            return false;
+        }
+        page->ranges = ranges;
+        page->range_capacity = capacity;
+    }
+    SDL_memmove(&page->ranges[index + 1], &page->ranges[index], (page->range_count - index) * sizeof(GPUHeapRange));
+    page->ranges[index].offset = offset;
+    page->ranges[index].size = size;
+    page->range_count++;
+    return true;
+}
+
+static void RemoveRange(GPUHeapPage* page, int index)
+{
+    SDL_assert(index < page->range_count);
+    page->range_count--;
+    SDL_memmove(&page->ranges[index], &page->ranges[index + 1], (page->range_count - index) * sizeof(GPUHeapRange));
+}
+
+static bool AddPage(GPUHeap* heap, Uint32 capacity)
+{
+    if (heap->page_count == GPU_HEAP_PAGES)
+    {
+        SDL_Log("Failed to create heap page: out of pages");
         return false;
     }
-    upload_copy_pass = SDL_BeginGPUCopyPass(upload_command_buffer);
-    if (!upload_copy_pass)
+    SDL_GPUBufferCreateInfo info = {0};
+    info.usage = heap->usage;
+    info.size = capacity * heap->stride;
+    GPUHeapPage* page = &heap->pages[heap->page_count];
+    page->buffer = SDL_CreateGPUBuffer(heap->device, &info);
+    if (!page->buffer)
+    {
+        SDL_Log("Failed to create buffer: %s", SDL_GetError());
+        return false;
+    }
+    SDL_AddAtomicInt(&device_allocations, 1);
+    page->capacity = capacity;
+    if (!InsertRange(page, 0, 0, capacity))
+    {
+        SDL_ReleaseGPUBuffer(heap->device, page->buffer);
+        page->buffer = NULL;
+        return false;
+    }
+    heap->page_count++;
+    return true;
+}
+
+static bool Allocate(GPUHeap* heap, GPUAllocation* allocation, Uint32 capacity)
+{
+    for (int i = 0; i < heap->page_count; i++)
+    {
+        GPUHeapPage* page = &heap->pages[i];
+        for (int j = 0; j < page->range_count; j++)
+        {
+            GPUHeapRange* range = &page->ranges[j];
+            if (range->size < capacity)
+            {
+                continue;
+            }
+            allocation->page = i;
+            allocation->offset = range->offset;
+            allocation->capacity = capacity;
+            range->offset += capacity;
+            range->size -= capacity;
+            if (!range->size)
+            {
+                RemoveRange(page, j);
+            }
+            heap->allocations++;
+            return true;
+        }
+    }
+    if (!AddPage(heap, SDL_max(heap->page_size, capacity)))
+    {
+        return false;
+    }
+    return Allocate(heap, allocation, capacity);
+}
+
+static void Deallocate(GPUHeap* heap, GPUAllocation* allocation)
+{
+    if (!allocation->capacity)
+    {
+        return;
+    }
+    GPUHeapPage* page = &heap->pages[allocation->page];
+    Uint32 offset = allocation->offset;
+    Uint32 size = allocation->capacity;
+    allocation->page = 0;
+    allocation->offset = 0;
+    allocation->size = 0;
+    allocation->capacity = 0;
+    int index = 0;
+    while (index < page->range_count && page->ranges[index].offset < offset)
+    {
+        index++;
+    }
+    GPUHeapRange* prev = index > 0 ? &page->ranges[index - 1] : NULL;
+    GPUHeapRange* next = index < page->range_count ? &page->ranges[index] : NULL;
+    bool has_prev = prev && prev->offset + prev->size == offset;
+    bool has_next = next && offset + size == next->offset;
+    if (has_prev && has_next)
+    {
+        prev->size += size + next->size;
+        RemoveRange(page, index);
+    }
+    else if (has_prev)
+    {
+        prev->size += size;
+    }
+    else if (has_next)
+    {
+        next->offset = offset;
+        next->size += size;
+    }
+    else
+    {
+        InsertRange(page, index, offset, size);
+    }
+}
+
+// rounds up to one of four steps per power of two so freed ranges fit similar meshes
+static Uint32 GetHeapClass(Uint32 size)
+{
+    size = SDL_max(size, GPU_HEAP_ALIGNMENT);
+    int size_class = GetSizeClass(size);
+    Uint32 step = SDL_max(GPU_HEAP_ALIGNMENT, (1u << size_class) / 8);
+    return (size + step - 1) / step * step;
+}
+
+bool GPUHeap_Upload(GPUHeap* heap, GPUAllocation* allocation, CPUBuffer* source)
+{
+    SDL_assert(source->stride == heap->stride);
+    allocation->size = 0;
+    if (!source->size)
+    {
+        return true;
+    }
+    Uint32 size = source->size;
+    source->size = 0;
+    // ranges are reused in place and only move when they no longer fit or mostly sit empty
+    if (size > allocation->capacity || size < allocation->capacity / 4)
+    {
+        Uint32 capacity = GetHeapClass(size);
+        SDL_LockMutex(heap->mutex);
+        Deallocate(heap, allocation);
+        bool allocated = Allocate(heap, allocation, capacity);
+        SDL_UnlockMutex(heap->mutex);
+        if (!allocated)
+        {
+            return false;
+        }
+    }
+    SDL_GPUBuffer* buffer = GPUHeap_GetBuffer(heap, allocation->page);
+    if (!Stage(heap->device, source->data, size * heap->stride, buffer, allocation->offset * heap->stride, false))
     {
-        SDL_Log("Failed to begin copy pass: %s", SDL_GetError());
-        SDL_CancelGPUCommandBuffer(upload_command_buffer);
-        upload_command_buffer = NULL;
         return false;
     }
+    allocation->size = size;
     return true;
 }
 
-void GPUBuffer_EndUpload()
+void GPUHeap_Release(GPUHeap* heap, GPUAllocation* allocation)
+{
+    SDL_LockMutex(heap->mutex);
+    Deallocate(heap, allocation);
+    SDL_UnlockMutex(heap->mutex);
+}
+
+SDL_GPUBuffer* GPUHeap_GetBuffer(GPUHeap* heap, Uint32 page)
 {
-    SDL_assert(upload_copy_pass);
-    SDL_assert(upload_command_buffer);
-    SDL_EndGPUCopyPass(upload_copy_pass);
-    SDL_SubmitGPUCommandBuffer(upload_command_buffer);
-    upload_copy_pass = NULL;
-    upload_command_buffer = NULL;
+    SDL_LockMutex(heap->mutex);
+    SDL_assert(page < (Uint32) heap->page_count);
+    SDL_GPUBuffer* buffer = heap->pages[page].buffer;
+    SDL_UnlockMutex(heap->mutex);
+    return buffer;
+}
+
+void GPUHeap_GetStats(GPUHeap* heap, BufferStats* stats)
+{
+    SDL_LockMutex(heap->mutex);
+    for (int i = 0; i < heap->page_count; i++)
+    {
+        const GPUHeapPage* page = &heap->pages[i];
+        Uint64 free_bytes = 0;
+        for (int j = 0; j < page->range_count; j++)
+        {
+            Uint64 size = (Uint64) page->ranges[j].size * heap->stride;
+            stats->largest_free_bytes = SDL_max(stats->largest_free_bytes, size);
+            free_bytes += size;
+        }
+        stats->live_bytes += (Uint64) page->capacity * heap->stride - free_bytes;
+        stats->free_bytes += free_bytes;
+    }
+    stats->allocations += heap->allocations;
+    SDL_UnlockMutex(heap->mutex);
 }
@@ -2,17 +2,31 @@
 
 #include <SDL3/SDL.h>
 
+typedef struct BufferStats
+{
+    Uint64 live_bytes;
+    Uint64 free_bytes;
+    Uint64 largest_free_bytes;
+    Uint64 allocations;
+    Uint64 device_allocations;
+} BufferStats;
+
+// uploads are queued into one staging ring from any thread and copied by Buffer_Flush,
+// which must run before a frame that draws them is submitted
+bool Buffer_Init(SDL_GPUDevice* device);
+void Buffer_Free(SDL_GPUDevice* device);
+void Buffer_Flush(SDL_GPUDevice* device);
+void Buffer_GetStats(BufferStats* stats);
+
 typedef struct CPUBuffer
 {
-    SDL_GPUDevice* device;
-    SDL_GPUTransferBuffer* buffer;
     Uint8* data;
     Uint32 size;
     Uint32 capacity;
     Uint32 stride;
 } CPUBuffer;
 
-void CPUBuffer_Init(CPUBuffer* buffer, SDL_GPUDevice* device, Uint32 stride);
+void CPUBuffer_Init(CPUBuffer* buffer, Uint32 stride);
 void CPUBuffer_Free(CPUBuffer* buffer);
 void CPUBuffer_Append(CPUBuffer* buffer, const void* item);
 
@@ -30,5 +44,47 @@ void GPUBuffer_Free(GPUBuffer* buffer);
 bool GPUBuffer_Reserve(GPUBuffer* buffer, Uint32 capacity, Uint32 stride);
 bool GPUBuffer_Upload(GPUBuffer* destination, CPUBuffer* source);
 void GPUBuffer_Clear(GPUBuffer* buffer);
-bool GPUBuffer_BeginUpload(GPUBuffer* buffer);
-void GPUBuffer_EndUpload();
+
+#define GPU_HEAP_PAGES 64
+
+typedef struct GPUAllocation
+{
+    Uint32 page;
+    Uint32 offset;
+    Uint32 size;
+    Uint32 capacity;
+} GPUAllocation;
+
+typedef struct GPUHeapRange
+{
+    Uint32 offset;
+    Uint32 size;
+} GPUHeapRange;
+
+typedef struct GPUHeapPage
+{
+    SDL_GPUBuffer* buffer;
+    Uint32 capacity;
+    GPUHeapRange* ranges;
+    int range_count;
+    int range_capacity;
+} GPUHeapPage;
+
+typedef struct GPUHeap
+{
+    SDL_GPUDevice* device;
+    SDL_GPUBufferUsageFlags usage;
+    SDL_Mutex* mutex;
+    Uint32 stride;
+    Uint32 page_size;
+    GPUHeapPage pages[GPU_HEAP_PAGES];
+    int page_count;
+    Uint64 allocations;
+} GPUHeap;
+
+bool GPUHeap_Init(GPUHeap* heap, SDL_GPUDevice* device, SDL_GPUBufferUsageFlags usage, Uint32 stride, Uint32 page_size);
+void GPUHeap_Free(GPUHeap* heap);
+bool GPUHeap_Upload(GPUHeap* heap, GPUAllocation* allocation, CPUBuffer* source);
+void GPUHeap_Release(GPUHeap* heap, GPUAllocation* allocation);
+SDL_GPUBuffer* GPUHeap_GetBuffer(GPUHeap* heap, Uint32 page);
+void GPUHeap_GetStats(GPUHeap* heap, BufferStats* stats);
@@ -0,0 +1,170 @@
+#include <SDL3/SDL.h>
+#include <sqlite3.h>
+
+#include "cache.h"
+
+// meshes only speed up loading, so losing recent writes on a crash is fine
+#define CACHE_COMMIT_INTERVAL 32
+#define CACHE_MAX_MESHES 1024
+#define CACHE_TRIM_INTERVAL 8
+
+static const char* NAME = "meshes.sqlite3";
+static const char* SCHEMA =
+    "CREATE TABLE IF NOT EXISTS meshes ("
+    "    id INTEGER PRIMARY KEY,"
+    "    key INTEGER UNIQUE NOT NULL,"
+    "    data BLOB NOT NULL"
+    ");";
+static const char* SET_MESH = "INSERT OR REPLACE INTO meshes (key, data) VALUES (?, ?);";
+static const char* GET_MESH = "SELECT data FROM meshes WHERE key = ?;";
+static const char* TRIM_MESHES = "DELETE FROM meshes WHERE id <= (SELECT MAX(id) FROM meshes) - ?;";
+
+static sqlite3* handle;
+static sqlite3_stmt* set_mesh;
+static sqlite3_stmt* get_mesh;
+static sqlite3_stmt* trim_meshes;
+static SDL_Mutex* mutex;
+static int pending_writes;
+static int pending_commits;
+
+static bool Execute(const char* sql, const char* name)
+{
+    if (sqlite3_exec(handle, sql, NULL, NULL, NULL))
+    {
+        SDL_Log("Failed to %s: %s", name, sqlite3_errmsg(handle));
+        return false;
+    }
+    return true;
+}
+
+static bool Prepare(sqlite3_stmt** statement, const char* sql, const char* name)
+{
+    if (sqlite3_prepare_v2(handle, sql, -1, statement, NULL))
+    {
+        SDL_Log("Failed to prepare %s: %s", name, sqlite3_errmsg(handle));
+        return false;
+    }
+    return true;
+}
+
+// keeps the most recently written meshes so the cache stays bounded as the world is explored
+static void Trim()
+{
+    sqlite3_bind_int(trim_meshes, 1, CACHE_MAX_MESHES);
+    if (sqlite3_step(trim_meshes) != SQLITE_DONE)
+    {
+        SDL_Log("Failed to trim meshes: %s", sqlite3_errmsg(handle));
+    }
+    sqlite3_reset(trim_meshes);
+}
+
+bool Cache_Init()
+{
+    char* pref_path = SDL_GetPrefPath(NULL, "blocks");
+    if (!pref_path)
+    {
+        SDL_Log("Failed to get pref path: %s", SDL_GetError());
+        return false;
+    }
+    char path[1024] = {0};
+    SDL_snprintf(path, sizeof(path), "%s%s", pref_path, NAME);
+    SDL_free(pref_path);
+    if (sqlite3_open(path, &handle))
+    {
+        SDL_Log("Failed to open %s database: %s", path, sqlite3_errmsg(handle));
+        sqlite3_close(handle);
+        handle = NULL;
+        return false;
+    }
+    mutex = SDL_CreateMutex();
+    if (!mutex)
+    {
+        SDL_Log("Failed to create mutex: %s", SDL_GetError());
+        Cache_Free();
+        return false;
+    }
+    if (!Execute("PRAGMA journal_mode = WAL;", "enable wal") ||
+        !Execute("PRAGMA synchronous = OFF;", "set synchronous") ||
+        !Execute(SCHEMA, "create schema") || !Prepare(&set_mesh, SET_MESH, "set mesh") ||
+        !Prepare(&get_mesh, GET_MESH, "get mesh") || !Prepare(&trim_meshes, TRIM_MESHES, "trim meshes"))
+    {
+        Cache_Free();
+        return false;
+    }
+    Trim();
+    pending_writes = 0;
+    pending_commits = 0;
+    sqlite3_exec(handle, "BEGIN;", NULL, NULL, NULL);
+    return true;
+}
+
+void Cache_Free()
+{
+    if (handle)
+    {
+        sqlite3_exec(handle, "COMMIT;", NULL, NULL, NULL);
+    }
+    sqlite3_finalize(set_mesh);
+    sqlite3_finalize(get_mesh);
+    sqlite3_finalize(trim_meshes);
+    sqlite3_close(handle);
+    SDL_DestroyMutex(mutex);
+    set_mesh = NULL;
+    get_mesh = NULL;
+    trim_meshes = NULL;
+    handle = NULL;
+    mutex = NULL;
+}
+
+void Cache_Set(Uint64 key, const void* data, int size)
+{
+    if (!set_mesh)
+    {
+        return;
+    }
+    SDL_LockMutex(mutex);
+    sqlite3_bind_int64(set_mesh, 1, (Sint64) key);
+    sqlite3_bind_blob(set_mesh, 2, data, size, SQLITE_STATIC);
+    if (sqlite3_step(set_mesh) != SQLITE_DONE)
+    {
+        SDL_Log("Failed to set mesh: %s", sqlite3_errmsg(handle));
+    }
+    sqlite3_reset(set_mesh);
+    if (++pending_writes >= CACHE_COMMIT_INTERVAL)
+    {
+        // trimmed while playing too, since a long session can write far more than the budget
+        if (++pending_commits >= CACHE_TRIM_INTERVAL)
+        {
+            Trim();
+            pending_commits = 0;
+        }
+        sqlite3_exec(handle, "COMMIT;", NULL, NULL, NULL);
+        sqlite3_exec(handle, "BEGIN;", NULL, NULL, NULL);
+        pending_writes = 0;
+    }
+    SDL_UnlockMutex(mutex);
+}
+
+// returns a copy of the cached data to be released with SDL_free, or NULL on a miss
+void* Cache_Get(Uint64 key, int* size)
+{
+    if (!get_mesh)
+    {
+        return NULL;
+    }
+    void* data = NULL;
+    SDL_LockMutex(mutex);
+    sqlite3_bind_int64(get_mesh, 1, (Sint64) key);
+    if (sqlite3_step(get_mesh) == SQLITE_ROW)
+    {
+        *size = sqlite3_column_bytes(get_mesh, 0);
+        data = SDL_malloc(*size);
+        if (data)
+        {
+            SDL_memcpy(data, sqlite3_column_blob(get_mesh, 0), *size);
+        }
+    }
+    sqlite3_reset(get_mesh);
+    SDL_UnlockMutex(mutex);
+    return data;
+}
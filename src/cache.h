@@ -0,0 +1,8 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+bool Cache_Init();
+void Cache_Free();
+void Cache_Set(Uint64 key, const void* data, int size);
+void* Cache_Get(Uint64 key, int* size);
@@ -23,6 +23,43 @@ static void Multiply(float matrix[4][4], float lhs[4][4], float rhs[4][4])
     }
 }
 
+static void Invert(float matrix[4][4], float m[4][4])
+{
+    float a[16];
+    for (int i = 0; i < 4; i++)
+    for (int j = 0; j < 4; j++)
+    {
+        a[i * 4 + j] = m[i][j];
+    }
+    float b[16];
+    b[0] = a[5] * a[10] * a[15] - a[5] * a[11] * a[14] - a[9] * a[6] * a[15] + a[9] * a[7] * a[14] + a[13] * a[6] * a[11] - a[13] * a[7] * a[10];
+    b[4] = -a[4] * a[10] * a[15] + a[4] * a[11] * a[14] + a[8] * a[6] * a[15] - a[8] * a[7] * a[14] - a[12] * a[6] * a[11] + a[12] * a[7] * a[10];
+    b[8] = a[4] * a[9] * a[15] - a[4] * a[11] * a[13] - a[8] * a[5] * a[15] + a[8] * a[7] * a[13] + a[12] * a[5] * a[11] - a[12] * a[7] * a[9];
+    b[12] = -a[4] * a[9] * a[14] + a[4] * a[10] * a[13] + a[8] * a[5] * a[14] - a[8] * a[6] * a[13] - a[12] * a[5] * a[10] + a[12] * a[6] * a[9];
+    b[1] = -a[1] * a[10] * a[15] + a[1] * a[11] * a[14] + a[9] * a[2] * a[15] - a[9] * a[3] * a[14] - a[13] * a[2] * a[11] + a[13] * a[3] * a[10];
+    b[5] = a[0] * a[10] * a[15] - a[0] * a[11] * a[14] - a[8] * a[2] * a[15] + a[8] * a[3] * a[14] + a[12] * a[2] * a[11] - a[12] * a[3] * a[10];
+    b[9] = -a[0] * a[9] * a[15] + a[0] * a[11] * a[13] + a[8] * a[1] * a[15] - a[8] * a[3] * a[13] - a[12] * a[1] * a[11] + a[12] * a[3] * a[9];
+    b[13] = a[0] * a[9] * a[14] - a[0] * a[10] * a[13] - a[8] * a[1] * a[14] + a[8] * a[2] * a[13] + a[12] * a[1] * a[10] - a[12] * a[2] * a[9];
+    b[2] = a[1] * a[6] * a[15] - a[1] * a[7] * a[14] - a[5] * a[2] * a[15] + a[5] * a[3] * a[14] + a[13] * a[2] * a[7] - a[13] * a[3] * a[6];
+    b[6] = -a[0] * a[6] * a[15] + a[0] * a[7] * a[14] + a[4] * a[2] * a[15] - a[4] * a[3] * a[14] - a[12] * a[2] * a[7] + a[12] * a[3] * a[6];
+    b[10] = a[0] * a[5] * a[15] - a[0] * a[7] * a[13] - a[4] * a[1] * a[15] + a[4] * a[3] * a[13] + a[12] * a[1] * a[7] - a[12] * a[3] * a[5];
+    b[14] = -a[0] * a[5] * a[14] + a[0] * a[6] * a[13] + a[4] * a[1] * a[14] - a[4] * a[2] * a[13] - a[12] * a[1] * a[6] + a[12] * a[2] * a[5];
+    b[3] = -a[1] * a[6] * a[11] + a[1] * a[7] * a[10] + a[5] * a[2] * a[11] - a[5] * a[3] * a[10] - a[9] * a[2] * a[7] + a[9] * a[3] * a[6];
+    b[7] = a[0] * a[6] * a[11] - a[0] * a[7] * a[10] - a[4] * a[2] * a[11] + a[4] * a[3] * a[10] + a[8] * a[2] * a[7] - a[8] * a[3] * a[6];
+    b[11] = -a[0] * a[5] * a[11] + a[0] * a[7] * a[9] + a[4] * a[1] * a[11] - a[4] * a[3] * a[9] - a[8] * a[1] * a[7] + a[8] * a[3] * a[5];
+    b[15] = a[0] * a[5] * a[10] - a[0] * a[6] * a[9] - a[4] * a[1] * a[10] + a[4] * a[2] * a[9] + a[8] * a[1] * a[6] - a[8] * a[2] * a[5];
+    float determinant = a[0] * b[0] + a[1] * b[4] + a[2] * b[8] + a[3] * b[12];
+    if (SDL_fabsf(determinant) < SDL_FLT_EPSILON)
+    {
+        determinant = SDL_FLT_EPSILON;
+    }
+    for (int i = 0; i < 4; i++)
+    for (int j = 0; j < 4; j++)
+    {
+        matrix[i][j] = b[i * 4 + j] / determinant;
+    }
+}
+
 static void Perspective(float matrix[4][4], float aspect, float fov, float near, float far)
 {
     matrix[0][0] = (1.0f / SDL_tanf(fov / 2.0f)) / aspect;
@@ -160,7 +197,7 @@ void Camera_Init(Camera* camera, CameraType type)
     camera->height = 1;
     camera->fov = RADIANS(90.0f);
     camera->near = 0.1f;
-    camera->far = 1000.0f;
+    camera->far = 4000.0f;
     camera->ortho = 100.0f;
 }
 
@@ -186,6 +223,7 @@ void Camera_Update(Camera* camera)
         Ortho(camera->proj, -ox, ox, -oy, oy, -camera->far, camera->far);
     }
     Multiply(camera->matrix, camera->proj, camera->view);
+    Invert(camera->inverse, camera->matrix);
     Frustum(camera->planes, camera->matrix);
 }
 
@@ -243,3 +281,70 @@ bool Camera_IsVisible(const Camera* camera, float x, float y, float z, float wid
     }
     return true;
 }
+
+// tests boxes stored as separate arrays of each min and max coordinate, four at a time where supported
+void Camera_AreVisible(const Camera* camera, const float* const min[3], const float* const max[3], int count, bool* visible)
+{
+    const float* points[6][3];
+    for (int i = 0; i < 6; i++)
+    for (int j = 0; j < 3; j++)
+    {
+        points[i][j] = camera->planes[i][j] >= 0.0f ? max[j] : min[j];
+    }
+    int index = 0;
+#if defined(SDL_SSE_INTRINSICS)
+    for (; index + 4 <= count; index += 4)
+    {
+        __m128 outside = _mm_setzero_ps();
+        for (int i = 0; i < 6; i++)
+        {
+            const float* plane = camera->planes[i];
+            __m128 distance = _mm_set1_ps(plane[3]);
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane[0]), _mm_loadu_ps(points[i][0] + index)));
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane[1]), _mm_loadu_ps(points[i][1] + index)));
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane[2]), _mm_loadu_ps(points[i][2] + index)));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_setzero_ps()));
+        }
+        int mask = _mm_movemask_ps(outside);
+        for (int i = 0; i < 4; i++)
+        {
+            visible[index + i] = !(mask & (1 << i));
+        }
+    }
+#elif defined(SDL_NEON_INTRINSICS)
+    for (; index + 4 <= count; index += 4)
+    {
+        uint32x4_t outside = vdupq_n_u32(0);
+        for (int i = 0; i < 6; i++)
+        {
+            const float* plane = camera->planes[i];
+            float32x4_t distance = vdupq_n_f32(plane[3]);
+            distance = vmlaq_n_f32(distance, vld1q_f32(points[i][0] + index), plane[0]);
+            distance = vmlaq_n_f32(distance, vld1q_f32(points[i][1] + index), plane[1]);
+            distance = vmlaq_n_f32(distance, vld1q_f32(points[i][2] + index), plane[2]);
+            outside = vorrq_u32(outside, vcltq_f32(distance, vdupq_n_f32(0.0f)));
+        }
+        visible[index + 0] = !vgetq_lane_u32(outside, 0);
+        visible[index + 1] = !vgetq_lane_u32(outside, 1);
+        visible[index + 2] = !vgetq_lane_u32(outside, 2);
+        visible[index + 3] = !vgetq_lane_u32(outside, 3);
+    }
+#endif
+    for (; index < count; index++)
+    {
+        visible[index] = true;
+        for (int i = 0; i < 6; i++)
+        {
+            const float* plane = camera->planes[i];
+            float distance = plane[3];
+            distance += plane[0] * points[i][0][index];
+            distance += plane[1] * points[i][1][index];
+            distance += plane[2] * points[i][2][index];
+            if (distance < 0.0f)
+            {
+                visible[index] = false;
+                break;
+            }
+        }
+    }
+}
@@ -14,6 +14,7 @@ typedef struct Camera
     float view[4][4];
     float proj[4][4];
     float matrix[4][4];
+    float inverse[4][4];
     float planes[6][4];
     union
     {
@@ -49,3 +50,4 @@ void Camera_Resize(Camera* camera, int width, int height);
 void Camera_Rotate(Camera* camera, float pitch, float yaw);
 void Camera_GetVector(const Camera* camera, float* x, float* y, float* z);
 bool Camera_IsVisible(const Camera* camera, float x, float y, float z, float width, float height, float depth);
+void Camera_AreVisible(const Camera* camera, const float* const min[3], const float* const max[3], int count, bool* visible);
@@ -0,0 +1,197 @@
+#include <SDL3/SDL.h>
+
+#include "buffer.h"
+#include "camera.h"
+#include "cloud.h"
+#include "rand.h"
+#include "world.h"
+
+// tiles generated per frame, so streaming new tiles never stalls a frame
+#define MAX_TILES 8
+
+// cloud thickness for every column of a chunk sized tile, or -1 for none
+typedef struct CloudTile
+{
+    Sint32 x;
+    Sint32 z;
+    bool is_valid;
+    Sint8 scales[CHUNK_WIDTH][CHUNK_WIDTH];
+} CloudTile;
+
+// a run of columns along x with the same thickness, drawn as one box
+typedef struct CloudInstance
+{
+    Sint32 x;
+    Sint32 z;
+    Sint32 width;
+    Sint32 scale;
+} CloudInstance;
+
+static SDL_GPUDevice* device;
+static CloudTile tiles[WORLD_WIDTH][WORLD_WIDTH];
+static int sorted_tiles[WORLD_WIDTH * WORLD_WIDTH][2];
+static int cloud_x;
+static int cloud_z;
+static int version;
+static CPUBuffer cpu_instances;
+static GPUBuffer gpu_instances[WORLD_FRAMES];
+static int gpu_versions[WORLD_FRAMES];
+
+static int SortFunction(void* userdata, const void* lhs, const void* rhs)
+{
+    int center = *(int*) userdata;
+    const int* l = lhs;
+    const int* r = rhs;
+    int dl = (l[0] - center) * (l[0] - center) + (l[1] - center) * (l[1] - center);
+    int dr = (r[0] - center) * (r[0] - center) + (r[1] - center) * (r[1] - center);
+    return (dl > dr) - (dl < dr);
+}
+
+void Cloud_Init(SDL_GPUDevice* in_device)
+{
+    device = in_device;
+    cloud_x = SDL_MAX_SINT32;
+    cloud_z = SDL_MAX_SINT32;
+    version = 0;
+    CPUBuffer_Init(&cpu_instances, sizeof(CloudInstance));
+    for (int i = 0; i < WORLD_FRAMES; i++)
+    {
+        GPUBuffer_Init(&gpu_instances[i], device, SDL_GPU_BUFFERUSAGE_VERTEX);
+        gpu_versions[i] = -1;
+    }
+    for (int x = 0; x < WORLD_WIDTH; x++)
+    for (int z = 0; z < WORLD_WIDTH; z++)
+    {
+        tiles[x][z].is_valid = false;
+        int index = x * WORLD_WIDTH + z;
+        sorted_tiles[index][0] = x;
+        sorted_tiles[index][1] = z;
+    }
+    int center = WORLD_WIDTH / 2;
+    SDL_qsort_r(sorted_tiles, WORLD_WIDTH * WORLD_WIDTH, sizeof(int) * 2, SortFunction, &center);
+}
+
+void Cloud_Free()
+{
+    CPUBuffer_Free(&cpu_instances);
+    for (int i = 0; i < WORLD_FRAMES; i++)
+    {
+        GPUBuffer_Free(&gpu_instances[i]);
+    }
+}
+
+static int GetTileIndex(int index)
+{
+    return (index % WORLD_WIDTH + WORLD_WIDTH) % WORLD_WIDTH;
+}
+
+static void GenerateTile(CloudTile* tile, int x, int z)
+{
+    tile->x = x;
+    tile->z = z;
+    tile->is_valid = true;
+    for (int i = 0; i < CHUNK_WIDTH; i++)
+    for (int j = 0; j < CHUNK_WIDTH; j++)
+    {
+        tile->scales[i][j] = Rand_GetCloud(x * CHUNK_WIDTH + i, z * CHUNK_WIDTH + j);
+    }
+}
+
+static bool IsTileInWindow(const CloudTile* tile)
+{
+    if (!tile->is_valid)
+    {
+        return false;
+    }
+    int x = tile->x - cloud_x;
+    int z = tile->z - cloud_z;
+    return x >= 0 && z >= 0 && x < WORLD_WIDTH && z < WORLD_WIDTH;
+}
+
+static void AppendTile(const CloudTile* tile)
+{
+    for (int z = 0; z < CHUNK_WIDTH; z++)
+    {
+        int width = 0;
+        for (int x = 0; x < CHUNK_WIDTH; x += width)
+        {
+            int scale = tile->scales[x][z];
+            width = 1;
+            while (x + width < CHUNK_WIDTH && tile->scales[x + width][z] == scale)
+            {
+                width++;
+            }
+            if (scale < 0)
+            {
+                continue;
+            }
+            CloudInstance instance;
+            instance.x = tile->x * CHUNK_WIDTH + x;
+            instance.z = tile->z * CHUNK_WIDTH + z;
+            instance.width = width;
+            instance.scale = scale;
+            CPUBuffer_Append(&cpu_instances, &instance);
+        }
+    }
+}
+
+void Cloud_Prepare(const Camera* camera, int frame)
+{
+    SDL_assert(frame >= 0 && frame < WORLD_FRAMES);
+    int x = SDL_floorf(camera->x / CHUNK_WIDTH) - WORLD_WIDTH / 2;
+    int z = SDL_floorf(camera->z / CHUNK_WIDTH) - WORLD_WIDTH / 2;
+    if (x != cloud_x || z != cloud_z)
+    {
+        cloud_x = x;
+        cloud_z = z;
+        version++;
+    }
+    int count = 0;
+    for (int i = 0; i < WORLD_WIDTH * WORLD_WIDTH && count < MAX_TILES; i++)
+    {
+        int tx = cloud_x + sorted_tiles[i][0];
+        int tz = cloud_z + sorted_tiles[i][1];
+        CloudTile* tile = &tiles[GetTileIndex(tx)][GetTileIndex(tz)];
+        if (tile->is_valid && tile->x == tx && tile->z == tz)
+        {
+            continue;
+        }
+        GenerateTile(tile, tx, tz);
+        count++;
+    }
+    if (count)
+    {
+        version++;
+    }
+    // each frame keeps its own buffer, so the one being drawn is never rewritten
+    if (gpu_versions[frame] == version)
+    {
+        return;
+    }
+    for (int i = 0; i < WORLD_WIDTH; i++)
+    for (int j = 0; j < WORLD_WIDTH; j++)
+    {
+        if (IsTileInWindow(&tiles[i][j]))
+        {
+            AppendTile(&tiles[i][j]);
+        }
+    }
+    GPUBuffer_Upload(&gpu_instances[frame], &cpu_instances);
+    gpu_versions[frame] = version;
+}
+
+void Cloud_Render(const Camera* camera, int frame, SDL_GPUCommandBuffer* command_buffer, SDL_GPURenderPass* render_pass)
+{
+    SDL_assert(frame >= 0 && frame < WORLD_FRAMES);
+    const GPUBuffer* instances = &gpu_instances[frame];
+    if (!instances->size)
+    {
+        return;
+    }
+    SDL_PushGPUVertexUniformData(command_buffer, 0, camera->proj, sizeof(camera->proj));
+    SDL_PushGPUVertexUniformData(command_buffer, 1, camera->view, sizeof(camera->view));
+    SDL_GPUBufferBinding vertex_binding = {0};
+    vertex_binding.buffer = instances->buffer;
+    SDL_BindGPUVertexBuffers(render_pass, 0, &vertex_binding, 1);
+    SDL_DrawGPUPrimitives(render_pass, 36, instances->size, 0, 0);
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+typedef struct Camera Camera;
+
+void Cloud_Init(SDL_GPUDevice* device);
+void Cloud_Free();
+void Cloud_Prepare(const Camera* camera, int frame);
+void Cloud_Render(const Camera* camera, int frame, SDL_GPUCommandBuffer* command_buffer, SDL_GPURenderPass* render_pass);
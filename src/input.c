@@ -25,6 +25,7 @@ static float rotation[2];                      // k&m / touch / gamepad
 static bool jump;                              // k&m / touch / gamepad
 static bool sprint;                            // k&m / touch / gamepad
 static bool break_block;                       // k&m / touch / gamepad
+static bool break_area;                        // k&m
 static bool select_block;                      // k&m / touch / gamepad
 static bool place_block;                       // k&m / touch / gamepad
 static int change_block;                       // k&m / touch / gamepad
@@ -115,6 +116,7 @@ static void SetDevice(InputDevice in_device)
     jump = false;
     sprint = false;
     break_block = false;
+    break_area = false;
     select_block = false;
     place_block = false;
     change_block = 0;
@@ -163,6 +165,10 @@ SDL_AppResult Input_Event(const SDL_Event* event)
         {
             reset_sky = true;
         }
+        else if (event->key.scancode == SDL_SCANCODE_X)
+        {
+            break_area = true;
+        }
         break;
     }
     case SDL_EVENT_MOUSE_BUTTON_DOWN:
@@ -366,6 +372,7 @@ void Input_Update(float dt)
     SDL_zeroa(rotation);
     change_block = 0;
     break_block = false;
+    break_area = false;
     place_block = false;
     select_block = false;
     toggle_controller = false;
@@ -451,6 +458,11 @@ bool Input_GetBreakBlock()
     return break_block;
 }
 
+bool Input_GetBreakArea()
+{
+    return break_area;
+}
+
 bool Input_GetSelectBlock()
 {
     return select_block;
@@ -21,6 +21,7 @@ void Input_GetRotation(float rotation[2]);
 bool Input_GetJump();
 bool Input_GetSprint();
 bool Input_GetBreakBlock();
+bool Input_GetBreakArea();
 bool Input_GetSelectBlock();
 bool Input_GetPlaceBlock();
 int Input_GetChangeBlock();
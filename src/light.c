@@ -0,0 +1,73 @@
+#include <SDL3/SDL.h>
+
+#include "block.h"
+#include "light.h"
+#include "voxel.inc"
+#include "world.h"
+
+bool Light_IsInBox(const Light* light, int x, int z, const float min[3], const float max[3])
+{
+    // matches the light origin used by GetLight in shader.hlsl
+    float position[3] = {light->x + 0.5f - x, light->y + 1.0f, light->z + 0.5f - z};
+    float distance = 0.0f;
+    for (int i = 0; i < 3; i++)
+    {
+        float offset = position[i] - SDL_clamp(position[i], min[i], max[i]);
+        distance += offset * offset;
+    }
+    return distance < light->radius * light->radius;
+}
+
+bool Light_IsInChunk(const Light* light, int x, int z)
+{
+    static const float MIN[3] = {0.0f, 0.0f, 0.0f};
+    static const float MAX[3] = {CHUNK_WIDTH, CHUNK_HEIGHT, CHUNK_WIDTH};
+    return Light_IsInBox(light, x, z, MIN, MAX);
+}
+
+bool Light_IsInCell(const Light* light, int x, int z, int cx, int cy, int cz)
+{
+    float min[3] = {cx * LIGHT_CELL_WIDTH, cy * LIGHT_CELL_HEIGHT, cz * LIGHT_CELL_WIDTH};
+    float max[3] = {min[0] + LIGHT_CELL_WIDTH, min[1] + LIGHT_CELL_HEIGHT, min[2] + LIGHT_CELL_WIDTH};
+    return Light_IsInBox(light, x, z, min, max);
+}
+
+static int AddCellLights(void* userdata, const Light* lights, int count, int x, int z, int cx, int cy, int cz, LightAddLight callback)
+{
+    int size = 0;
+    for (int i = 0; i < count; i++)
+    {
+        const Light* light = &lights[i];
+        if (!Light_IsInCell(light, x, z, cx, cy, cz))
+        {
+            continue;
+        }
+        if (callback)
+        {
+            callback(userdata, light);
+        }
+        size++;
+    }
+    return size;
+}
+
+void Light_GenerateGrid(void* userdata, const Light* lights, int count, int x, int z, LightAddLight callback)
+{
+    Sint32 offset = LIGHT_GRID_SIZE;
+    for (int cx = 0; cx < LIGHT_GRID_WIDTH; cx++)
+    for (int cy = 0; cy < LIGHT_GRID_HEIGHT; cy++)
+    for (int cz = 0; cz < LIGHT_GRID_WIDTH; cz++)
+    {
+        Light header = {0};
+        header.x = offset;
+        header.y = AddCellLights(NULL, lights, count, x, z, cx, cy, cz, NULL);
+        offset += header.y;
+        callback(userdata, &header);
+    }
+    for (int cx = 0; cx < LIGHT_GRID_WIDTH && count; cx++)
+    for (int cy = 0; cy < LIGHT_GRID_HEIGHT; cy++)
+    for (int cz = 0; cz < LIGHT_GRID_WIDTH; cz++)
+    {
+        AddCellLights(userdata, lights, count, x, z, cx, cy, cz, callback);
+    }
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+#include "block.h"
+
+typedef void (*LightAddLight)(void* userdata, const Light* light);
+
+// boxes are relative to the chunk at x and z
+bool Light_IsInBox(const Light* light, int x, int z, const float min[3], const float max[3]);
+bool Light_IsInChunk(const Light* light, int x, int z);
+bool Light_IsInCell(const Light* light, int x, int z, int cx, int cy, int cz);
+
+// adds one header per cell (x is the offset and y the count) followed by the lights of each cell
+void Light_GenerateGrid(void* userdata, const Light* lights, int count, int x, int z, LightAddLight callback);
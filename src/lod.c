@@ -0,0 +1,394 @@
+#include <SDL3/SDL.h>
+
+#include "buffer.h"
+#include "camera.h"
+#include "lod.h"
+#include "rand.h"
+#include "voxel.inc"
+#include "worker.h"
+#include "world.h"
+
+// level i samples the terrain every 2^(i + 1) blocks and spans WORLD_WIDTH tiles
+// of LOD_TILE_WIDTH samples, so each level covers twice the width of the one inside it
+#define LOD_LEVELS 3
+#define LOD_TILE_WIDTH CHUNK_WIDTH
+#define LOD_TILE_VERTICES ((LOD_TILE_WIDTH + 1) * (LOD_TILE_WIDTH + 1))
+#define LOD_TILE_INDICES (LOD_TILE_WIDTH * LOD_TILE_WIDTH * 6)
+#define LOD_PAGE_SIZE (1 << 20)
+#define LOD_BATCH 8
+
+typedef struct LodTile
+{
+    Sint32 x;
+    Sint32 z;
+    bool is_assigned;
+    bool is_ready;
+    Uint64 published;
+    GPUAllocation render_mesh;
+    GPUAllocation update_mesh;
+} LodTile;
+
+typedef struct LodInstance
+{
+    Sint32 x;
+    Sint32 z;
+    Sint32 scale;
+    Sint32 padding;
+} LodInstance;
+
+typedef struct LodDraw
+{
+    Uint32 page;
+    Uint32 offset;
+} LodDraw;
+
+typedef struct LodDrawList
+{
+    GPUBuffer instances;
+    LodDraw draws[LOD_LEVELS][WORLD_WIDTH * WORLD_WIDTH];
+    int draw_counts[LOD_LEVELS];
+    WorldCoverage coverages[LOD_LEVELS];
+} LodDrawList;
+
+typedef struct LodJob
+{
+    LodTile* tiles[LOD_BATCH];
+    int levels[LOD_BATCH];
+    int count;
+    CPUBuffer vertices;
+} LodJob;
+
+static SDL_GPUDevice* device;
+static Worker worker;
+static LodJob job;
+static GPUBuffer gpu_indices;
+static GPUHeap gpu_vertices;
+static LodTile tiles[LOD_LEVELS][WORLD_WIDTH][WORLD_WIDTH];
+static int sorted_tiles[WORLD_WIDTH * WORLD_WIDTH][2];
+static CPUBuffer cpu_instances;
+static LodDrawList draw_lists[WORLD_FRAMES];
+static Uint64 prepares;
+
+static int SortFunction(void* userdata, const void* lhs, const void* rhs)
+{
+    int center = *(int*) userdata;
+    const int* l = lhs;
+    const int* r = rhs;
+    int dl = (l[0] - center) * (l[0] - center) + (l[1] - center) * (l[1] - center);
+    int dr = (r[0] - center) * (r[0] - center) + (r[1] - center) * (r[1] - center);
+    return (dl > dr) - (dl < dr);
+}
+
+static int GetScale(int level)
+{
+    return 2 << level;
+}
+
+static int GetTileWidth(int level)
+{
+    return LOD_TILE_WIDTH * GetScale(level);
+}
+
+static int GetTileIndex(int index)
+{
+    return (index % WORLD_WIDTH + WORLD_WIDTH) % WORLD_WIDTH;
+}
+
+static void GenerateIndexBuffer()
+{
+    CPUBuffer indices;
+    CPUBuffer_Init(&indices, sizeof(Uint32));
+    for (Uint32 x = 0; x < LOD_TILE_WIDTH; x++)
+    for (Uint32 z = 0; z < LOD_TILE_WIDTH; z++)
+    {
+        Uint32 a = x * (LOD_TILE_WIDTH + 1) + z;
+        Uint32 b = a + LOD_TILE_WIDTH + 1;
+        const Uint32 quad[6] = {a, b, a + 1, a + 1, b, b + 1};
+        for (int i = 0; i < 6; i++)
+        {
+            CPUBuffer_Append(&indices, &quad[i]);
+        }
+    }
+    GPUBuffer_Upload(&gpu_indices, &indices);
+    CPUBuffer_Free(&indices);
+}
+
+void Lod_Init(SDL_GPUDevice* in_device)
+{
+    SDL_COMPILE_TIME_ASSERT("", LOD_TILE_WIDTH <= LOD_XZ_MASK);
+    SDL_COMPILE_TIME_ASSERT("", CHUNK_HEIGHT <= LOD_Y_MASK);
+    SDL_COMPILE_TIME_ASSERT("", LOD_BLOCK_OFFSET + BLOCK_BITS <= 32);
+    device = in_device;
+    prepares = 0;
+    GPUBuffer_Init(&gpu_indices, device, SDL_GPU_BUFFERUSAGE_INDEX);
+    GPUHeap_Init(&gpu_vertices, device, SDL_GPU_BUFFERUSAGE_VERTEX, sizeof(Uint32), LOD_PAGE_SIZE);
+    CPUBuffer_Init(&cpu_instances, sizeof(LodInstance));
+    CPUBuffer_Init(&job.vertices, sizeof(Uint32));
+    job.count = 0;
+    for (int i = 0; i < WORLD_FRAMES; i++)
+    {
+        LodDrawList* list = &draw_lists[i];
+        GPUBuffer_Init(&list->instances, device, SDL_GPU_BUFFERUSAGE_VERTEX);
+        for (int j = 0; j < LOD_LEVELS; j++)
+        {
+            list->draw_counts[j] = 0;
+        }
+    }
+    SDL_zeroa(tiles);
+    for (int x = 0; x < WORLD_WIDTH; x++)
+    for (int z = 0; z < WORLD_WIDTH; z++)
+    {
+        int index = x * WORLD_WIDTH + z;
+        sorted_tiles[index][0] = x;
+        sorted_tiles[index][1] = z;
+    }
+    int center = WORLD_WIDTH / 2;
+    SDL_qsort_r(sorted_tiles, WORLD_WIDTH * WORLD_WIDTH, sizeof(int) * 2, SortFunction, &center);
+    GenerateIndexBuffer();
+    Worker_Init(&worker);
+}
+
+void Lod_Free()
+{
+    Worker_Free(&worker);
+    CPUBuffer_Free(&job.vertices);
+    CPUBuffer_Free(&cpu_instances);
+    for (int i = 0; i < WORLD_FRAMES; i++)
+    {
+        GPUBuffer_Free(&draw_lists[i].instances);
+    }
+    GPUBuffer_Free(&gpu_indices);
+    GPUHeap_Free(&gpu_vertices);
+}
+
+static Uint32 PackVertex(int x, int y, int z, Block block)
+{
+    SDL_assert(x <= LOD_XZ_MASK);
+    SDL_assert(y <= LOD_Y_MASK);
+    SDL_assert(z <= LOD_XZ_MASK);
+    SDL_assert(block <= BLOCK_MASK);
+    Uint32 vertex = 0;
+    vertex |= x << LOD_X_OFFSET;
+    vertex |= z << LOD_Z_OFFSET;
+    vertex |= y << LOD_Y_OFFSET;
+    vertex |= block << LOD_BLOCK_OFFSET;
+    return vertex;
+}
+
+static void GenerateTile(LodTile* tile, int level, CPUBuffer* vertices)
+{
+    int scale = GetScale(level);
+    int width = GetTileWidth(level);
+    for (int x = 0; x <= LOD_TILE_WIDTH; x++)
+    for (int z = 0; z <= LOD_TILE_WIDTH; z++)
+    {
+        Block block;
+        int y = Rand_GetSurface(tile->x * width + x * scale, tile->z * width + z * scale, &block);
+        Uint32 vertex = PackVertex(x, y, z, block);
+        CPUBuffer_Append(vertices, &vertex);
+    }
+    GPUHeap_Upload(&gpu_vertices, &tile->update_mesh, vertices);
+}
+
+static void JobFunction(void* args)
+{
+    LodJob* job = args;
+    // far terrain is never urgent, so it yields to chunk workers and the renderer
+    SDL_SetCurrentThreadPriority(SDL_THREAD_PRIORITY_LOW);
+    for (int i = 0; i < job->count; i++)
+    {
+        GenerateTile(job->tiles[i], job->levels[i], &job->vertices);
+    }
+}
+
+static void GetLevelOrigin(const Camera* camera, int level, int* x, int* z)
+{
+    int width = GetTileWidth(level);
+    *x = SDL_floorf(camera->x / width) - WORLD_WIDTH / 2;
+    *z = SDL_floorf(camera->z / width) - WORLD_WIDTH / 2;
+}
+
+static void PublishJob()
+{
+    for (int i = 0; i < job.count; i++)
+    {
+        LodTile* tile = job.tiles[i];
+        GPUAllocation mesh = tile->render_mesh;
+        tile->render_mesh = tile->update_mesh;
+        tile->update_mesh = mesh;
+        tile->is_ready = tile->render_mesh.size == LOD_TILE_VERTICES;
+        tile->published = prepares;
+    }
+    job.count = 0;
+}
+
+static void DispatchJob(const Camera* camera)
+{
+    for (int level = 0; level < LOD_LEVELS && job.count < LOD_BATCH; level++)
+    {
+        int origin[2];
+        GetLevelOrigin(camera, level, &origin[0], &origin[1]);
+        for (int i = 0; i < WORLD_WIDTH * WORLD_WIDTH && job.count < LOD_BATCH; i++)
+        {
+            int x = origin[0] + sorted_tiles[i][0];
+            int z = origin[1] + sorted_tiles[i][1];
+            LodTile* tile = &tiles[level][GetTileIndex(x)][GetTileIndex(z)];
+            bool is_current = tile->is_assigned && tile->x == x && tile->z == z;
+            if (is_current && tile->is_ready)
+            {
+                continue;
+            }
+            // the update mesh was drawn until this prepare and may still be in flight
+            if (tile->published == prepares)
+            {
+                continue;
+            }
+            tile->x = x;
+            tile->z = z;
+            tile->is_assigned = true;
+            tile->is_ready = false;
+            job.tiles[job.count] = tile;
+            job.levels[job.count++] = level;
+        }
+    }
+    if (job.count)
+    {
+        Worker_Dispatch(&worker, JobFunction, &job);
+    }
+}
+
+static bool IsCovered(const WorldCoverage* coverage, int x, int z, int width)
+{
+    int x1 = SDL_floorf((float) (x - coverage->x) / coverage->cell_width);
+    int z1 = SDL_floorf((float) (z - coverage->z) / coverage->cell_width);
+    int x2 = SDL_ceilf((float) (x + width - coverage->x) / coverage->cell_width);
+    int z2 = SDL_ceilf((float) (z + width - coverage->z) / coverage->cell_width);
+    if (x1 < 0 || z1 < 0 || x2 > coverage->cell_count || z2 > coverage->cell_count)
+    {
+        return false;
+    }
+    for (int i = x1; i < x2; i++)
+    for (int j = z1; j < z2; j++)
+    {
+        int index = i * coverage->cell_count + j;
+        if (!(coverage->mask[index / 32] & (1u << (index % 32))))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void GetLevelCoverage(const Camera* camera, int level, WorldCoverage* coverage)
+{
+    int width = GetTileWidth(level);
+    SDL_zerop(coverage);
+    GetLevelOrigin(camera, level, &coverage->x, &coverage->z);
+    for (int i = 0; i < WORLD_WIDTH; i++)
+    for (int j = 0; j < WORLD_WIDTH; j++)
+    {
+        const LodTile* tile = &tiles[level][GetTileIndex(coverage->x + i)][GetTileIndex(coverage->z + j)];
+        if (tile->is_ready && tile->x == coverage->x + i && tile->z == coverage->z + j)
+        {
+            int index = i * WORLD_WIDTH + j;
+            coverage->mask[index / 32] |= 1u << (index % 32);
+        }
+    }
+    coverage->x *= width;
+    coverage->z *= width;
+    coverage->cell_width = width;
+    coverage->cell_count = WORLD_WIDTH;
+}
+
+void Lod_Prepare(const Camera* camera, int frame)
+{
+    SDL_assert(frame >= 0 && frame < WORLD_FRAMES);
+    LodDrawList* list = &draw_lists[frame];
+    prepares++;
+    if (!Worker_IsBusy(&worker))
+    {
+        PublishJob();
+        DispatchJob(camera);
+    }
+    // each level is hidden wherever the level inside it, or the loaded chunks, already draw
+    list->coverages[0] = World_GetCoverage(frame);
+    for (int level = 1; level < LOD_LEVELS; level++)
+    {
+        GetLevelCoverage(camera, level - 1, &list->coverages[level]);
+    }
+    for (int level = 0; level < LOD_LEVELS; level++)
+    {
+        list->draw_counts[level] = 0;
+        int width = GetTileWidth(level);
+        int origin[2];
+        GetLevelOrigin(camera, level, &origin[0], &origin[1]);
+        for (int i = 0; i < WORLD_WIDTH; i++)
+        for (int j = 0; j < WORLD_WIDTH; j++)
+        {
+            int x = origin[0] + i;
+            int z = origin[1] + j;
+            const LodTile* tile = &tiles[level][GetTileIndex(x)][GetTileIndex(z)];
+            if (!tile->is_ready || tile->x != x || tile->z != z)
+            {
+                continue;
+            }
+            if (IsCovered(&list->coverages[level], x * width, z * width, width))
+            {
+                continue;
+            }
+            if (!Camera_IsVisible(camera, x * width, 0.0f, z * width, width, CHUNK_HEIGHT, width))
+            {
+                continue;
+            }
+            LodInstance instance = {x * width, z * width, GetScale(level), 0};
+            CPUBuffer_Append(&cpu_instances, &instance);
+            LodDraw* draw = &list->draws[level][list->draw_counts[level]++];
+            draw->page = tile->render_mesh.page;
+            draw->offset = tile->render_mesh.offset;
+        }
+    }
+    GPUBuffer_Upload(&list->instances, &cpu_instances);
+}
+
+void Lod_Render(const Camera* camera, int frame, SDL_GPUCommandBuffer* command_buffer, SDL_GPURenderPass* render_pass)
+{
+    SDL_assert(frame >= 0 && frame < WORLD_FRAMES);
+    const LodDrawList* list = &draw_lists[frame];
+    if (!list->instances.size)
+    {
+        return;
+    }
+    SDL_PushGPUVertexUniformData(command_buffer, 0, camera->proj, sizeof(camera->proj));
+    SDL_PushGPUVertexUniformData(command_buffer, 1, camera->view, sizeof(camera->view));
+    SDL_GPUBufferBinding index_binding = {0};
+    index_binding.buffer = gpu_indices.buffer;
+    SDL_BindGPUIndexBuffer(render_pass, &index_binding, SDL_GPU_INDEXELEMENTSIZE_32BIT);
+    Uint32 instance = 0;
+    for (int level = 0; level < LOD_LEVELS; level++)
+    {
+        if (!list->draw_counts[level])
+        {
+            continue;
+        }
+        SDL_PushGPUFragmentUniformData(command_buffer, 0, &list->coverages[level], sizeof(list->coverages[level]));
+        Uint32 page = SDL_MAX_UINT32;
+        for (int i = 0; i < list->draw_counts[level]; i++)
+        {
+            const LodDraw* draw = &list->draws[level][i];
+            if (draw->page != page)
+            {
+                page = draw->page;
+                SDL_GPUBufferBinding vertex_bindings[2] = {0};
+                vertex_bindings[0].buffer = GPUHeap_GetBuffer(&gpu_vertices, page);
+                vertex_bindings[1].buffer = list->instances.buffer;
+                SDL_BindGPUVertexBuffers(render_pass, 0, vertex_bindings, 2);
+            }
+            SDL_DrawGPUIndexedPrimitives(render_pass, LOD_TILE_INDICES, 1, 0, draw->offset, instance++);
+        }
+    }
+}
+
+void Lod_GetStats(BufferStats* stats)
+{
+    GPUHeap_GetStats(&gpu_vertices, stats);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+typedef struct BufferStats BufferStats;
+typedef struct Camera Camera;
+
+void Lod_Init(SDL_GPUDevice* device);
+void Lod_Free();
+void Lod_Prepare(const Camera* camera, int frame);
+void Lod_Render(const Camera* camera, int frame, SDL_GPUCommandBuffer* command_buffer, SDL_GPURenderPass* render_pass);
+void Lod_GetStats(BufferStats* stats);
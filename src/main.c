@@ -3,48 +3,91 @@
 #include <SDL3/SDL_main.h>
 
 #include "block.h"
+#include "buffer.h"
+#include "cache.h"
 #include "camera.h"
+#include "cloud.h"
 #include "hud.inc"
 #include "input.h"
+#include "lod.h"
 #include "player.h"
 #include "save.h"
 #include "shader.h"
 #include "sky.h"
+#include "worker.h"
 #include "world.h"
 
 static const int MIP_LEVELS = 4;
 static const Uint64 SAVE_INTERVAL = 10000;
 static const Uint64 LOAD_INTERVAL = 500; // preload for 500 ms to avoid spawning inside of chunks
+static const Uint64 STATS_INTERVAL = 1000;
 #if defined(SDL_PLATFORM_ANDROID) || defined(SDL_PLATFORM_IOS)
 static const SDL_GPUSampleCount SAMPLE_COUNT = SDL_GPU_SAMPLECOUNT_1;
-static const SDL_GPUTextureFormat POSITION_FORMAT = SDL_GPU_TEXTUREFORMAT_R16G16B16A16_FLOAT;
 #else
 static const SDL_GPUSampleCount SAMPLE_COUNT = SDL_GPU_SAMPLECOUNT_4;
-static const SDL_GPUTextureFormat POSITION_FORMAT = SDL_GPU_TEXTUREFORMAT_R32G32B32A32_FLOAT;
 #endif
+// multisampled depth can't be sampled or resolved, so the opaque pass also writes its depth to a color target.
+// it's kept without multisampling too since the passes that sample it still depth test against depth_texture
+static const SDL_GPUTextureFormat DEPTH_COPY_FORMAT = SDL_GPU_TEXTUREFORMAT_R32_FLOAT;
+static const SDL_GPUTextureFormat GBUFFER_FORMAT = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
+
+typedef enum GBuffer
+{
+    GBUFFER_ALBEDO,
+    GBUFFER_NORMAL,
+    GBUFFER_LIGHT,
+    GBUFFER_COUNT,
+} GBuffer;
+
+// state a frame is rendered from, copied before the world is updated for the next frame
+typedef struct Frame
+{
+    Camera camera;
+    Sky sky;
+    WorldQuery query;
+    Block block;
+    int index;
+} Frame;
 
 static SDL_Window* window;
 static SDL_GPUDevice* device;
 static SDL_GPUTextureFormat color_format;
 static SDL_GPUTextureFormat depth_format;
-static SDL_GPUGraphicsPipeline* opaque_pipeline;
-static SDL_GPUGraphicsPipeline* transparent_pipeline;
+static SDL_GPUGraphicsPipeline* opaque_pipelines[WORLD_MESH_VARIANT_COUNT];
+static SDL_GPUGraphicsPipeline* transparent_pipelines[WORLD_MESH_VARIANT_COUNT];
 static SDL_GPUGraphicsPipeline* sky_pipeline;
 static SDL_GPUGraphicsPipeline* raycast_pipeline;
 static SDL_GPUGraphicsPipeline* hud_pipeline;
+static SDL_GPUGraphicsPipeline* gbuffer_pipeline;
+static SDL_GPUGraphicsPipeline* composite_pipeline;
+static SDL_GPUGraphicsPipeline* lighting_pipeline;
+static SDL_GPUGraphicsPipeline* depth_pipeline;
+static SDL_GPUGraphicsPipeline* cloud_pipeline;
+static SDL_GPUGraphicsPipeline* lod_pipeline;
 static SDL_Surface* atlas_surface;
 static SDL_GPUTexture* atlas_texture;
 static SDL_GPUTexture* depth_texture;
-static SDL_GPUTexture* position_texture;
+static SDL_GPUTexture* depth_copy_texture;
 static SDL_GPUTexture* msaa_color_texture;
-static SDL_GPUTexture* msaa_position_texture;
+static SDL_GPUTexture* msaa_depth_copy_texture;
+static SDL_GPUTexture* gbuffer_textures[GBUFFER_COUNT];
+static SDL_GPUTexture* msaa_gbuffer_textures[GBUFFER_COUNT];
 static SDL_GPUBuffer* block_buffer;
 static SDL_GPUSampler* nearest_sampler;
 static Sky sky;
 static Player player;
+static Worker update_worker;
+static Frame frames[WORLD_FRAMES];
+static Frame* pending_frame;
 static Uint64 last_ticks;
 static Uint64 save_ticks;
 static Uint64 load_ticks;
+static Uint64 stats_ticks;
+static BufferStats last_stats;
+static bool is_logging_stats;
+static bool is_deferred;
+static bool is_depth_prepass;
+static bool is_baked;
 
 static bool CreateAtlas()
 {
@@ -178,36 +221,64 @@ static void SetWindowIcon()
     SDL_DestroySurface(icon);
 }
 
+static void GetVoxelInputState(SDL_GPUVertexInputState* state, SDL_GPUVertexAttribute vertex_attributes[3], SDL_GPUVertexBufferDescription vertex_buffers[2])
+{
+    vertex_attributes[0].format = SDL_GPU_VERTEXELEMENTFORMAT_UINT;
+    vertex_attributes[1].format = SDL_GPU_VERTEXELEMENTFORMAT_INT4;
+    vertex_attributes[1].location = 1;
+    vertex_attributes[1].buffer_slot = 1;
+    vertex_attributes[2].format = SDL_GPU_VERTEXELEMENTFORMAT_UINT;
+    vertex_attributes[2].location = 2;
+    if (is_baked)
+    {
+        vertex_attributes[2].offset = 4;
+        vertex_buffers[0].pitch = 8;
+    }
+    else
+    {
+        // voxels are only 4 bytes without baked lights, so the light reads the zero padding of the chunk instead
+        vertex_attributes[2].buffer_slot = 1;
+        vertex_attributes[2].offset = 12;
+        vertex_buffers[0].pitch = 4;
+    }
+    vertex_buffers[1].slot = 1;
+    vertex_buffers[1].pitch = 16;
+    vertex_buffers[1].input_rate = SDL_GPU_VERTEXINPUTRATE_INSTANCE;
+    state->num_vertex_attributes = 3;
+    state->vertex_attributes = vertex_attributes;
+    state->num_vertex_buffers = 2;
+    state->vertex_buffer_descriptions = vertex_buffers;
+}
+
 static bool CreateOpaquePipeline()
 {
     SDL_GPUColorTargetDescription color_targets[2] = {0};
     color_targets[0].format = color_format;
-    color_targets[1].format = POSITION_FORMAT;
-    SDL_GPUVertexAttribute vertex_attributes[1] = {0};
-    SDL_GPUVertexBufferDescription vertex_buffers[1] = {0};
-    vertex_attributes[0].format = SDL_GPU_VERTEXELEMENTFORMAT_UINT;
-    vertex_buffers[0].pitch = 4;
+    color_targets[1].format = DEPTH_COPY_FORMAT;
+    SDL_GPUVertexAttribute vertex_attributes[3] = {0};
+    SDL_GPUVertexBufferDescription vertex_buffers[2] = {0};
     SDL_GPUGraphicsPipelineCreateInfo info = {0};
     info.vertex_shader = Shader_Load(device, "opaque.vert");
-    info.fragment_shader = Shader_Load(device, "opaque.frag");
     info.target_info.num_color_targets = 2;
     info.target_info.color_target_descriptions = color_targets;
     info.target_info.has_depth_stencil_target = true;
     info.target_info.depth_stencil_format = depth_format;
-    info.vertex_input_state.num_vertex_attributes = 1;
-    info.vertex_input_state.vertex_attributes = vertex_attributes;
-    info.vertex_input_state.num_vertex_buffers = 1;
-    info.vertex_input_state.vertex_buffer_descriptions = vertex_buffers;
+    GetVoxelInputState(&info.vertex_input_state, vertex_attributes, vertex_buffers);
     info.depth_stencil_state.enable_depth_test = true;
-    info.depth_stencil_state.enable_depth_write = true;
-    info.depth_stencil_state.compare_op = SDL_GPU_COMPAREOP_LESS;
+    info.depth_stencil_state.enable_depth_write = !is_depth_prepass;
+    info.depth_stencil_state.compare_op = is_depth_prepass ? SDL_GPU_COMPAREOP_EQUAL : SDL_GPU_COMPAREOP_LESS;
     info.rasterizer_state.cull_mode = SDL_GPU_CULLMODE_BACK;
     info.rasterizer_state.front_face = SDL_GPU_FRONTFACE_CLOCKWISE;
     info.multisample_state.sample_count = SAMPLE_COUNT;
-    opaque_pipeline = SDL_CreateGPUGraphicsPipeline(device, &info);
+    static const char* FRAGMENT_SHADERS[WORLD_MESH_VARIANT_COUNT] = {"opaque_unlit.frag", "opaque.frag"};
+    for (int i = 0; i < WORLD_MESH_VARIANT_COUNT; i++)
+    {
+        info.fragment_shader = Shader_Load(device, FRAGMENT_SHADERS[i]);
+        opaque_pipelines[i] = SDL_CreateGPUGraphicsPipeline(device, &info);
+        SDL_ReleaseGPUShader(device, info.fragment_shader);
+    }
     SDL_ReleaseGPUShader(device, info.vertex_shader);
-    SDL_ReleaseGPUShader(device, info.fragment_shader);
-    return opaque_pipeline != NULL;
+    return opaque_pipelines[WORLD_MESH_VARIANT_UNLIT] && opaque_pipelines[WORLD_MESH_VARIANT_LIT];
 }
 
 static bool CreateTransparentPipeline()
@@ -221,39 +292,47 @@ static bool CreateTransparentPipeline()
     color_targets[0].blend_state.dst_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE_MINUS_SRC_ALPHA;
     color_targets[0].blend_state.color_blend_op = SDL_GPU_BLENDOP_ADD;
     color_targets[0].blend_state.alpha_blend_op = SDL_GPU_BLENDOP_ADD;
-    SDL_GPUVertexAttribute vertex_attributes[1] = {0};
-    SDL_GPUVertexBufferDescription vertex_buffers[1] = {0};
-    vertex_attributes[0].format = SDL_GPU_VERTEXELEMENTFORMAT_UINT;
-    vertex_buffers[0].pitch = 4;
+    SDL_GPUVertexAttribute vertex_attributes[3] = {0};
+    SDL_GPUVertexBufferDescription vertex_buffers[2] = {0};
     SDL_GPUGraphicsPipelineCreateInfo info = {0};
     info.vertex_shader = Shader_Load(device, "transparent.vert");
-    info.fragment_shader = Shader_Load(device, "transparent.frag");
     info.target_info.num_color_targets = 1;
     info.target_info.color_target_descriptions = color_targets;
     info.target_info.has_depth_stencil_target = true;
     info.target_info.depth_stencil_format = depth_format;
-    info.vertex_input_state.num_vertex_attributes = 1;
-    info.vertex_input_state.vertex_attributes = vertex_attributes;
-    info.vertex_input_state.num_vertex_buffers = 1;
-    info.vertex_input_state.vertex_buffer_descriptions = vertex_buffers;
+    GetVoxelInputState(&info.vertex_input_state, vertex_attributes, vertex_buffers);
     info.depth_stencil_state.enable_depth_test = true;
     info.depth_stencil_state.compare_op = SDL_GPU_COMPAREOP_LESS_OR_EQUAL;
     info.multisample_state.sample_count = SAMPLE_COUNT;
-    transparent_pipeline = SDL_CreateGPUGraphicsPipeline(device, &info);
+    static const char* FRAGMENT_SHADERS[WORLD_MESH_VARIANT_COUNT] = {"transparent_unlit.frag", "transparent.frag"};
+    for (int i = 0; i < WORLD_MESH_VARIANT_COUNT; i++)
+    {
+        info.fragment_shader = Shader_Load(device, FRAGMENT_SHADERS[i]);
+        transparent_pipelines[i] = SDL_CreateGPUGraphicsPipeline(device, &info);
+        SDL_ReleaseGPUShader(device, info.fragment_shader);
+    }
     SDL_ReleaseGPUShader(device, info.vertex_shader);
-    SDL_ReleaseGPUShader(device, info.fragment_shader);
-    return transparent_pipeline != NULL;
+    return transparent_pipelines[WORLD_MESH_VARIANT_UNLIT] && transparent_pipelines[WORLD_MESH_VARIANT_LIT];
 }
 
 static bool CreateSkyPipeline()
 {
-    SDL_GPUColorTargetDescription color_targets[2] = {0};
+    SDL_GPUColorTargetDescription color_targets[4] = {0};
     color_targets[0].format = color_format;
-    color_targets[1].format = POSITION_FORMAT;
+    color_targets[1].format = DEPTH_COPY_FORMAT;
+    if (is_deferred)
+    {
+        color_targets[0].format = GBUFFER_FORMAT;
+        for (int i = 2; i < 4; i++)
+        {
+            color_targets[i].format = GBUFFER_FORMAT;
+            color_targets[i].blend_state.enable_color_write_mask = true;
+        }
+    }
     SDL_GPUGraphicsPipelineCreateInfo info = {0};
     info.vertex_shader = Shader_Load(device, "sky.vert");
     info.fragment_shader = Shader_Load(device, "sky.frag");
-    info.target_info.num_color_targets = 2;
+    info.target_info.num_color_targets = is_deferred ? 4 : 2;
     info.target_info.color_target_descriptions = color_targets;
     info.target_info.has_depth_stencil_target = true;
     info.target_info.depth_stencil_format = depth_format;
@@ -317,6 +396,185 @@ static bool CreateHudPipeline()
     return hud_pipeline != NULL;
 }
 
+static bool CreateGBufferPipeline()
+{
+    SDL_GPUColorTargetDescription color_targets[4] = {0};
+    color_targets[0].format = GBUFFER_FORMAT;
+    color_targets[1].format = DEPTH_COPY_FORMAT;
+    color_targets[2].format = GBUFFER_FORMAT;
+    color_targets[3].format = GBUFFER_FORMAT;
+    SDL_GPUVertexAttribute vertex_attributes[3] = {0};
+    SDL_GPUVertexBufferDescription vertex_buffers[2] = {0};
+    SDL_GPUGraphicsPipelineCreateInfo info = {0};
+    info.vertex_shader = Shader_Load(device, "opaque.vert");
+    info.fragment_shader = Shader_Load(device, "gbuffer.frag");
+    info.target_info.num_color_targets = 4;
+    info.target_info.color_target_descriptions = color_targets;
+    info.target_info.has_depth_stencil_target = true;
+    info.target_info.depth_stencil_format = depth_format;
+    GetVoxelInputState(&info.vertex_input_state, vertex_attributes, vertex_buffers);
+    info.depth_stencil_state.enable_depth_test = true;
+    info.depth_stencil_state.enable_depth_write = !is_depth_prepass;
+    info.depth_stencil_state.compare_op = is_depth_prepass ? SDL_GPU_COMPAREOP_EQUAL : SDL_GPU_COMPAREOP_LESS;
+    info.rasterizer_state.cull_mode = SDL_GPU_CULLMODE_BACK;
+    info.rasterizer_state.front_face = SDL_GPU_FRONTFACE_CLOCKWISE;
+    info.multisample_state.sample_count = SAMPLE_COUNT;
+    gbuffer_pipeline = SDL_CreateGPUGraphicsPipeline(device, &info);
+    SDL_ReleaseGPUShader(device, info.vertex_shader);
+    SDL_ReleaseGPUShader(device, info.fragment_shader);
+    return gbuffer_pipeline != NULL;
+}
+
+static bool CreateDepthPipeline()
+{
+    SDL_GPUColorTargetDescription color_targets[4] = {0};
+    color_targets[0].format = is_deferred ? GBUFFER_FORMAT : color_format;
+    color_targets[1].format = DEPTH_COPY_FORMAT;
+    color_targets[2].format = GBUFFER_FORMAT;
+    color_targets[3].format = GBUFFER_FORMAT;
+    for (int i = 0; i < 4; i++)
+    {
+        color_targets[i].blend_state.enable_color_write_mask = true;
+    }
+    SDL_GPUVertexAttribute vertex_attributes[3] = {0};
+    SDL_GPUVertexBufferDescription vertex_buffers[2] = {0};
+    SDL_GPUGraphicsPipelineCreateInfo info = {0};
+    info.vertex_shader = Shader_Load(device, "opaque.vert");
+    info.fragment_shader = Shader_Load(device, "depth.frag");
+    info.target_info.num_color_targets = is_deferred ? 4 : 2;
+    info.target_info.color_target_descriptions = color_targets;
+    info.target_info.has_depth_stencil_target = true;
+    info.target_info.depth_stencil_format = depth_format;
+    GetVoxelInputState(&info.vertex_input_state, vertex_attributes, vertex_buffers);
+    info.depth_stencil_state.enable_depth_test = true;
+    info.depth_stencil_state.enable_depth_write = true;
+    info.depth_stencil_state.compare_op = SDL_GPU_COMPAREOP_LESS;
+    info.rasterizer_state.cull_mode = SDL_GPU_CULLMODE_BACK;
+    info.rasterizer_state.front_face = SDL_GPU_FRONTFACE_CLOCKWISE;
+    info.multisample_state.sample_count = SAMPLE_COUNT;
+    depth_pipeline = SDL_CreateGPUGraphicsPipeline(device, &info);
+    SDL_ReleaseGPUShader(device, info.vertex_shader);
+    SDL_ReleaseGPUShader(device, info.fragment_shader);
+    return depth_pipeline != NULL;
+}
+
+static bool CreateCloudPipeline()
+{
+    SDL_GPUColorTargetDescription color_targets[4] = {0};
+    color_targets[0].format = is_deferred ? GBUFFER_FORMAT : color_format;
+    color_targets[1].format = DEPTH_COPY_FORMAT;
+    color_targets[2].format = GBUFFER_FORMAT;
+    color_targets[3].format = GBUFFER_FORMAT;
+    SDL_GPUVertexAttribute vertex_attributes[1] = {0};
+    SDL_GPUVertexBufferDescription vertex_buffers[1] = {0};
+    vertex_attributes[0].format = SDL_GPU_VERTEXELEMENTFORMAT_INT4;
+    vertex_buffers[0].pitch = 16;
+    vertex_buffers[0].input_rate = SDL_GPU_VERTEXINPUTRATE_INSTANCE;
+    SDL_GPUGraphicsPipelineCreateInfo info = {0};
+    info.vertex_shader = Shader_Load(device, "cloud.vert");
+    info.fragment_shader = Shader_Load(device, is_deferred ? "cloud_gbuffer.frag" : "cloud.frag");
+    info.target_info.num_color_targets = is_deferred ? 4 : 2;
+    info.target_info.color_target_descriptions = color_targets;
+    info.target_info.has_depth_stencil_target = true;
+    info.target_info.depth_stencil_format = depth_format;
+    info.vertex_input_state.num_vertex_attributes = 1;
+    info.vertex_input_state.vertex_attributes = vertex_attributes;
+    info.vertex_input_state.num_vertex_buffers = 1;
+    info.vertex_input_state.vertex_buffer_descriptions = vertex_buffers;
+    info.depth_stencil_state.enable_depth_test = true;
+    info.depth_stencil_state.enable_depth_write = true;
+    info.depth_stencil_state.compare_op = SDL_GPU_COMPAREOP_LESS;
+    info.multisample_state.sample_count = SAMPLE_COUNT;
+    cloud_pipeline = SDL_CreateGPUGraphicsPipeline(device, &info);
+    SDL_ReleaseGPUShader(device, info.vertex_shader);
+    SDL_ReleaseGPUShader(device, info.fragment_shader);
+    return cloud_pipeline != NULL;
+}
+
+static bool CreateLodPipeline()
+{
+    SDL_GPUColorTargetDescription color_targets[4] = {0};
+    color_targets[0].format = is_deferred ? GBUFFER_FORMAT : color_format;
+    color_targets[1].format = DEPTH_COPY_FORMAT;
+    color_targets[2].format = GBUFFER_FORMAT;
+    color_targets[3].format = GBUFFER_FORMAT;
+    SDL_GPUVertexAttribute vertex_attributes[2] = {0};
+    SDL_GPUVertexBufferDescription vertex_buffers[2] = {0};
+    vertex_attributes[0].format = SDL_GPU_VERTEXELEMENTFORMAT_UINT;
+    vertex_attributes[1].format = SDL_GPU_VERTEXELEMENTFORMAT_INT4;
+    vertex_attributes[1].location = 1;
+    vertex_attributes[1].buffer_slot = 1;
+    vertex_buffers[0].pitch = 4;
+    vertex_buffers[1].slot = 1;
+    vertex_buffers[1].pitch = 16;
+    vertex_buffers[1].input_rate = SDL_GPU_VERTEXINPUTRATE_INSTANCE;
+    SDL_GPUGraphicsPipelineCreateInfo info = {0};
+    info.vertex_shader = Shader_Load(device, "lod.vert");
+    info.fragment_shader = Shader_Load(device, is_deferred ? "lod_gbuffer.frag" : "lod.frag");
+    info.target_info.num_color_targets = is_deferred ? 4 : 2;
+    info.target_info.color_target_descriptions = color_targets;
+    info.target_info.has_depth_stencil_target = true;
+    info.target_info.depth_stencil_format = depth_format;
+    info.vertex_input_state.num_vertex_attributes = 2;
+    info.vertex_input_state.vertex_attributes = vertex_attributes;
+    info.vertex_input_state.num_vertex_buffers = 2;
+    info.vertex_input_state.vertex_buffer_descriptions = vertex_buffers;
+    info.depth_stencil_state.enable_depth_test = true;
+    info.depth_stencil_state.enable_depth_write = true;
+    info.depth_stencil_state.compare_op = SDL_GPU_COMPAREOP_LESS;
+    info.multisample_state.sample_count = SAMPLE_COUNT;
+    lod_pipeline = SDL_CreateGPUGraphicsPipeline(device, &info);
+    SDL_ReleaseGPUShader(device, info.vertex_shader);
+    SDL_ReleaseGPUShader(device, info.fragment_shader);
+    return lod_pipeline != NULL;
+}
+
+static bool CreateCompositePipeline()
+{
+    SDL_GPUColorTargetDescription color_target = {0};
+    color_target.format = color_format;
+    SDL_GPUGraphicsPipelineCreateInfo info = {0};
+    info.vertex_shader = Shader_Load(device, "composite.vert");
+    info.fragment_shader = Shader_Load(device, "composite.frag");
+    info.target_info.num_color_targets = 1;
+    info.target_info.color_target_descriptions = &color_target;
+    info.target_info.has_depth_stencil_target = true;
+    info.target_info.depth_stencil_format = depth_format;
+    info.multisample_state.sample_count = SAMPLE_COUNT;
+    composite_pipeline = SDL_CreateGPUGraphicsPipeline(device, &info);
+    SDL_ReleaseGPUShader(device, info.vertex_shader);
+    SDL_ReleaseGPUShader(device, info.fragment_shader);
+    return composite_pipeline != NULL;
+}
+
+static bool CreateLightingPipeline()
+{
+    SDL_GPUColorTargetDescription color_target = {0};
+    color_target.format = color_format;
+    color_target.blend_state.enable_blend = true;
+    color_target.blend_state.src_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ZERO;
+    color_target.blend_state.dst_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE;
+    color_target.blend_state.src_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE;
+    color_target.blend_state.dst_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE;
+    color_target.blend_state.color_blend_op = SDL_GPU_BLENDOP_ADD;
+    color_target.blend_state.alpha_blend_op = SDL_GPU_BLENDOP_ADD;
+    SDL_GPUGraphicsPipelineCreateInfo info = {0};
+    info.vertex_shader = Shader_Load(device, "lighting.vert");
+    info.fragment_shader = Shader_Load(device, "lighting.frag");
+    info.target_info.num_color_targets = 1;
+    info.target_info.color_target_descriptions = &color_target;
+    info.target_info.has_depth_stencil_target = true;
+    info.target_info.depth_stencil_format = depth_format;
+    // only the back of the chunk volume lies behind the surfaces inside of it
+    info.depth_stencil_state.enable_depth_test = true;
+    info.depth_stencil_state.compare_op = SDL_GPU_COMPAREOP_GREATER_OR_EQUAL;
+    info.multisample_state.sample_count = SAMPLE_COUNT;
+    lighting_pipeline = SDL_CreateGPUGraphicsPipeline(device, &info);
+    SDL_ReleaseGPUShader(device, info.vertex_shader);
+    SDL_ReleaseGPUShader(device, info.fragment_shader);
+    return lighting_pipeline != NULL;
+}
+
 static bool CreateSamplers()
 {
     SDL_GPUSamplerCreateInfo info = {0};
@@ -341,6 +599,32 @@ SDL_AppResult SDLCALL SDL_AppInit(void** appstate, int argc, char** argv)
     SDL_SetLogPriorities(SDL_LOG_PRIORITY_VERBOSE);
 #endif
     SDL_SetAppMetadata("Blocks", NULL, NULL);
+    SaveBackend save_backend = SAVE_BACKEND_SQLITE;
+    WorldLighting lighting = WORLD_LIGHTING_DYNAMIC;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!SDL_strcmp(argv[i], "--region"))
+        {
+            save_backend = SAVE_BACKEND_REGION;
+        }
+        else if (!SDL_strcmp(argv[i], "--baked-lights"))
+        {
+            lighting = WORLD_LIGHTING_BAKED;
+            is_baked = true;
+        }
+        else if (!SDL_strcmp(argv[i], "--deferred"))
+        {
+            is_deferred = true;
+        }
+        else if (!SDL_strcmp(argv[i], "--depth-prepass"))
+        {
+            is_depth_prepass = true;
+        }
+        else if (!SDL_strcmp(argv[i], "--stats"))
+        {
+            is_logging_stats = true;
+        }
+    }
     if (!SDL_Init(SDL_INIT_VIDEO | SDL_INIT_GAMEPAD))
     {
         SDL_Log("Failed to initialize SDL: %s", SDL_GetError());
@@ -371,6 +655,11 @@ SDL_AppResult SDLCALL SDL_AppInit(void** appstate, int argc, char** argv)
         SDL_Log("Failed to claim window: %s", SDL_GetError());
         return SDL_APP_FAILURE;
     }
+    if (!Buffer_Init(device))
+    {
+        SDL_Log("Failed to initialize buffers");
+        return SDL_APP_FAILURE;
+    }
     SDL_SetGPUSwapchainParameters(device, window, SDL_GPU_SWAPCHAINCOMPOSITION_SDR, SDL_GPU_PRESENTMODE_MAILBOX);
     color_format = SDL_GetGPUSwapchainTextureFormat(device, window);
     depth_format = SDL_GPU_TEXTUREFORMAT_D32_FLOAT;
@@ -384,6 +673,12 @@ SDL_AppResult SDLCALL SDL_AppInit(void** appstate, int argc, char** argv)
         SDL_Log("Failed to create samplers: %s", SDL_GetError());
         return SDL_APP_FAILURE;
     }
+    // created first since the opaque pipelines only skip depth writes when the prepass exists
+    if (is_depth_prepass && !CreateDepthPipeline())
+    {
+        SDL_Log("Failed to create depth pipeline: %s", SDL_GetError());
+        is_depth_prepass = false;
+    }
     if (!CreateOpaquePipeline())
     {
         SDL_Log("Failed to create opaque pipeline: %s", SDL_GetError());
@@ -409,6 +704,31 @@ SDL_AppResult SDLCALL SDL_AppInit(void** appstate, int argc, char** argv)
         SDL_Log("Failed to create ui pipeline: %s", SDL_GetError());
         return SDL_APP_FAILURE;
     }
+    if (is_deferred && !CreateGBufferPipeline())
+    {
+        SDL_Log("Failed to create gbuffer pipeline: %s", SDL_GetError());
+        return SDL_APP_FAILURE;
+    }
+    if (is_deferred && !CreateCompositePipeline())
+    {
+        SDL_Log("Failed to create composite pipeline: %s", SDL_GetError());
+        return SDL_APP_FAILURE;
+    }
+    if (is_deferred && !CreateLightingPipeline())
+    {
+        SDL_Log("Failed to create lighting pipeline: %s", SDL_GetError());
+        return SDL_APP_FAILURE;
+    }
+    // clouds are only scenery, so the world still renders without them
+    if (!CreateCloudPipeline())
+    {
+        SDL_Log("Failed to create cloud pipeline: %s", SDL_GetError());
+    }
+    // distant terrain is only drawn past the loaded chunks, so the world still renders without it
+    if (!CreateLodPipeline())
+    {
+        SDL_Log("Failed to create lod pipeline: %s", SDL_GetError());
+    }
     block_buffer = Block_GetBuffer(device);
     if (!block_buffer)
     {
@@ -417,40 +737,64 @@ SDL_AppResult SDLCALL SDL_AppInit(void** appstate, int argc, char** argv)
     }
     SDL_FlashWindow(window, SDL_FLASH_BRIEFLY);
     SetWindowIcon();
-    Save_Init();
+    Save_Init(save_backend, NULL);
+    Cache_Init();
     Input_Init(window);
     Sky_Load(&sky);
-    World_Init(device);
+    World_Init(device, lighting);
+    Lod_Init(device);
+    Cloud_Init(device);
     Player_Load(&player);
     Sky_Update(&sky, 0.0f);
     World_Update(&player.camera);
+    Worker_Init(&update_worker);
     last_ticks = SDL_GetTicks();
     save_ticks = last_ticks;
     load_ticks = last_ticks;
+    stats_ticks = last_ticks;
     return SDL_APP_CONTINUE;
 }
 
 void SDLCALL SDL_AppQuit(void* appstate, SDL_AppResult result)
 {
     SDL_HideWindow(window);
+    Worker_Free(&update_worker);
+    Cloud_Free();
+    Lod_Free();
     World_Free();
+    Buffer_Free(device);
     Player_Save(&player);
     Sky_Save(&sky);
     Save_Free();
+    Cache_Free();
     Input_Free();
     SDL_ReleaseGPUSampler(device, nearest_sampler);
-    SDL_ReleaseGPUTexture(device, msaa_position_texture);
+    for (int i = 0; i < GBUFFER_COUNT; i++)
+    {
+        SDL_ReleaseGPUTexture(device, msaa_gbuffer_textures[i]);
+        SDL_ReleaseGPUTexture(device, gbuffer_textures[i]);
+    }
+    SDL_ReleaseGPUTexture(device, msaa_depth_copy_texture);
     SDL_ReleaseGPUTexture(device, msaa_color_texture);
-    SDL_ReleaseGPUTexture(device, position_texture);
+    SDL_ReleaseGPUTexture(device, depth_copy_texture);
     SDL_ReleaseGPUTexture(device, depth_texture);
     SDL_ReleaseGPUTexture(device, atlas_texture);
     SDL_ReleaseGPUBuffer(device, block_buffer);
     SDL_DestroySurface(atlas_surface);
+    SDL_ReleaseGPUGraphicsPipeline(device, lod_pipeline);
+    SDL_ReleaseGPUGraphicsPipeline(device, cloud_pipeline);
+    SDL_ReleaseGPUGraphicsPipeline(device, depth_pipeline);
+    SDL_ReleaseGPUGraphicsPipeline(device, lighting_pipeline);
+    SDL_ReleaseGPUGraphicsPipeline(device, composite_pipeline);
+    SDL_ReleaseGPUGraphicsPipeline(device, gbuffer_pipeline);
     SDL_ReleaseGPUGraphicsPipeline(device, hud_pipeline);
     SDL_ReleaseGPUGraphicsPipeline(device, raycast_pipeline);
     SDL_ReleaseGPUGraphicsPipeline(device, sky_pipeline);
-    SDL_ReleaseGPUGraphicsPipeline(device, transparent_pipeline);
-    SDL_ReleaseGPUGraphicsPipeline(device, opaque_pipeline);
+    for (int i = 0; i < WORLD_MESH_VARIANT_COUNT; i++)
+    {
+        SDL_ReleaseGPUGraphicsPipeline(device, transparent_pipelines[i]);
+        SDL_ReleaseGPUGraphicsPipeline(device, opaque_pipelines[i]);
+    }
     SDL_ReleaseWindowFromGPUDevice(device, window);
     SDL_DestroyGPUDevice(device);
     SDL_DestroyWindow(window);
@@ -460,13 +804,20 @@ void SDLCALL SDL_AppQuit(void* appstate, SDL_AppResult result)
 static bool Resize(int width, int height)
 {
     SDL_ReleaseGPUTexture(device, depth_texture);
-    SDL_ReleaseGPUTexture(device, position_texture);
+    SDL_ReleaseGPUTexture(device, depth_copy_texture);
     SDL_ReleaseGPUTexture(device, msaa_color_texture);
-    SDL_ReleaseGPUTexture(device, msaa_position_texture);
+    SDL_ReleaseGPUTexture(device, msaa_depth_copy_texture);
     depth_texture = NULL;
-    position_texture = NULL;
+    depth_copy_texture = NULL;
     msaa_color_texture = NULL;
-    msaa_position_texture = NULL;
+    msaa_depth_copy_texture = NULL;
+    for (int i = 0; i < GBUFFER_COUNT; i++)
+    {
+        SDL_ReleaseGPUTexture(device, gbuffer_textures[i]);
+        SDL_ReleaseGPUTexture(device, msaa_gbuffer_textures[i]);
+        gbuffer_textures[i] = NULL;
+        msaa_gbuffer_textures[i] = NULL;
+    }
     SDL_GPUTextureCreateInfo info = {0};
     info.type = SDL_GPU_TEXTURETYPE_2D;
     info.format = depth_format;
@@ -483,14 +834,24 @@ static bool Resize(int width, int height)
         return false;
     }
     info.sample_count = SDL_GPU_SAMPLECOUNT_1;
-    info.format = POSITION_FORMAT;
+    info.format = DEPTH_COPY_FORMAT;
     info.usage = SDL_GPU_TEXTUREUSAGE_COLOR_TARGET | SDL_GPU_TEXTUREUSAGE_SAMPLER;
-    position_texture = SDL_CreateGPUTexture(device, &info);
-    if (!position_texture)
+    depth_copy_texture = SDL_CreateGPUTexture(device, &info);
+    if (!depth_copy_texture)
     {
-        SDL_Log("Failed to create position texture: %s", SDL_GetError());
+        SDL_Log("Failed to create depth copy texture: %s", SDL_GetError());
         return false;
     }
+    info.format = GBUFFER_FORMAT;
+    for (int i = 0; i < GBUFFER_COUNT && is_deferred; i++)
+    {
+        gbuffer_textures[i] = SDL_CreateGPUTexture(device, &info);
+        if (!gbuffer_textures[i])
+        {
+            SDL_Log("Failed to create gbuffer texture: %s", SDL_GetError());
+            return false;
+        }
+    }
     if (SAMPLE_COUNT == SDL_GPU_SAMPLECOUNT_1)
     {
         Camera_Resize(&player.camera, width, height);
@@ -505,39 +866,85 @@ static bool Resize(int width, int height)
         SDL_Log("Failed to create multisample color texture: %s", SDL_GetError());
         return false;
     }
-    info.format = POSITION_FORMAT;
-    msaa_position_texture = SDL_CreateGPUTexture(device, &info);
-    if (!msaa_position_texture)
+    info.format = DEPTH_COPY_FORMAT;
+    msaa_depth_copy_texture = SDL_CreateGPUTexture(device, &info);
+    if (!msaa_depth_copy_texture)
     {
-        SDL_Log("Failed to create multisample position texture: %s", SDL_GetError());
+        SDL_Log("Failed to create multisample depth copy texture: %s", SDL_GetError());
         return false;
     }
+    info.format = GBUFFER_FORMAT;
+    for (int i = 0; i < GBUFFER_COUNT && is_deferred; i++)
+    {
+        msaa_gbuffer_textures[i] = SDL_CreateGPUTexture(device, &info);
+        if (!msaa_gbuffer_textures[i])
+        {
+            SDL_Log("Failed to create multisample gbuffer texture: %s", SDL_GetError());
+            return false;
+        }
+    }
     Camera_Resize(&player.camera, width, height);
     return true;
 }
 
-static void RenderOpaquePass(SDL_GPUCommandBuffer* command_buffer, SDL_GPUTexture* swapchain_texture)
+// player position followed by the inverse view projection, for shaders that rebuild positions from depth
+static void PushInverseUniforms(SDL_GPUCommandBuffer* command_buffer, Uint32 slot, const Camera* camera)
+{
+    float uniforms[20] = {0};
+    SDL_memcpy(uniforms, camera->position, sizeof(camera->position));
+    SDL_memcpy(uniforms + 4, camera->inverse, sizeof(camera->inverse));
+    SDL_PushGPUFragmentUniformData(command_buffer, slot, uniforms, sizeof(uniforms));
+}
+
+static void GetGBufferTarget(GBuffer gbuffer, SDL_GPUColorTargetInfo* color_info)
 {
-    SDL_GPUColorTargetInfo color_info[2] = {0};
+    color_info->load_op = SDL_GPU_LOADOP_CLEAR;
+    color_info->cycle = true;
+    if (SAMPLE_COUNT != SDL_GPU_SAMPLECOUNT_1)
+    {
+        color_info->texture = msaa_gbuffer_textures[gbuffer];
+        color_info->store_op = SDL_GPU_STOREOP_RESOLVE;
+        color_info->resolve_texture = gbuffer_textures[gbuffer];
+        color_info->cycle_resolve_texture = true;
+    }
+    else
+    {
+        color_info->texture = gbuffer_textures[gbuffer];
+        color_info->store_op = SDL_GPU_STOREOP_STORE;
+    }
+}
+
+static void RenderOpaquePass(const Frame* frame, SDL_GPUCommandBuffer* command_buffer, SDL_GPUTexture* swapchain_texture)
+{
+    SDL_GPUColorTargetInfo color_info[4] = {0};
     color_info[0].load_op = SDL_GPU_LOADOP_CLEAR;
     color_info[0].store_op = SDL_GPU_STOREOP_STORE;
     color_info[1].load_op = SDL_GPU_LOADOP_CLEAR;
+    color_info[1].clear_color.r = 1.0f;
     color_info[1].cycle = true;
     if (SAMPLE_COUNT != SDL_GPU_SAMPLECOUNT_1)
     {
         color_info[0].texture = msaa_color_texture;
         color_info[0].cycle = true;
-        color_info[1].texture = msaa_position_texture;
+        color_info[1].texture = msaa_depth_copy_texture;
         color_info[1].store_op = SDL_GPU_STOREOP_RESOLVE;
-        color_info[1].resolve_texture = position_texture;
+        color_info[1].resolve_texture = depth_copy_texture;
         color_info[1].cycle_resolve_texture = true;
     }
     else
     {
         color_info[0].texture = swapchain_texture;
-        color_info[1].texture = position_texture;
+        color_info[1].texture = depth_copy_texture;
         color_info[1].store_op = SDL_GPU_STOREOP_STORE;
     }
+    if (is_deferred)
+    {
+        SDL_GPUColorTargetInfo position_info = color_info[1];
+        GetGBufferTarget(GBUFFER_ALBEDO, &color_info[0]);
+        GetGBufferTarget(GBUFFER_NORMAL, &color_info[2]);
+        GetGBufferTarget(GBUFFER_LIGHT, &color_info[3]);
+        color_info[1] = position_info;
+    }
     SDL_GPUDepthStencilTargetInfo depth_info = {0};
     depth_info.load_op = SDL_GPU_LOADOP_CLEAR;
     depth_info.stencil_load_op = SDL_GPU_LOADOP_CLEAR;
@@ -545,34 +952,119 @@ static void RenderOpaquePass(SDL_GPUCommandBuffer* command_buffer, SDL_GPUTextur
     depth_info.texture = depth_texture;
     depth_info.clear_depth = 1.0f;
     depth_info.cycle = true;
-    SDL_GPURenderPass* render_pass = SDL_BeginGPURenderPass(command_buffer, color_info, 2, &depth_info);
+    SDL_GPURenderPass* render_pass = SDL_BeginGPURenderPass(command_buffer, color_info, is_deferred ? 4 : 2, &depth_info);
     if (!render_pass)
     {
         SDL_Log("Failed to begin render pass: %s", SDL_GetError());
         return;
     }
+    SDL_GPUTextureSamplerBinding sampler_binding = {0};
+    sampler_binding.texture = atlas_texture;
+    sampler_binding.sampler = nearest_sampler;
+    if (is_depth_prepass)
+    {
+        SDL_PushGPUDebugGroup(command_buffer, "depth");
+        SDL_BindGPUGraphicsPipeline(render_pass, depth_pipeline);
+        SDL_BindGPUFragmentSamplers(render_pass, 0, &sampler_binding, 1);
+        SDL_BindGPUFragmentStorageBuffers(render_pass, 0, &block_buffer, 1);
+        for (int i = 0; i < WORLD_MESH_VARIANT_COUNT; i++)
+        {
+            World_Render(&frame->camera, frame->index, WORLD_MESH_TYPE_OPAQUE, i, command_buffer, render_pass);
+        }
+        SDL_PopGPUDebugGroup(command_buffer);
+    }
     SDL_PushGPUDebugGroup(command_buffer, "sky");
     SDL_BindGPUGraphicsPipeline(render_pass, sky_pipeline);
-    SDL_PushGPUVertexUniformData(command_buffer, 0, player.camera.proj, sizeof(player.camera.proj));
-    SDL_PushGPUVertexUniformData(command_buffer, 1, player.camera.view, sizeof(player.camera.view));
-    SDL_PushGPUFragmentUniformData(command_buffer, 0, sky.sun, sizeof(float) * 16);
+    SDL_PushGPUVertexUniformData(command_buffer, 0, frame->camera.proj, sizeof(frame->camera.proj));
+    SDL_PushGPUVertexUniformData(command_buffer, 1, frame->camera.view, sizeof(frame->camera.view));
+    SDL_PushGPUFragmentUniformData(command_buffer, 0, frame->sky.sun, sizeof(float) * 16);
     SDL_DrawGPUPrimitives(render_pass, 36, 1, 0, 0);
     SDL_PopGPUDebugGroup(command_buffer);
-    SDL_GPUTextureSamplerBinding sampler_binding = {0};
-    sampler_binding.texture = atlas_texture;
-    sampler_binding.sampler = nearest_sampler;
     SDL_PushGPUDebugGroup(command_buffer, "opaque");
-    SDL_BindGPUGraphicsPipeline(render_pass, opaque_pipeline);
-    SDL_PushGPUFragmentUniformData(command_buffer, 1, player.camera.position, sizeof(player.camera.position));
-    SDL_PushGPUFragmentUniformData(command_buffer, 2, sky.sun, sizeof(float) * 16);
-    SDL_BindGPUFragmentSamplers(render_pass, 0, &sampler_binding, 1);
-    SDL_BindGPUFragmentStorageBuffers(render_pass, 0, &block_buffer, 1);
-    World_Render(&player.camera, WORLD_MESH_TYPE_OPAQUE, command_buffer, render_pass);
+    // the G-buffer pass never reads lights so both variants share its pipeline
+    for (int i = 0; i < WORLD_MESH_VARIANT_COUNT; i++)
+    {
+        SDL_BindGPUGraphicsPipeline(render_pass, is_deferred ? gbuffer_pipeline : opaque_pipelines[i]);
+        SDL_PushGPUFragmentUniformData(command_buffer, 0, frame->camera.position, sizeof(frame->camera.position));
+        SDL_PushGPUFragmentUniformData(command_buffer, 1, frame->sky.sun, sizeof(float) * 16);
+        SDL_BindGPUFragmentSamplers(render_pass, 0, &sampler_binding, 1);
+        SDL_BindGPUFragmentStorageBuffers(render_pass, 0, &block_buffer, 1);
+        World_Render(&frame->camera, frame->index, WORLD_MESH_TYPE_OPAQUE, i, command_buffer, render_pass);
+    }
+    SDL_PopGPUDebugGroup(command_buffer);
+    if (lod_pipeline)
+    {
+        SDL_PushGPUDebugGroup(command_buffer, "lod");
+        SDL_BindGPUGraphicsPipeline(render_pass, lod_pipeline);
+        SDL_PushGPUFragmentUniformData(command_buffer, 1, frame->camera.position, sizeof(frame->camera.position));
+        SDL_PushGPUFragmentUniformData(command_buffer, 2, frame->sky.sun, sizeof(float) * 16);
+        SDL_BindGPUFragmentSamplers(render_pass, 0, &sampler_binding, 1);
+        SDL_BindGPUFragmentStorageBuffers(render_pass, 0, &block_buffer, 1);
+        Lod_Render(&frame->camera, frame->index, command_buffer, render_pass);
+        SDL_PopGPUDebugGroup(command_buffer);
+    }
+    if (cloud_pipeline)
+    {
+        SDL_PushGPUDebugGroup(command_buffer, "cloud");
+        SDL_BindGPUGraphicsPipeline(render_pass, cloud_pipeline);
+        SDL_PushGPUFragmentUniformData(command_buffer, 0, frame->camera.position, sizeof(frame->camera.position));
+        SDL_PushGPUFragmentUniformData(command_buffer, 1, frame->sky.sun, sizeof(float) * 16);
+        Cloud_Render(&frame->camera, frame->index, command_buffer, render_pass);
+        SDL_PopGPUDebugGroup(command_buffer);
+    }
+    SDL_EndGPURenderPass(render_pass);
+}
+
+static void RenderLightingPass(const Frame* frame, SDL_GPUCommandBuffer* command_buffer, SDL_GPUTexture* swapchain_texture)
+{
+    SDL_GPUColorTargetInfo color_info = {0};
+    color_info.load_op = SDL_GPU_LOADOP_DONT_CARE;
+    color_info.store_op = SDL_GPU_STOREOP_STORE;
+    if (SAMPLE_COUNT != SDL_GPU_SAMPLECOUNT_1)
+    {
+        color_info.texture = msaa_color_texture;
+        color_info.cycle = true;
+    }
+    else
+    {
+        color_info.texture = swapchain_texture;
+    }
+    SDL_GPUDepthStencilTargetInfo depth_info = {0};
+    depth_info.load_op = SDL_GPU_LOADOP_LOAD;
+    depth_info.store_op = SDL_GPU_STOREOP_STORE;
+    depth_info.texture = depth_texture;
+    SDL_GPURenderPass* render_pass = SDL_BeginGPURenderPass(command_buffer, &color_info, 1, &depth_info);
+    if (!render_pass)
+    {
+        SDL_Log("Failed to begin render pass: %s", SDL_GetError());
+        return;
+    }
+    SDL_GPUTextureSamplerBinding sampler_bindings[4] = {0};
+    sampler_bindings[0].texture = gbuffer_textures[GBUFFER_ALBEDO];
+    sampler_bindings[1].texture = depth_copy_texture;
+    sampler_bindings[2].texture = gbuffer_textures[GBUFFER_NORMAL];
+    sampler_bindings[3].texture = gbuffer_textures[GBUFFER_LIGHT];
+    for (int i = 0; i < 4; i++)
+    {
+        sampler_bindings[i].sampler = nearest_sampler;
+    }
+    SDL_PushGPUDebugGroup(command_buffer, "composite");
+    SDL_BindGPUGraphicsPipeline(render_pass, composite_pipeline);
+    PushInverseUniforms(command_buffer, 0, &frame->camera);
+    SDL_PushGPUFragmentUniformData(command_buffer, 1, frame->sky.sun, sizeof(float) * 16);
+    SDL_BindGPUFragmentSamplers(render_pass, 0, sampler_bindings, 4);
+    SDL_DrawGPUPrimitives(render_pass, 3, 1, 0, 0);
+    SDL_PopGPUDebugGroup(command_buffer);
+    SDL_PushGPUDebugGroup(command_buffer, "lighting");
+    SDL_BindGPUGraphicsPipeline(render_pass, lighting_pipeline);
+    PushInverseUniforms(command_buffer, 1, &frame->camera);
+    SDL_BindGPUFragmentSamplers(render_pass, 0, sampler_bindings, 3);
+    World_RenderLights(&frame->camera, frame->index, command_buffer, render_pass);
     SDL_PopGPUDebugGroup(command_buffer);
     SDL_EndGPURenderPass(render_pass);
 }
 
-static void RenderTransparentPass(SDL_GPUCommandBuffer* command_buffer, SDL_GPUTexture* swapchain_texture)
+static void RenderTransparentPass(const Frame* frame, SDL_GPUCommandBuffer* command_buffer, SDL_GPUTexture* swapchain_texture)
 {
     SDL_GPUColorTargetInfo color_info = {0};
     color_info.load_op = SDL_GPU_LOADOP_LOAD;
@@ -600,29 +1092,32 @@ static void RenderTransparentPass(SDL_GPUCommandBuffer* command_buffer, SDL_GPUT
     SDL_GPUTextureSamplerBinding sampler_bindings[2] = {0};
     sampler_bindings[0].texture = atlas_texture;
     sampler_bindings[0].sampler = nearest_sampler;
-    sampler_bindings[1].texture = position_texture;
+    sampler_bindings[1].texture = depth_copy_texture;
     sampler_bindings[1].sampler = nearest_sampler;
     SDL_PushGPUDebugGroup(command_buffer, "transparent");
-    SDL_BindGPUGraphicsPipeline(render_pass, transparent_pipeline);
-    SDL_PushGPUFragmentUniformData(command_buffer, 1, player.camera.position, sizeof(player.camera.position));
-    SDL_PushGPUFragmentUniformData(command_buffer, 2, sky.sun, sizeof(float) * 16);
-    SDL_BindGPUFragmentSamplers(render_pass, 0, sampler_bindings, 2);
-    SDL_BindGPUFragmentStorageBuffers(render_pass, 0, &block_buffer, 1);
-    World_Render(&player.camera, WORLD_MESH_TYPE_TRANSPARENT, command_buffer, render_pass);
+    for (int i = 0; i < WORLD_MESH_VARIANT_COUNT; i++)
+    {
+        SDL_BindGPUGraphicsPipeline(render_pass, transparent_pipelines[i]);
+        PushInverseUniforms(command_buffer, 0, &frame->camera);
+        SDL_PushGPUFragmentUniformData(command_buffer, 1, frame->sky.sun, sizeof(float) * 16);
+        SDL_BindGPUFragmentSamplers(render_pass, 0, sampler_bindings, 2);
+        SDL_BindGPUFragmentStorageBuffers(render_pass, 0, &block_buffer, 1);
+        World_Render(&frame->camera, frame->index, WORLD_MESH_TYPE_TRANSPARENT, i, command_buffer, render_pass);
+    }
     SDL_PopGPUDebugGroup(command_buffer);
-    if (player.query.block != BLOCK_EMPTY)
+    if (frame->query.block != BLOCK_EMPTY)
     {
         SDL_PushGPUDebugGroup(command_buffer, "raycast");
         SDL_BindGPUGraphicsPipeline(render_pass, raycast_pipeline);
-        SDL_PushGPUVertexUniformData(command_buffer, 0, player.camera.matrix, sizeof(player.camera.matrix));
-        SDL_PushGPUVertexUniformData(command_buffer, 1, player.query.current, sizeof(player.query.current));
+        SDL_PushGPUVertexUniformData(command_buffer, 0, frame->camera.matrix, sizeof(frame->camera.matrix));
+        SDL_PushGPUVertexUniformData(command_buffer, 1, frame->query.current, sizeof(frame->query.current));
         SDL_DrawGPUPrimitives(render_pass, 36, 1, 0, 0);
         SDL_PopGPUDebugGroup(command_buffer);
     }
     SDL_EndGPURenderPass(render_pass);
 }
 
-static void RenderHudPass(SDL_GPUCommandBuffer* command_buffer, SDL_GPUTexture* swapchain_texture)
+static void RenderHudPass(const Frame* frame, SDL_GPUCommandBuffer* command_buffer, SDL_GPUTexture* swapchain_texture)
 {
     SDL_GPUColorTargetInfo color_info = {0};
     color_info.load_op = SDL_GPU_LOADOP_LOAD;
@@ -637,14 +1132,14 @@ static void RenderHudPass(SDL_GPUCommandBuffer* command_buffer, SDL_GPUTexture*
     float safe[4];
     Input_GetSafeArea(safe);
     Sint32 hud[8] = {0};
-    hud[0] = player.camera.width;
-    hud[1] = player.camera.height;
+    hud[0] = frame->camera.width;
+    hud[1] = frame->camera.height;
     hud[2] = Input_GetDevice() == INPUT_DEVICE_TOUCH;
     for (int i = 0; i < 4; i++)
     {
         hud[4 + i] = safe[i];
     }
-    Uint32 block = Block_GetIndex(player.block, DIRECTION_NORTH);
+    Uint32 block = Block_GetIndex(frame->block, DIRECTION_NORTH);
     SDL_GPUTextureSamplerBinding sampler_binding = {0};
     sampler_binding.texture = atlas_texture;
     sampler_binding.sampler = nearest_sampler;
@@ -658,7 +1153,7 @@ static void RenderHudPass(SDL_GPUCommandBuffer* command_buffer, SDL_GPUTexture*
     SDL_EndGPURenderPass(render_pass);
 }
 
-static void Render()
+static void Render(Frame* frame)
 {
     SDL_GPUCommandBuffer* command_buffer = SDL_AcquireGPUCommandBuffer(device);
     if (!command_buffer)
@@ -680,18 +1175,61 @@ static void Render()
         SDL_SubmitGPUCommandBuffer(command_buffer);
         return;
     }
-    if ((width != player.camera.width || height != player.camera.height) && !Resize(width, height))
+    if (width != frame->camera.width || height != frame->camera.height)
     {
-        SDL_SubmitGPUCommandBuffer(command_buffer);
-        return;
+        if (!Resize(width, height))
+        {
+            SDL_SubmitGPUCommandBuffer(command_buffer);
+            return;
+        }
+        Camera_Resize(&frame->camera, width, height);
+        Camera_Update(&frame->camera);
     }
-    Camera_Update(&player.camera);
-    RenderOpaquePass(command_buffer, swapchain_texture);
-    RenderTransparentPass(command_buffer, swapchain_texture);
-    RenderHudPass(command_buffer, swapchain_texture);
+    RenderOpaquePass(frame, command_buffer, swapchain_texture);
+    if (is_deferred)
+    {
+        RenderLightingPass(frame, command_buffer, swapchain_texture);
+    }
+    RenderTransparentPass(frame, command_buffer, swapchain_texture);
+    RenderHudPass(frame, command_buffer, swapchain_texture);
     SDL_SubmitGPUCommandBuffer(command_buffer);
 }
 
+static void LogStats(Uint64 ticks)
+{
+    BufferStats stats = {0};
+    Buffer_GetStats(&stats);
+    World_GetStats(&stats);
+    Lod_GetStats(&stats);
+    float seconds = (ticks - stats_ticks) / 1000.0f;
+    float fragmentation = 0.0f;
+    if (stats.free_bytes)
+    {
+        fragmentation = 1.0f - (float) stats.largest_free_bytes / stats.free_bytes;
+    }
+    SDL_Log("Buffers: %.1f MB live, %.0f%% fragmented, %.1f allocations/s, %.1f device allocations/s",
+        stats.live_bytes / 1048576.0f, fragmentation * 100.0f,
+        (stats.allocations - last_stats.allocations) / seconds,
+        (stats.device_allocations - last_stats.device_allocations) / seconds);
+    WorldCulling culling = World_GetCulling();
+    SDL_Log("Chunks: %d drawn, %d frustum culled, %d occluded", culling.drawn, culling.culled, culling.occluded);
+    WorldMeshStats meshes = World_GetMeshStats();
+    int total = meshes.generated + meshes.shared + meshes.cached;
+    float hits = total ? (meshes.shared + meshes.cached) * 100.0f / total : 0.0f;
+    SDL_Log("Meshes: %d generated, %d shared, %d cached, %.0f%% cache hits", meshes.generated, meshes.shared, meshes.cached, hits);
+    stats_ticks = ticks;
+    last_stats = stats;
+}
+
+static void UpdateFunction(void* args)
+{
+    Frame* frame = args;
+    World_Update(&frame->camera);
+    World_Prepare(&frame->camera, frame->index);
+    Lod_Prepare(&frame->camera, frame->index);
+    Cloud_Prepare(&frame->camera, frame->index);
+}
+
 SDL_AppResult SDLCALL SDL_AppIterate(void* appstate)
 {
     Uint64 ticks = SDL_GetTicks();
@@ -700,17 +1238,38 @@ SDL_AppResult SDLCALL SDL_AppIterate(void* appstate)
     if (ticks - load_ticks < LOAD_INTERVAL)
     {
         World_Update(&player.camera);
+        Buffer_Flush(device);
         return SDL_APP_CONTINUE;
     }
+    // the world is only touched here while the update worker is idle, then the
+    // next frame is prepared on the worker while the pending one renders
+    Worker_Wait(&update_worker);
+    // copies staged by the prepare are submitted ahead of the frame that draws them
+    Buffer_Flush(device);
+    if (is_logging_stats && ticks - stats_ticks >= STATS_INTERVAL)
+    {
+        LogStats(ticks);
+    }
+    Frame* frame = pending_frame;
     if (Input_GetResetSky())
     {
         Sky_Reset(&sky);
     }
-    World_Update(&player.camera);
     Player_Update(&player, dt);
     Sky_Update(&sky, dt / 1000.0f);
     Input_Update(dt);
-    Render();
+    Camera_Update(&player.camera);
+    pending_frame = &frames[frame ? (frame->index + 1) % WORLD_FRAMES : 0];
+    pending_frame->camera = player.camera;
+    pending_frame->sky = sky;
+    pending_frame->query = player.query;
+    pending_frame->block = player.block;
+    pending_frame->index = pending_frame - frames;
+    Worker_Dispatch(&update_worker, UpdateFunction, pending_frame);
+    if (frame)
+    {
+        Render(frame);
+    }
     if (ticks - save_ticks >= SAVE_INTERVAL)
     {
         save_ticks = ticks;
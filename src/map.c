@@ -3,10 +3,11 @@
 #include "map.h"
 
 static const int EMPTY = 0;
-static const int TOMBSTONE = 255;
+static const Uint32 MIN_CAPACITY = 8;
 static const float MAX_LOAD_FACTOR = 0.75f;
+static const float MIN_LOAD_FACTOR = 0.125f;
 
-static int HashInt(int x)
+static Uint32 HashInt(Uint32 x)
 {
     x += (x << 10);
     x ^= (x >> 6);
@@ -16,7 +17,7 @@ static int HashInt(int x)
     return x;
 }
 
-static int HashPosition(int x, int y, int z)
+static Uint32 HashPosition(int x, int y, int z)
 {
     return HashInt(x) ^ HashInt(y) ^ HashInt(z);
 }
@@ -26,25 +27,50 @@ static bool IsEqual(MapRow row, int x, int y, int z)
     return row.x == x && row.y == y && row.z == z;
 }
 
-static void Grow(Map* map)
+// slots hold the row index plus one so that zero marks an empty slot
+static Uint32 FindSlot(const Map* map, int x, int y, int z)
+{
+    Uint32 mask = map->capacity - 1;
+    Uint32 index = HashPosition(x, y, z) & mask;
+    while (map->slots[index] && !IsEqual(map->rows[map->slots[index] - 1], x, y, z))
+    {
+        index = (index + 1) & mask;
+    }
+    return index;
+}
+
+static void Resize(Map* map, Uint32 capacity)
 {
     Map old_map = *map;
-    Map_Init(map, old_map.capacity * 2);
-    for (Uint32 i = 0; i < old_map.capacity; i++)
+    Map_Init(map, capacity);
+    if (!map->rows)
     {
-        if (Map_IsRowValid(&old_map, i))
-        {
-            MapRow row = old_map.rows[i];
-            Map_Set(map, row.x, row.y, row.z, row.value);
-        }
+        *map = old_map;
+        return;
     }
+    for (Uint32 i = 0; i < old_map.size; i++)
+    {
+        MapRow row = old_map.rows[i];
+        map->rows[i] = row;
+        map->slots[FindSlot(map, row.x, row.y, row.z)] = i + 1;
+    }
+    map->size = old_map.size;
     Map_Free(&old_map);
 }
 
 void Map_Init(Map* map, int capacity)
 {
     SDL_assert(SDL_HasExactlyOneBitSet32(capacity));
-    map->rows = SDL_calloc(capacity, sizeof(MapRow));
+    map->rows = SDL_malloc(capacity * sizeof(MapRow));
+    map->slots = SDL_calloc(capacity, sizeof(Uint32));
+    if (!map->rows || !map->slots)
+    {
+        SDL_Log("Failed to allocate map");
+        SDL_free(map->rows);
+        SDL_free(map->slots);
+        map->rows = NULL;
+        map->slots = NULL;
+    }
     map->capacity = capacity;
     map->size = 0;
 }
@@ -52,7 +78,9 @@ void Map_Init(Map* map, int capacity)
 void Map_Free(Map* map)
 {
     SDL_free(map->rows);
+    SDL_free(map->slots);
     map->rows = NULL;
+    map->slots = NULL;
     map->size = 0;
     map->capacity = 0;
 }
@@ -60,100 +88,93 @@ void Map_Free(Map* map)
 void Map_Set(Map* map, int x, int y, int z, int value)
 {
     SDL_assert(value <= SDL_MAX_UINT8);
-    SDL_assert(value != EMPTY && value != TOMBSTONE);
-    if ((float) (map->size + 1) / map->capacity > MAX_LOAD_FACTOR)
+    SDL_assert(value != EMPTY);
+    Uint32 index = FindSlot(map, x, y, z);
+    if (map->slots[index])
     {
-        Grow(map);
+        map->rows[map->slots[index] - 1].value = value;
+        return;
     }
-    Uint32 mask = map->capacity - 1;
-    Uint32 index = HashPosition(x, y, z) & mask;
-    Uint32 tombstone = SDL_MAX_UINT32;
-    for (;;)
+    if ((float) (map->size + 1) / map->capacity > MAX_LOAD_FACTOR)
     {
-        MapRow* row = &map->rows[index];
-        if (row->value == EMPTY)
-        {
-            if (tombstone != SDL_MAX_UINT32)
-            {
-                row = &map->rows[tombstone];
-            }
-            row->x = x;
-            row->y = y;
-            row->z = z;
-            row->value = value;
-            map->size++;
-            return;
-        }
-        if (row->value == TOMBSTONE)
-        {
-            if (tombstone == SDL_MAX_UINT32)
-            {
-                tombstone = index;
-            }
-        }
-        else if (IsEqual(*row, x, y, z))
-        {
-            row->value = value;
-            return;
-        }
-        index = (index + 1) & mask;
+        Resize(map, map->capacity * 2);
+        index = FindSlot(map, x, y, z);
     }
+    MapRow* row = &map->rows[map->size];
+    row->x = x;
+    row->y = y;
+    row->z = z;
+    row->value = value;
+    map->slots[index] = ++map->size;
 }
 
 int Map_Get(const Map* map, int x, int y, int z)
 {
-    Uint32 mask = map->capacity - 1;
-    Uint32 index = HashPosition(x, y, z) & mask;
-    for (;;)
+    Uint32 index = FindSlot(map, x, y, z);
+    if (map->slots[index])
     {
-        const MapRow row = map->rows[index];
-        if (row.value == EMPTY)
-        {
-            return EMPTY;
-        }
-        if (row.value != TOMBSTONE && IsEqual(row, x, y, z))
-        {
-            return row.value;
-        }
-        index = (index + 1) & mask;
+        return map->rows[map->slots[index] - 1].value;
     }
+    return EMPTY;
 }
 
 void Map_Remove(Map* map, int x, int y, int z)
 {
     Uint32 mask = map->capacity - 1;
-    Uint32 index = HashPosition(x, y, z) & mask;
+    Uint32 index = FindSlot(map, x, y, z);
+    if (!map->slots[index])
+    {
+        return;
+    }
+    Uint32 removed = map->slots[index] - 1;
+    // shift the rest of the cluster back instead of leaving a tombstone
+    Uint32 hole = index;
     for (;;)
     {
-        MapRow* row = &map->rows[index];
-        if (row->value == EMPTY)
+        index = (index + 1) & mask;
+        if (!map->slots[index])
         {
-            return;
+            break;
         }
-        if (row->value != TOMBSTONE && IsEqual(*row, x, y, z))
+        MapRow row = map->rows[map->slots[index] - 1];
+        Uint32 home = HashPosition(row.x, row.y, row.z) & mask;
+        if (hole <= index ? (hole < home && home <= index) : (hole < home || home <= index))
         {
-            row->value = TOMBSTONE;
-            map->size--;
-            return;
+            continue;
         }
-        index = (index + 1) & mask;
+        map->slots[hole] = map->slots[index];
+        hole = index;
+    }
+    map->slots[hole] = 0;
+    // move the last row into the hole to keep the rows dense
+    map->size--;
+    if (removed != map->size)
+    {
+        MapRow row = map->rows[map->size];
+        map->rows[removed] = row;
+        map->slots[FindSlot(map, row.x, row.y, row.z)] = removed + 1;
+    }
+    if (map->capacity > MIN_CAPACITY && (float) map->size / map->capacity < MIN_LOAD_FACTOR)
+    {
+        Resize(map, map->capacity / 2);
     }
 }
 
 void Map_Clear(Map* map)
 {
-    SDL_memset(map->rows, 0, map->capacity * sizeof(MapRow));
     map->size = 0;
-}
-
-bool Map_IsRowValid(const Map* map, Uint32 index)
-{
-    MapRow row = map->rows[index];
-    return row.value != EMPTY && row.value != TOMBSTONE;
+    if (map->capacity > MIN_CAPACITY)
+    {
+        Resize(map, MIN_CAPACITY);
+    }
+    else
+    {
+        SDL_memset(map->slots, 0, map->capacity * sizeof(Uint32));
+    }
 }
 
 MapRow Map_GetRow(const Map* map, Uint32 index)
 {
-    SDL_assert(Map_IsRowValid(map, index));
+    SDL_assert(index < map->size);
     return map->rows[index];
 }
@@ -13,6 +13,7 @@ typedef struct MapRow
 typedef struct Map
 {
     MapRow* rows;
+    Uint32* slots;
     Uint32 size;
     Uint32 capacity;
 } Map;
@@ -23,5 +24,4 @@ void Map_Set(Map* map, int x, int y, int z, int value);
 int Map_Get(const Map* map, int x, int y, int z);
 void Map_Remove(Map* map, int x, int y, int z);
 void Map_Clear(Map* map);
-bool Map_IsRowValid(const Map* map, Uint32 index);
 MapRow Map_GetRow(const Map* map, Uint32 index);
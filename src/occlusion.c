@@ -0,0 +1,245 @@
+#include <SDL3/SDL.h>
+
+#include "camera.h"
+#include "occlusion.h"
+
+static const float MAX_MOVE = 1.0f;
+static const float MAX_ROTATE = 0.02f;
+
+static void Transform(const float matrix[4][4], const float point[3], float clip[4])
+{
+    for (int i = 0; i < 4; i++)
+    {
+        clip[i] = matrix[0][i] * point[0] + matrix[1][i] * point[1] + matrix[2][i] * point[2] + matrix[3][i];
+    }
+}
+
+static void Project(const float clip[4], float screen[3])
+{
+    screen[0] = (clip[0] / clip[3] * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+    screen[1] = (clip[1] / clip[3] * 0.5f + 0.5f) * OCCLUSION_HEIGHT;
+    screen[2] = clip[2] / clip[3];
+}
+
+// clips against the near plane (z >= 0 in clip space)
+static int Clip(const float polygon[4][4], float clipped[5][4])
+{
+    int count = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        const float* a = polygon[i];
+        const float* b = polygon[(i + 1) % 4];
+        if (a[2] >= 0.0f)
+        {
+            SDL_memcpy(clipped[count++], a, sizeof(float) * 4);
+        }
+        if ((a[2] >= 0.0f) != (b[2] >= 0.0f))
+        {
+            float t = a[2] / (a[2] - b[2]);
+            for (int j = 0; j < 4; j++)
+            {
+                clipped[count][j] = a[j] + (b[j] - a[j]) * t;
+            }
+            count++;
+        }
+    }
+    return count;
+}
+
+static float Edge(const float a[3], const float b[3], float x, float y)
+{
+    return (b[0] - a[0]) * (y - a[1]) - (b[1] - a[1]) * (x - a[0]);
+}
+
+// only pixels the polygon covers entirely are written and each gets the farthest depth within it,
+// so a box is never hidden by the part of a pixel the occluder misses or by the near corner of a slope
+static void Rasterize(Occlusion* occlusion, const float polygon[5][3], int count)
+{
+    float area = 0.0f;
+    float triangle = 0.0f;
+    int apex = 1;
+    for (int i = 2; i < count; i++)
+    {
+        float fan = Edge(polygon[0], polygon[i - 1], polygon[i][0], polygon[i][1]);
+        area += fan;
+        if (SDL_fabsf(fan) > SDL_fabsf(triangle))
+        {
+            triangle = fan;
+            apex = i - 1;
+        }
+    }
+    if (SDL_fabsf(area) < SDL_FLT_EPSILON)
+    {
+        return;
+    }
+    // depth is affine in screen space across a planar face, so take its slope from the largest fan triangle
+    const float* a = polygon[0];
+    const float* b = polygon[apex];
+    const float* c = polygon[apex + 1];
+    float dx = ((b[2] - a[2]) * (c[1] - a[1]) - (c[2] - a[2]) * (b[1] - a[1])) / triangle;
+    float dy = ((c[2] - a[2]) * (b[0] - a[0]) - (b[2] - a[2]) * (c[0] - a[0])) / triangle;
+    float slope = (SDL_fabsf(dx) + SDL_fabsf(dy)) * 0.5f;
+    float sign = area > 0.0f ? 1.0f : -1.0f;
+    float min_x = SDL_FLT_MAX;
+    float min_y = SDL_FLT_MAX;
+    float max_x = -SDL_FLT_MAX;
+    float max_y = -SDL_FLT_MAX;
+    float max_depth = 0.0f;
+    float margins[5];
+    for (int i = 0; i < count; i++)
+    {
+        const float* p = polygon[i];
+        const float* q = polygon[(i + 1) % count];
+        min_x = SDL_min(min_x, p[0]);
+        min_y = SDL_min(min_y, p[1]);
+        max_x = SDL_max(max_x, p[0]);
+        max_y = SDL_max(max_y, p[1]);
+        max_depth = SDL_max(max_depth, p[2]);
+        margins[i] = (SDL_fabsf(q[0] - p[0]) + SDL_fabsf(q[1] - p[1])) * 0.5f;
+    }
+    int x1 = SDL_max(0, (int) SDL_floorf(min_x));
+    int y1 = SDL_max(0, (int) SDL_floorf(min_y));
+    int x2 = SDL_min(OCCLUSION_WIDTH - 1, (int) SDL_floorf(max_x));
+    int y2 = SDL_min(OCCLUSION_HEIGHT - 1, (int) SDL_floorf(max_y));
+    for (int y = y1; y <= y2; y++)
+    for (int x = x1; x <= x2; x++)
+    {
+        float px = x + 0.5f;
+        float py = y + 0.5f;
+        bool is_covered = true;
+        for (int i = 0; i < count && is_covered; i++)
+        {
+            is_covered = sign * Edge(polygon[i], polygon[(i + 1) % count], px, py) >= margins[i];
+        }
+        if (!is_covered)
+        {
+            continue;
+        }
+        float depth = a[2] + dx * (px - a[0]) + dy * (py - a[1]) + slope;
+        depth = SDL_min(depth, max_depth);
+        occlusion->depths[y][x] = SDL_min(occlusion->depths[y][x], depth);
+    }
+}
+
+static void AddFace(Occlusion* occlusion, const float corners[4][3])
+{
+    float polygon[4][4];
+    float clipped[5][4];
+    float screen[5][3];
+    for (int i = 0; i < 4; i++)
+    {
+        Transform(occlusion->matrix, corners[i], polygon[i]);
+    }
+    int count = Clip(polygon, clipped);
+    for (int i = 0; i < count; i++)
+    {
+        Project(clipped[i], screen[i]);
+    }
+    if (count >= 3)
+    {
+        Rasterize(occlusion, screen, count);
+    }
+}
+
+void Occlusion_Clear(Occlusion* occlusion, const Camera* camera)
+{
+    SDL_memcpy(occlusion->matrix, camera->matrix, sizeof(occlusion->matrix));
+    SDL_memcpy(occlusion->position, camera->position, sizeof(occlusion->position));
+    occlusion->pitch = camera->pitch;
+    occlusion->yaw = camera->yaw;
+    for (int y = 0; y < OCCLUSION_HEIGHT; y++)
+    for (int x = 0; x < OCCLUSION_WIDTH; x++)
+    {
+        occlusion->depths[y][x] = 1.0f;
+    }
+}
+
+void Occlusion_AddBox(Occlusion* occlusion, const float min[3], const float max[3])
+{
+    // only the faces turned towards the camera can be nearest
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float plane;
+        if (occlusion->position[axis] < min[axis])
+        {
+            plane = min[axis];
+        }
+        else if (occlusion->position[axis] > max[axis])
+        {
+            plane = max[axis];
+        }
+        else
+        {
+            continue;
+        }
+        int u = (axis + 1) % 3;
+        int v = (axis + 2) % 3;
+        float corners[4][3];
+        for (int i = 0; i < 4; i++)
+        {
+            corners[i][axis] = plane;
+            corners[i][u] = (i == 1 || i == 2) ? max[u] : min[u];
+            corners[i][v] = (i >= 2) ? max[v] : min[v];
+        }
+        AddFace(occlusion, corners);
+    }
+}
+
+bool Occlusion_IsVisible(const Occlusion* occlusion, const float min[3], const float max[3])
+{
+    float min_x = SDL_FLT_MAX;
+    float min_y = SDL_FLT_MAX;
+    float max_x = -SDL_FLT_MAX;
+    float max_y = -SDL_FLT_MAX;
+    float nearest = 1.0f;
+    for (int i = 0; i < 8; i++)
+    {
+        float corner[3];
+        corner[0] = i & 1 ? max[0] : min[0];
+        corner[1] = i & 2 ? max[1] : min[1];
+        corner[2] = i & 4 ? max[2] : min[2];
+        float clip[4];
+        float screen[3];
+        Transform(occlusion->matrix, corner, clip);
+        if (clip[2] < 0.0f || clip[3] <= 0.0f)
+        {
+            return true;
+        }
+        Project(clip, screen);
+        min_x = SDL_min(min_x, screen[0]);
+        min_y = SDL_min(min_y, screen[1]);
+        max_x = SDL_max(max_x, screen[0]);
+        max_y = SDL_max(max_y, screen[1]);
+        nearest = SDL_min(nearest, screen[2]);
+    }
+    int x1 = SDL_max(0, (int) SDL_floorf(min_x));
+    int y1 = SDL_max(0, (int) SDL_floorf(min_y));
+    int x2 = SDL_min(OCCLUSION_WIDTH - 1, (int) SDL_floorf(max_x));
+    int y2 = SDL_min(OCCLUSION_HEIGHT - 1, (int) SDL_floorf(max_y));
+    if (x1 > x2 || y1 > y2)
+    {
+        return true;
+    }
+    for (int y = y1; y <= y2; y++)
+    for (int x = x1; x <= x2; x++)
+    {
+        if (occlusion->depths[y][x] >= nearest)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Occlusion_IsValid(const Occlusion* occlusion, const Camera* camera)
+{
+    float dx = camera->x - occlusion->position[0];
+    float dy = camera->y - occlusion->position[1];
+    float dz = camera->z - occlusion->position[2];
+    if (dx * dx + dy * dy + dz * dz > MAX_MOVE * MAX_MOVE)
+    {
+        return false;
+    }
+    return SDL_fabsf(camera->pitch - occlusion->pitch) < MAX_ROTATE &&
+        SDL_fabsf(camera->yaw - occlusion->yaw) < MAX_ROTATE;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+#define OCCLUSION_WIDTH 256
+#define OCCLUSION_HEIGHT 128
+
+typedef struct Camera Camera;
+
+typedef struct Occlusion
+{
+    float matrix[4][4];
+    float position[3];
+    float pitch;
+    float yaw;
+    float depths[OCCLUSION_HEIGHT][OCCLUSION_WIDTH];
+} Occlusion;
+
+void Occlusion_Clear(Occlusion* occlusion, const Camera* camera);
+void Occlusion_AddBox(Occlusion* occlusion, const float min[3], const float max[3]);
+bool Occlusion_IsVisible(const Occlusion* occlusion, const float min[3], const float max[3]);
+bool Occlusion_IsValid(const Occlusion* occlusion, const Camera* camera);
@@ -22,6 +22,7 @@ static const float WALK_SPEED = 4.0f;
 static const float SPRINT_MULTIPLER = 2.5f;
 static const float SENSITIVITY = 0.1f;
 static const float REACH = 10.0f;
+static const int BREAK_AREA_RADIUS = 1;
 static const float AIR_ACCELERATION = 6.0f;
 static const float GRAVITY = 24.0f;
 static const float JUMP_SPEED = 8.5f;
@@ -236,6 +237,17 @@ void Player_Update(Player* player, float dt)
     {
         World_SetBlock(player->query.current, BLOCK_EMPTY);
     }
+    if (Input_GetBreakArea() && player->query.block != BLOCK_EMPTY)
+    {
+        int min[3];
+        int max[3];
+        for (int i = 0; i < 3; i++)
+        {
+            min[i] = player->query.current[i] - BREAK_AREA_RADIUS;
+            max[i] = player->query.current[i] + BREAK_AREA_RADIUS;
+        }
+        World_FillBlocks(min, max, BLOCK_EMPTY);
+    }
     if (Input_GetPlaceBlock())
     {
         SetBlock(player);
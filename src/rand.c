@@ -4,6 +4,48 @@
 #include "rand.h"
 #include "world.h"
 
+static float GetHeight(int bx, int bz)
+{
+    float height = stb_perlin_fbm_noise3(bx * 0.005f, 0.0f, bz * 0.005f, 2.0f, 0.5f, 6) * 50.0f;
+    height = SDL_powf(SDL_max(height, 0.0f), 1.3f) + 30.0f;
+    return SDL_clamp(height, 0.0f, CHUNK_HEIGHT - 1.0f);
+}
+
+static void GetColumn(int bx, int bz, float* height, bool* is_low_elevation, Block* top, Block* bottom)
+{
+    *height = GetHeight(bx, bz);
+    *is_low_elevation = false;
+    if (*height < 40.0f)
+    {
+        *height += stb_perlin_fbm_noise3(-bx * 0.01f, 0.0f, bz * 0.01f, 2.0f, 0.5f, 6) * 12.0f;
+        *is_low_elevation = true;
+    }
+    float biome = stb_perlin_fbm_noise3(bx * 0.2f, 0.0f, bz * 0.2f, 2.0f, 0.5f, 6);
+    if (*height + biome < 31.0f)
+    {
+        *top = BLOCK_SAND;
+        *bottom = BLOCK_SAND;
+        return;
+    }
+    biome *= 8.0f;
+    biome = SDL_clamp(biome, -5.0f, 5.0f);
+    if (*height + biome < 61.0f)
+    {
+        *top = BLOCK_GRASS;
+        *bottom = BLOCK_DIRT;
+    }
+    else if (*height + biome < 132.0f)
+    {
+        *top = BLOCK_STONE;
+        *bottom = BLOCK_STONE;
+    }
+    else
+    {
+        *top = BLOCK_SNOW;
+        *bottom = BLOCK_STONE;
+    }
+}
+
 void Rand_GetBlocks(void* userdata, int cx, int cz, RandSetBlock callback)
 {
     for (int x = 0; x < CHUNK_WIDTH; x++)
@@ -11,50 +53,18 @@ void Rand_GetBlocks(void* userdata, int cx, int cz, RandSetBlock callback)
     {
         int bx = cx + x;
         int bz = cz + z;
-        float height = stb_perlin_fbm_noise3(bx * 0.005f, 0.0f, bz * 0.005f, 2.0f, 0.5f, 6) * 50.0f;
-        height = SDL_powf(SDL_max(height, 0.0f), 1.3f) + 30.0f;
-        height = SDL_clamp(height, 0.0f, CHUNK_HEIGHT - 1.0f);
-        bool is_low_elevation = false;
-        if (height < 40.0f)
-        {
-            height += stb_perlin_fbm_noise3(-bx * 0.01f, 0.0f, bz * 0.01f, 2.0f, 0.5f, 6) * 12.0f;
-            is_low_elevation = true;
-        }
-        float biome = stb_perlin_fbm_noise3(bx * 0.2f, 0.0f, bz * 0.2f, 2.0f, 0.5f, 6);
+        float height;
+        bool is_low_elevation;
         Block top;
         Block bottom;
-        if (height + biome < 31.0f)
-        {
-            top = BLOCK_SAND;
-            bottom = BLOCK_SAND;
-        }
-        else
-        {
-            biome *= 8.0f;
-            biome = SDL_clamp(biome, -5.0f, 5.0f);
-            if (height + biome < 61.0f)
-            {
-                top = BLOCK_GRASS;
-                bottom = BLOCK_DIRT;
-            }
-            else if (height + biome < 132.0f)
-            {
-                top = BLOCK_STONE;
-                bottom = BLOCK_STONE;
-            }
-            else
-            {
-                top = BLOCK_SNOW;
-                bottom = BLOCK_STONE;
-            }
-        }
+        GetColumn(bx, bz, &height, &is_low_elevation, &top, &bottom);
         int y = 0;
         for (; y < height; y++)
         {
             callback(userdata, bx, y, bz, bottom);
         }
         callback(userdata, bx, y, bz, top);
-        for (; y < 30; y++)
+        for (; y < RAND_WATER_HEIGHT; y++)
         {
             callback(userdata, bx, y, bz, BLOCK_WATER);
         }
@@ -89,27 +99,43 @@ void Rand_GetBlocks(void* userdata, int cx, int cz, RandSetBlock callback)
                 callback(userdata, bx, y + 1, bz, flowers[i]);
             }
         }
-        if (height > 130.0f)
-        {
-            continue;
-        }
-        float cloud = stb_perlin_turbulence_noise3(bx * 0.015f, 0.0f, bz * 0.015f, 2.0f, 0.5f, 6);
-        int scale = -1;
-        if (cloud > 0.9f)
-        {
-            scale = 2;
-        }
-        else if (cloud > 0.7f)
-        {
-            scale = 1;
-        }
-        else if (cloud > 0.6f)
-        {
-            scale = 0;
-        }
-        for (int y = -scale; y <= scale; y++)
-        {
-            callback(userdata, bx, 155 - y, bz, BLOCK_CLOUD);
-        }
     }
 }
+
+int Rand_GetSurface(int bx, int bz, Block* block)
+{
+    float height;
+    bool is_low_elevation;
+    Block bottom;
+    GetColumn(bx, bz, &height, &is_low_elevation, block, &bottom);
+    int y = SDL_ceilf(height);
+    if (y < RAND_WATER_HEIGHT)
+    {
+        *block = BLOCK_WATER;
+        return RAND_WATER_HEIGHT;
+    }
+    return y + 1;
+}
+
+int Rand_GetCloud(int bx, int bz)
+{
+    // keeps clouds out of mountain peaks
+    if (GetHeight(bx, bz) > 130.0f)
+    {
+        return -1;
+    }
+    float cloud = stb_perlin_turbulence_noise3(bx * 0.015f, 0.0f, bz * 0.015f, 2.0f, 0.5f, 6);
+    if (cloud > 0.9f)
+    {
+        return 2;
+    }
+    else if (cloud > 0.7f)
+    {
+        return 1;
+    }
+    else if (cloud > 0.6f)
+    {
+        return 0;
+    }
+    return -1;
+}
@@ -4,6 +4,10 @@
 
 #include "block.h"
 
+#define RAND_WATER_HEIGHT 30
+
 typedef void (*RandSetBlock)(void* userdata, int bx, int by, int bz, Block block);
 
 void Rand_GetBlocks(void* userdata, int cx, int cz, RandSetBlock callback);
+int Rand_GetSurface(int bx, int bz, Block* block);
+int Rand_GetCloud(int bx, int bz);
@@ -0,0 +1,969 @@
+#include <SDL3/SDL.h>
+#include <stddef.h>
+
+#ifdef SDL_PLATFORM_WINDOWS
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "block.h"
+#include "region.h"
+#include "world.h"
+
+#define REGIONS 16
+
+static const Uint32 MAGIC = 0x524B4C42;
+static const Uint32 LEVEL_MAGIC = 0x4C4B4C42;
+static const Uint32 VERSION = 1;
+static const Uint32 ALIGNMENT = 256;
+static const char* LEVEL_NAME = "level.dat";
+
+typedef struct RegionSlot
+{
+    Uint32 offset;
+    Uint32 size;
+    Uint32 capacity;
+    Uint32 count;
+} RegionSlot;
+
+typedef struct RegionHeader
+{
+    Uint32 magic;
+    Uint32 version;
+    Uint32 end;
+    Uint32 padding;
+    RegionSlot slots[REGION_WIDTH][REGION_WIDTH];
+} RegionHeader;
+
+typedef struct RegionExtent
+{
+    Uint32 offset;
+    Uint32 capacity;
+} RegionExtent;
+
+typedef struct Region
+{
+#ifdef SDL_PLATFORM_WINDOWS
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int file;
+#endif
+    const Uint8* data;
+    Uint32 size;
+    RegionExtent* extents;
+    int extent_count;
+    int extent_capacity;
+    int x;
+    int z;
+    Uint64 ticks;
+    bool is_open;
+} Region;
+
+typedef struct RegionChunk
+{
+    int cx;
+    int cz;
+    Uint32* edits;
+    Uint32 count;
+    Uint32 capacity;
+} RegionChunk;
+
+typedef struct RegionLevel
+{
+    Uint32 magic;
+    Uint32 has_sky;
+    float time_of_day;
+    Sint32 player_size;
+} RegionLevel;
+
+typedef struct RegionEnumerator
+{
+    void* userdata;
+    RegionAddChunk callback;
+} RegionEnumerator;
+
+static char directory[1024];
+static Region regions[REGIONS];
+static RegionChunk* chunks;
+static int chunk_count;
+static int chunk_capacity;
+static RegionLevel level;
+static Uint8* player;
+static bool is_level_dirty;
+
+static int FloorDivide(int a, int b)
+{
+    int quotient = a / b;
+    if ((a % b) && ((a < 0) != (b < 0)))
+    {
+        quotient--;
+    }
+    return quotient;
+}
+
+static void GetRegion(int cx, int cz, int* rx, int* rz, int* sx, int* sz)
+{
+    SDL_assert(!(cx % CHUNK_WIDTH));
+    SDL_assert(!(cz % CHUNK_WIDTH));
+    int x = cx / CHUNK_WIDTH;
+    int z = cz / CHUNK_WIDTH;
+    *rx = FloorDivide(x, REGION_WIDTH);
+    *rz = FloorDivide(z, REGION_WIDTH);
+    *sx = x - *rx * REGION_WIDTH;
+    *sz = z - *rz * REGION_WIDTH;
+}
+
+static Uint32 GetIndex(int bx, int by, int bz)
+{
+    SDL_assert(bx >= 0 && bx < CHUNK_WIDTH);
+    SDL_assert(by >= 0 && by < CHUNK_HEIGHT);
+    SDL_assert(bz >= 0 && bz < CHUNK_WIDTH);
+    return (bx * CHUNK_HEIGHT + by) * CHUNK_WIDTH + bz;
+}
+
+static void GetPosition(Uint32 index, int* bx, int* by, int* bz)
+{
+    *bz = index % CHUNK_WIDTH;
+    index /= CHUNK_WIDTH;
+    *by = index % CHUNK_HEIGHT;
+    *bx = index / CHUNK_HEIGHT;
+}
+
+static void UnmapFile(Region* region)
+{
+    if (!region->data)
+    {
+        return;
+    }
+#ifdef SDL_PLATFORM_WINDOWS
+    UnmapViewOfFile(region->data);
+    CloseHandle(region->mapping);
+    region->mapping = NULL;
+#else
+    munmap((void*) region->data, region->size);
+#endif
+    region->data = NULL;
+    region->size = 0;
+}
+
+static bool MapFile(Region* region)
+{
+    UnmapFile(region);
+#ifdef SDL_PLATFORM_WINDOWS
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(region->file, &size))
+    {
+        SDL_Log("Failed to get region size: %lu", GetLastError());
+        return false;
+    }
+    if (!size.QuadPart)
+    {
+        return true;
+    }
+    region->mapping = CreateFileMappingA(region->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!region->mapping)
+    {
+        SDL_Log("Failed to create region mapping: %lu", GetLastError());
+        return false;
+    }
+    region->data = MapViewOfFile(region->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!region->data)
+    {
+        SDL_Log("Failed to map region: %lu", GetLastError());
+        CloseHandle(region->mapping);
+        region->mapping = NULL;
+        return false;
+    }
+    region->size = size.QuadPart;
+#else
+    struct stat info;
+    if (fstat(region->file, &info))
+    {
+        SDL_Log("Failed to get region size");
+        return false;
+    }
+    if (!info.st_size)
+    {
+        return true;
+    }
+    void* data = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, region->file, 0);
+    if (data == MAP_FAILED)
+    {
+        SDL_Log("Failed to map region");
+        return false;
+    }
+    region->data = data;
+    region->size = info.st_size;
+#endif
+    return true;
+}
+
+static bool OpenFile(Region* region, const char* path, bool create)
+{
+#ifdef SDL_PLATFORM_WINDOWS
+    DWORD disposition = create ? OPEN_ALWAYS : OPEN_EXISTING;
+    region->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, disposition, FILE_ATTRIBUTE_NORMAL, NULL);
+    return region->file != INVALID_HANDLE_VALUE;
+#else
+    region->file = open(path, create ? O_RDWR | O_CREAT : O_RDWR, 0644);
+    return region->file >= 0;
+#endif
+}
+
+static void CloseFile(Region* region)
+{
+    UnmapFile(region);
+    SDL_free(region->extents);
+    region->extents = NULL;
+    region->extent_count = 0;
+    region->extent_capacity = 0;
+#ifdef SDL_PLATFORM_WINDOWS
+    CloseHandle(region->file);
+    region->file = INVALID_HANDLE_VALUE;
+#else
+    close(region->file);
+    region->file = -1;
+#endif
+    region->is_open = false;
+}
+
+static bool WriteRegion(Region* region, Uint32 offset, const void* data, Uint32 size)
+{
+#ifdef SDL_PLATFORM_WINDOWS
+    OVERLAPPED overlapped = {0};
+    overlapped.Offset = offset;
+    DWORD written;
+    if (!WriteFile(region->file, data, size, &written, &overlapped) || written != size)
+    {
+        SDL_Log("Failed to write region: %lu", GetLastError());
+        return false;
+    }
+#else
+    const Uint8* bytes = data;
+    while (size)
+    {
+        ssize_t written = pwrite(region->file, bytes, size, offset);
+        if (written <= 0)
+        {
+            SDL_Log("Failed to write region");
+            return false;
+        }
+        bytes += written;
+        offset += written;
+        size -= written;
+    }
+#endif
+    return true;
+}
+
+static bool SyncFile(Region* region)
+{
+#ifdef SDL_PLATFORM_WINDOWS
+    if (!FlushFileBuffers(region->file))
+    {
+        SDL_Log("Failed to flush region: %lu", GetLastError());
+        return false;
+    }
+#else
+    if (fsync(region->file))
+    {
+        SDL_Log("Failed to flush region");
+        return false;
+    }
+#endif
+    return true;
+}
+
+static const RegionHeader* GetHeader(const Region* region)
+{
+    SDL_assert(region->size >= sizeof(RegionHeader));
+    return (const RegionHeader*) region->data;
+}
+
+static void FreeExtent(Region* region, Uint32 offset, Uint32 capacity)
+{
+    // sorted by offset so neighbors merge back into larger extents
+    int index = 0;
+    while (index < region->extent_count && region->extents[index].offset < offset)
+    {
+        index++;
+    }
+    RegionExtent* previous = index > 0 ? &region->extents[index - 1] : NULL;
+    RegionExtent* next = index < region->extent_count ? &region->extents[index] : NULL;
+    if (previous && previous->offset + previous->capacity == offset)
+    {
+        previous->capacity += capacity;
+        if (next && offset + capacity == next->offset)
+        {
+            previous->capacity += next->capacity;
+            SDL_memmove(next, next + 1, (region->extent_count - index - 1) * sizeof(RegionExtent));
+            region->extent_count--;
+        }
+        return;
+    }
+    if (next && offset + capacity == next->offset)
+    {
+        next->offset = offset;
+        next->capacity += capacity;
+        return;
+    }
+    if (region->extent_count == region->extent_capacity)
+    {
+        int new_capacity = SDL_max(16, region->extent_capacity * 2);
+        RegionExtent* extents = SDL_realloc(region->extents, new_capacity * sizeof(RegionExtent));
+        if (!extents)
+        {
+            // only leaked until the region is reopened
+            SDL_Log("Failed to allocate extents");
+            return;
+        }
+        region->extents = extents;
+        region->extent_capacity = new_capacity;
+    }
+    RegionExtent* extent = &region->extents[index];
+    SDL_memmove(extent + 1, extent, (region->extent_count - index) * sizeof(RegionExtent));
+    extent->offset = offset;
+    extent->capacity = capacity;
+    region->extent_count++;
+}
+
+static Uint32 AllocateExtent(Region* region, Uint32 capacity, Uint32* end)
+{
+    for (int i = 0; i < region->extent_count; i++)
+    {
+        RegionExtent* extent = &region->extents[i];
+        if (extent->capacity < capacity)
+        {
+            continue;
+        }
+        Uint32 offset = extent->offset;
+        extent->offset += capacity;
+        extent->capacity -= capacity;
+        if (!extent->capacity)
+        {
+            SDL_memmove(extent, extent + 1, (region->extent_count - i - 1) * sizeof(RegionExtent));
+            region->extent_count--;
+        }
+        return offset;
+    }
+    Uint32 offset = *end;
+    *end += capacity;
+    return offset;
+}
+
+static int CompareExtents(const void* lhs, const void* rhs)
+{
+    const RegionExtent* l = lhs;
+    const RegionExtent* r = rhs;
+    return (l->offset > r->offset) - (l->offset < r->offset);
+}
+
+static void FindExtents(Region* region)
+{
+    // anything between the slots is free, including payloads a crash left unreferenced
+    RegionExtent used[REGION_WIDTH * REGION_WIDTH];
+    const RegionHeader* header = GetHeader(region);
+    int count = 0;
+    for (int sx = 0; sx < REGION_WIDTH; sx++)
+    for (int sz = 0; sz < REGION_WIDTH; sz++)
+    {
+        const RegionSlot* slot = &header->slots[sx][sz];
+        if (slot->capacity)
+        {
+            used[count].offset = slot->offset;
+            used[count].capacity = slot->capacity;
+            count++;
+        }
+    }
+    SDL_qsort(used, count, sizeof(RegionExtent), CompareExtents);
+    Uint32 offset = sizeof(RegionHeader);
+    for (int i = 0; i <= count; i++)
+    {
+        Uint32 next = i < count ? used[i].offset : header->end;
+        if (next > offset)
+        {
+            FreeExtent(region, offset, next - offset);
+        }
+        if (i < count)
+        {
+            offset = SDL_max(offset, used[i].offset + used[i].capacity);
+        }
+    }
+}
+
+static Region* OpenRegion(int rx, int rz, bool create)
+{
+    Region* region = NULL;
+    for (int i = 0; i < REGIONS; i++)
+    {
+        if (regions[i].is_open && regions[i].x == rx && regions[i].z == rz)
+        {
+            regions[i].ticks = SDL_GetTicks();
+            return &regions[i];
+        }
+        if (!region || (region->is_open && (!regions[i].is_open || regions[i].ticks < region->ticks)))
+        {
+            region = &regions[i];
+        }
+    }
+    if (region->is_open)
+    {
+        CloseFile(region);
+    }
+    char path[1024] = {0};
+    SDL_snprintf(path, sizeof(path), "%sr.%d.%d.region", directory, rx, rz);
+    if (!OpenFile(region, path, create))
+    {
+        if (create)
+        {
+            SDL_Log("Failed to open region: %s", path);
+        }
+        return NULL;
+    }
+    region->is_open = true;
+    region->x = rx;
+    region->z = rz;
+    region->ticks = SDL_GetTicks();
+    if (!MapFile(region))
+    {
+        CloseFile(region);
+        return NULL;
+    }
+    if (region->size < sizeof(RegionHeader))
+    {
+        if (!create)
+        {
+            CloseFile(region);
+            return NULL;
+        }
+        RegionHeader* header = SDL_calloc(1, sizeof(RegionHeader));
+        if (!header)
+        {
+            SDL_Log("Failed to allocate region header");
+            CloseFile(region);
+            return NULL;
+        }
+        header->magic = MAGIC;
+        header->version = VERSION;
+        header->end = sizeof(RegionHeader);
+        bool written = WriteRegion(region, 0, header, sizeof(RegionHeader));
+        SDL_free(header);
+        if (!written || !MapFile(region))
+        {
+            CloseFile(region);
+            return NULL;
+        }
+    }
+    const RegionHeader* header = GetHeader(region);
+    if (header->magic != MAGIC || header->version != VERSION)
+    {
+        SDL_Log("Failed to open region: %s: Out of date", path);
+        CloseFile(region);
+        return NULL;
+    }
+    FindExtents(region);
+    return region;
+}
+
+static const Uint8* GetPayload(const Region* region, int sx, int sz, const RegionSlot** out_slot)
+{
+    const RegionSlot* slot = &GetHeader(region)->slots[sx][sz];
+    if (!slot->size)
+    {
+        return NULL;
+    }
+    if ((Uint64) slot->offset + slot->size > region->size)
+    {
+        SDL_Log("Bad region payload: %d, %d", region->x, region->z);
+        return NULL;
+    }
+    *out_slot = slot;
+    return region->data + slot->offset;
+}
+
+static Uint32 DecodeEdit(const Uint8** data, const Uint8* end, Uint32 index)
+{
+    Uint32 delta = 0;
+    int shift = 0;
+    Uint8 byte;
+    do
+    {
+        byte = *(*data)++;
+        delta |= (Uint32) (byte & 0x7F) << shift;
+        shift += 7;
+    }
+    while ((byte & 0x80) && *data < end && shift < 32);
+    Block block = *data < end ? *(*data)++ : BLOCK_EMPTY;
+    return ((index + delta) << 8) | block;
+}
+
+static Uint32 EncodeEdit(Uint8* data, Uint32 index, Uint32 edit)
+{
+    Uint32 delta = (edit >> 8) - index;
+    Uint32 size = 0;
+    while (delta >= 0x80)
+    {
+        data[size++] = (delta & 0x7F) | 0x80;
+        delta >>= 7;
+    }
+    data[size++] = delta;
+    data[size++] = edit & 0xFF;
+    return size;
+}
+
+static RegionChunk* GetPendingChunk(int cx, int cz)
+{
+    for (int i = 0; i < chunk_count; i++)
+    {
+        if (chunks[i].cx == cx && chunks[i].cz == cz)
+        {
+            return &chunks[i];
+        }
+    }
+    return NULL;
+}
+
+static bool AppendEdit(RegionChunk* chunk, Uint32 edit)
+{
+    if (chunk->count == chunk->capacity)
+    {
+        Uint32 capacity = SDL_max(64, chunk->capacity * 2);
+        Uint32* edits = SDL_realloc(chunk->edits, capacity * sizeof(Uint32));
+        if (!edits)
+        {
+            SDL_Log("Failed to allocate edits");
+            return false;
+        }
+        chunk->edits = edits;
+        chunk->capacity = capacity;
+    }
+    chunk->edits[chunk->count++] = edit;
+    return true;
+}
+
+static RegionChunk* AddPendingChunk(int cx, int cz)
+{
+    if (chunk_count == chunk_capacity)
+    {
+        int capacity = SDL_max(8, chunk_capacity * 2);
+        RegionChunk* new_chunks = SDL_realloc(chunks, capacity * sizeof(RegionChunk));
+        if (!new_chunks)
+        {
+            SDL_Log("Failed to allocate chunks");
+            return NULL;
+        }
+        chunks = new_chunks;
+        chunk_capacity = capacity;
+    }
+    RegionChunk* chunk = &chunks[chunk_count++];
+    chunk->cx = cx;
+    chunk->cz = cz;
+    chunk->edits = NULL;
+    chunk->count = 0;
+    chunk->capacity = 0;
+    int rx;
+    int rz;
+    int sx;
+    int sz;
+    GetRegion(cx, cz, &rx, &rz, &sx, &sz);
+    Region* region = OpenRegion(rx, rz, false);
+    const RegionSlot* slot;
+    const Uint8* data = region ? GetPayload(region, sx, sz, &slot) : NULL;
+    if (!data)
+    {
+        return chunk;
+    }
+    const Uint8* end = data + slot->size;
+    Uint32 index = 0;
+    for (Uint32 i = 0; i < slot->count && data < end; i++)
+    {
+        Uint32 edit = DecodeEdit(&data, end, index);
+        index = edit >> 8;
+        AppendEdit(chunk, edit);
+    }
+    return chunk;
+}
+
+static void SetEdit(RegionChunk* chunk, Uint32 index, Block block)
+{
+    Uint32 lower = 0;
+    Uint32 upper = chunk->count;
+    while (lower < upper)
+    {
+        Uint32 middle = (lower + upper) / 2;
+        if ((chunk->edits[middle] >> 8) < index)
+        {
+            lower = middle + 1;
+        }
+        else
+        {
+            upper = middle;
+        }
+    }
+    Uint32 edit = (index << 8) | block;
+    if (lower < chunk->count && (chunk->edits[lower] >> 8) == index)
+    {
+        chunk->edits[lower] = edit;
+        return;
+    }
+    if (!AppendEdit(chunk, edit))
+    {
+        return;
+    }
+    Uint32* position = &chunk->edits[lower];
+    SDL_memmove(position + 1, position, (chunk->count - 1 - lower) * sizeof(Uint32));
+    *position = edit;
+}
+
+static bool CommitChunk(RegionChunk* chunk)
+{
+    int rx;
+    int rz;
+    int sx;
+    int sz;
+    GetRegion(chunk->cx, chunk->cz, &rx, &rz, &sx, &sz);
+    Region* region = OpenRegion(rx, rz, true);
+    if (!region)
+    {
+        return false;
+    }
+    Uint8* data = SDL_malloc(SDL_max(1, chunk->count * 8));
+    if (!data)
+    {
+        SDL_Log("Failed to allocate payload");
+        return false;
+    }
+    Uint32 size = 0;
+    Uint32 index = 0;
+    for (Uint32 i = 0; i < chunk->count; i++)
+    {
+        size += EncodeEdit(data + size, index, chunk->edits[i]);
+        index = chunk->edits[i] >> 8;
+    }
+    const RegionHeader* header = GetHeader(region);
+    RegionSlot old_slot = header->slots[sx][sz];
+    RegionSlot slot = {0};
+    Uint32 end = header->end;
+    if (size)
+    {
+        slot.capacity = (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        slot.offset = AllocateExtent(region, slot.capacity, &end);
+    }
+    slot.size = size;
+    slot.count = chunk->count;
+    // the payload never overwrites the one the slot points at and is flushed before the slot
+    // flips to it, so a crash leaves either the old or the new payload
+    Uint32 slot_offset = offsetof(RegionHeader, slots) + (sx * REGION_WIDTH + sz) * sizeof(RegionSlot);
+    bool written = WriteRegion(region, slot.offset, data, size) && SyncFile(region) &&
+        WriteRegion(region, offsetof(RegionHeader, end), &end, sizeof(end)) &&
+        WriteRegion(region, slot_offset, &slot, sizeof(slot)) && SyncFile(region);
+    SDL_free(data);
+    if (!written)
+    {
+        // whichever extent ends up unused is found again when the region is reopened
+        return false;
+    }
+    if (old_slot.capacity)
+    {
+        FreeExtent(region, old_slot.offset, old_slot.capacity);
+    }
+    if (!MapFile(region))
+    {
+        // the edits are on disk, so the region is only reopened on next use
+        CloseFile(region);
+    }
+    return true;
+}
+
+static bool CommitLevel()
+{
+    Uint32 size = sizeof(RegionLevel) + SDL_max(level.player_size, 0);
+    Uint8* data = SDL_malloc(size);
+    if (!data)
+    {
+        SDL_Log("Failed to allocate level");
+        return false;
+    }
+    level.magic = LEVEL_MAGIC;
+    SDL_memcpy(data, &level, sizeof(RegionLevel));
+    if (player)
+    {
+        SDL_memcpy(data + sizeof(RegionLevel), player, level.player_size);
+    }
+    // written beside the old level and renamed over it so a crash never leaves it partial
+    char path[1024] = {0};
+    char temp_path[1024] = {0};
+    SDL_snprintf(path, sizeof(path), "%s%s", directory, LEVEL_NAME);
+    SDL_snprintf(temp_path, sizeof(temp_path), "%s%s.tmp", directory, LEVEL_NAME);
+    SDL_RemovePath(temp_path);
+    Region file = {0};
+    bool saved = OpenFile(&file, temp_path, true);
+    if (saved)
+    {
+        saved = WriteRegion(&file, 0, data, size) && SyncFile(&file);
+        CloseFile(&file);
+        saved = saved && SDL_RenamePath(temp_path, path);
+    }
+    if (!saved)
+    {
+        SDL_Log("Failed to save level: %s", SDL_GetError());
+    }
+    SDL_free(data);
+    return saved;
+}
+
+static void LoadLevel()
+{
+    SDL_zero(level);
+    char path[1024] = {0};
+    SDL_snprintf(path, sizeof(path), "%s%s", directory, LEVEL_NAME);
+    size_t size;
+    Uint8* data = SDL_LoadFile(path, &size);
+    if (!data)
+    {
+        return;
+    }
+    if (size < sizeof(RegionLevel))
+    {
+        SDL_free(data);
+        return;
+    }
+    SDL_memcpy(&level, data, sizeof(RegionLevel));
+    if (level.magic != LEVEL_MAGIC || level.player_size < 0 ||
+        size != sizeof(RegionLevel) + level.player_size)
+    {
+        SDL_Log("Failed to load level: Out of date");
+        SDL_zero(level);
+        SDL_free(data);
+        return;
+    }
+    if (level.player_size)
+    {
+        player = SDL_malloc(level.player_size);
+        if (player)
+        {
+            SDL_memcpy(player, data + sizeof(RegionLevel), level.player_size);
+        }
+        else
+        {
+            level.player_size = 0;
+        }
+    }
+    SDL_free(data);
+}
+
+bool Region_Init(const char* path)
+{
+    SDL_snprintf(directory, sizeof(directory), "%s", path);
+    if (!SDL_CreateDirectory(directory))
+    {
+        SDL_Log("Failed to create %s directory: %s", directory, SDL_GetError());
+        return false;
+    }
+    for (int i = 0; i < REGIONS; i++)
+    {
+        regions[i].is_open = false;
+        regions[i].data = NULL;
+        regions[i].size = 0;
+        regions[i].extents = NULL;
+        regions[i].extent_count = 0;
+        regions[i].extent_capacity = 0;
+    }
+    LoadLevel();
+    return true;
+}
+
+void Region_Free()
+{
+    if (chunk_count)
+    {
+        SDL_Log("Failed to save %d chunks", chunk_count);
+    }
+    for (int i = 0; i < REGIONS; i++)
+    {
+        if (regions[i].is_open)
+        {
+            CloseFile(&regions[i]);
+        }
+    }
+    for (int i = 0; i < chunk_count; i++)
+    {
+        SDL_free(chunks[i].edits);
+    }
+    SDL_free(chunks);
+    SDL_free(player);
+    chunks = NULL;
+    chunk_count = 0;
+    chunk_capacity = 0;
+    player = NULL;
+    is_level_dirty = false;
+    SDL_zero(level);
+}
+
+void Region_Commit()
+{
+    // chunks that fail stay pending so their edits are retried on the next commit
+    int count = 0;
+    for (int i = 0; i < chunk_count; i++)
+    {
+        if (CommitChunk(&chunks[i]))
+        {
+            SDL_free(chunks[i].edits);
+        }
+        else
+        {
+            chunks[count++] = chunks[i];
+        }
+    }
+    chunk_count = count;
+    if (is_level_dirty)
+    {
+        is_level_dirty = !CommitLevel();
+    }
+}
+
+void Region_SetPlayer(const void* data, int size)
+{
+    if (size != level.player_size)
+    {
+        Uint8* new_player = SDL_realloc(player, size);
+        if (!new_player)
+        {
+            SDL_Log("Failed to allocate player");
+            return;
+        }
+        player = new_player;
+        level.player_size = size;
+    }
+    SDL_memcpy(player, data, size);
+    is_level_dirty = true;
+}
+
+bool Region_GetPlayer(void* data, int size)
+{
+    if (!player)
+    {
+        return false;
+    }
+    if (size != level.player_size)
+    {
+        SDL_Log("Failed to get player: Out of date");
+        return false;
+    }
+    SDL_memcpy(data, player, size);
+    return true;
+}
+
+void Region_SetSky(float time_of_day)
+{
+    level.has_sky = true;
+    level.time_of_day = time_of_day;
+    is_level_dirty = true;
+}
+
+bool Region_GetSky(float* time_of_day)
+{
+    if (level.has_sky)
+    {
+        *time_of_day = level.time_of_day;
+    }
+    return level.has_sky;
+}
+
+void Region_SetBlock(int cx, int cz, int bx, int by, int bz, Block block)
+{
+    RegionChunk* chunk = GetPendingChunk(cx, cz);
+    if (!chunk)
+    {
+        chunk = AddPendingChunk(cx, cz);
+        if (!chunk)
+        {
+            return;
+        }
+    }
+    SetEdit(chunk, GetIndex(bx - cx, by, bz - cz), block);
+}
+
+void Region_GetBlocks(void* userdata, int cx, int cz, RegionSetBlock callback)
+{
+    int bx;
+    int by;
+    int bz;
+    RegionChunk* chunk = GetPendingChunk(cx, cz);
+    if (chunk)
+    {
+        for (Uint32 i = 0; i < chunk->count; i++)
+        {
+            GetPosition(chunk->edits[i] >> 8, &bx, &by, &bz);
+            callback(userdata, cx + bx, by, cz + bz, chunk->edits[i] & 0xFF);
+        }
+        return;
+    }
+    int rx;
+    int rz;
+    int sx;
+    int sz;
+    GetRegion(cx, cz, &rx, &rz, &sx, &sz);
+    Region* region = OpenRegion(rx, rz, false);
+    if (!region)
+    {
+        return;
+    }
+    const RegionSlot* slot;
+    const Uint8* data = GetPayload(region, sx, sz, &slot);
+    if (!data)
+    {
+        return;
+    }
+    const Uint8* end = data + slot->size;
+    Uint32 index = 0;
+    for (Uint32 i = 0; i < slot->count && data < end; i++)
+    {
+        Uint32 edit = DecodeEdit(&data, end, index);
+        index = edit >> 8;
+        GetPosition(index, &bx, &by, &bz);
+        callback(userdata, cx + bx, by, cz + bz, edit & 0xFF);
+    }
+}
+
+static SDL_EnumerationResult SDLCALL EnumerateFunction(void* userdata, const char* dirname, const char* fname)
+{
+    RegionEnumerator* enumerator = userdata;
+    int rx;
+    int rz;
+    if (SDL_sscanf(fname, "r.%d.%d.region", &rx, &rz) != 2)
+    {
+        return SDL_ENUM_CONTINUE;
+    }
+    Region* region = OpenRegion(rx, rz, false);
+    if (!region)
+    {
+        return SDL_ENUM_CONTINUE;
+    }
+    const RegionHeader* header = GetHeader(region);
+    for (int sx = 0; sx < REGION_WIDTH; sx++)
+    for (int sz = 0; sz < REGION_WIDTH; sz++)
+    {
+        if (header->slots[sx][sz].size)
+        {
+            int cx = (rx * REGION_WIDTH + sx) * CHUNK_WIDTH;
+            int cz = (rz * REGION_WIDTH + sz) * CHUNK_WIDTH;
+            enumerator->callback(enumerator->userdata, cx, cz);
+        }
+    }
+    return SDL_ENUM_CONTINUE;
+}
+
+void Region_GetChunks(void* userdata, RegionAddChunk callback)
+{
+    RegionEnumerator enumerator = {userdata, callback};
+    if (!SDL_EnumerateDirectory(directory, EnumerateFunction, &enumerator))
+    {
+        SDL_Log("Failed to enumerate %s directory: %s", directory, SDL_GetError());
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+#include "block.h"
+
+#define REGION_WIDTH 32
+
+typedef void (*RegionSetBlock)(void* userdata, int bx, int by, int bz, Block block);
+typedef void (*RegionAddChunk)(void* userdata, int cx, int cz);
+
+bool Region_Init(const char* path);
+void Region_Free();
+void Region_Commit();
+void Region_SetPlayer(const void* data, int size);
+bool Region_GetPlayer(void* data, int size);
+void Region_SetSky(float time_of_day);
+bool Region_GetSky(float* time_of_day);
+void Region_SetBlock(int cx, int cz, int bx, int by, int bz, Block block);
+void Region_GetBlocks(void* userdata, int cx, int cz, RegionSetBlock callback);
+void Region_GetChunks(void* userdata, RegionAddChunk callback);
@@ -1,9 +1,14 @@
 #include <SDL3/SDL.h>
 #include <sqlite3.h>
 
+#include "rand.h"
+#include "region.h"
 #include "save.h"
+#include "worker.h"
+#include "world.h"
 
 static const char* NAME = "blocks.sqlite3";
+static const char* REGION_NAME = "regions/";
 static const char* SCHEMA =
     "CREATE TABLE IF NOT EXISTS players ("
     "    id INT PRIMARY KEY NOT NULL,"
@@ -29,7 +34,56 @@ static const char* SET_SKY = "INSERT OR REPLACE INTO sky (id, time_of_day) VALUE
 static const char* GET_SKY = "SELECT time_of_day FROM sky WHERE id = 0;";
 static const char* SET_BLOCK = "INSERT OR REPLACE INTO blocks (cx, cz, bx, by, bz, block) VALUES (?, ?, ?, ?, ?, ?);";
 static const char* GET_BLOCKS = "SELECT bx, by, bz, block FROM blocks WHERE cx = ? AND cz = ?;";
+static const char* GET_CHUNKS = "SELECT DISTINCT cx, cz FROM blocks;";
+static const char* DELETE_BLOCK = "DELETE FROM blocks WHERE cx = ? AND cz = ? AND bx = ? AND by = ? AND bz = ?;";
+static const char* GET_COMPACT_CHUNKS = "SELECT DISTINCT cx, cz FROM blocks WHERE (cx, cz) > (?, ?) ORDER BY cx, cz LIMIT ?;";
+static const Uint64 EMPTY_CHUNK = SDL_MAX_UINT64;
+static const Uint64 COMPACT_BUDGET = 50000000;
+static const int VACUUM_PAGES = 1024;
 
+#define COMPACT_CHUNKS 16
+
+typedef struct SaveChunks
+{
+    Uint64* keys;
+    Uint32 count;
+    Uint32 capacity;
+    bool is_lossy;
+} SaveChunks;
+
+typedef struct SaveEdit
+{
+    int cx;
+    int cz;
+    int bx;
+    int by;
+    int bz;
+    Block block;
+} SaveEdit;
+
+// writes from the main thread wait here for the save worker, so the main thread never takes the connection lock
+typedef struct SavePending
+{
+    SaveEdit* edits;
+    int size;
+    int capacity;
+    Uint8* player;
+    int player_size;
+    int player_capacity;
+    bool has_player;
+    bool has_sky;
+    float time_of_day;
+} SavePending;
+
+typedef struct SaveChunk
+{
+    int x;
+    int z;
+    Block blocks[CHUNK_WIDTH][CHUNK_HEIGHT][CHUNK_WIDTH];
+} SaveChunk;
+
+static SaveBackend backend;
+static bool is_init;
 static sqlite3* handle;
 static sqlite3_stmt* set_player;
 static sqlite3_stmt* get_player;
@@ -37,7 +91,35 @@ static sqlite3_stmt* set_sky;
 static sqlite3_stmt* get_sky;
 static sqlite3_stmt* set_block;
 static sqlite3_stmt* get_blocks;
+static sqlite3_stmt* delete_block;
+static sqlite3_stmt* get_compact_chunks;
 static SDL_Mutex* mutex;
+static sqlite3* checkpoint_handle;
+static Worker worker;
+static SDL_AtomicInt histogram[SAVE_HISTOGRAM_SIZE];
+static SDL_AtomicInt stalls[SAVE_HISTOGRAM_SIZE];
+static SDL_AtomicInt max_stall;
+static SDL_Mutex* queue_mutex;
+static SavePending pending;
+static SavePending draining;
+static SDL_Mutex* chunk_mutex;
+static SaveChunks saved_chunks;
+static SDL_AtomicInt skipped_queries;
+static SDL_AtomicInt edits;
+static int compact_edits;
+static int compact_x;
+static int compact_z;
+static bool is_compacting;
+static int compacted_chunks;
+static int compacted_blocks;
+static SaveChunk* compact_chunk;
+static int (*compact_positions)[3];
+static bool is_incremental;
+static Uint64 load_ticks;
+static Uint64 save_ticks;
+static int load_chunks;
+static int load_blocks;
+static int save_blocks;
 
 static bool Execute(const char* sql, const char* name)
 {
@@ -59,51 +141,454 @@ static bool Prepare(sqlite3_stmt** statement, const char* sql, const char* name)
     return true;
 }
 
-bool Save_Init()
+static int GetPragma(const char* sql)
 {
-    char* pref_path = SDL_GetPrefPath(NULL, "blocks");
-    if (!pref_path)
+    sqlite3_stmt* statement;
+    int value = 0;
+    if (Prepare(&statement, sql, "pragma") && sqlite3_step(statement) == SQLITE_ROW)
     {
-        SDL_Log("Failed to get pref path: %s", SDL_GetError());
-        return false;
+        value = sqlite3_column_int(statement, 0);
     }
-    char path[1024] = {0};
-    SDL_snprintf(path, sizeof(path), "%s%s", pref_path, NAME);
-    SDL_free(pref_path);
-    if (sqlite3_open(path, &handle))
+    sqlite3_finalize(statement);
+    return value;
+}
+
+static void AddToHistogram(SDL_AtomicInt buckets[SAVE_HISTOGRAM_SIZE], Uint64 ms)
+{
+    int bucket = 0;
+    while (bucket < SAVE_HISTOGRAM_SIZE - 1 && ms >= (1ull << bucket))
     {
-        SDL_Log("Failed to open %s database: %s", path, sqlite3_errmsg(handle));
-        sqlite3_close(handle);
-        handle = NULL;
-        return false;
+        bucket++;
     }
-    mutex = SDL_CreateMutex();
-    if (!mutex)
+    SDL_AddAtomicInt(&buckets[bucket], 1);
+}
+
+static void LockQueue()
+{
+    Uint64 start = SDL_GetTicksNS();
+    SDL_LockMutex(queue_mutex);
+    // only the main thread queues writes, so this is how long it waited on the save worker
+    Uint64 ns = SDL_GetTicksNS() - start;
+    AddToHistogram(stalls, ns / 1000000);
+    int us = (int) SDL_min(ns / 1000, SDL_MAX_SINT32);
+    int max = SDL_GetAtomicInt(&max_stall);
+    while (us > max && !SDL_CompareAndSwapAtomicInt(&max_stall, max, us))
+    {
+        max = SDL_GetAtomicInt(&max_stall);
+    }
+}
+
+static bool AppendEdit(SavePending* queue, const SaveEdit* edit)
+{
+    if (queue->size == queue->capacity)
+    {
+        int capacity = SDL_max(256, queue->capacity * 2);
+        SaveEdit* edits = SDL_realloc(queue->edits, capacity * sizeof(SaveEdit));
+        if (!edits)
+        {
+            SDL_Log("Failed to allocate pending edits");
+            return false;
+        }
+        queue->edits = edits;
+        queue->capacity = capacity;
+    }
+    queue->edits[queue->size++] = *edit;
+    return true;
+}
+
+static bool SetPendingPlayer(SavePending* queue, const void* data, int size)
+{
+    if (size > queue->player_capacity)
+    {
+        Uint8* player = SDL_realloc(queue->player, size);
+        if (!player)
+        {
+            SDL_Log("Failed to allocate pending player");
+            return false;
+        }
+        queue->player = player;
+        queue->player_capacity = size;
+    }
+    SDL_memcpy(queue->player, data, size);
+    queue->player_size = size;
+    queue->has_player = true;
+    return true;
+}
+
+static void FreePending(SavePending* queue)
+{
+    SDL_free(queue->edits);
+    SDL_free(queue->player);
+    SDL_zerop(queue);
+}
+
+static Uint64 GetChunkKey(int cx, int cz)
+{
+    return ((Uint64) (Uint32) cx << 32) | (Uint32) cz;
+}
+
+static Uint32 HashChunkKey(Uint64 key)
+{
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDull;
+    key ^= key >> 33;
+    return (Uint32) key;
+}
+
+static void InsertChunkKey(SaveChunks* chunks, Uint64 key)
+{
+    SDL_assert(key != EMPTY_CHUNK);
+    Uint32 mask = chunks->capacity - 1;
+    Uint32 index = HashChunkKey(key) & mask;
+    while (chunks->keys[index] != EMPTY_CHUNK)
+    {
+        if (chunks->keys[index] == key)
+        {
+            return;
+        }
+        index = (index + 1) & mask;
+    }
+    chunks->keys[index] = key;
+    chunks->count++;
+}
+
+static void AddChunk(SaveChunks* chunks, int cx, int cz)
+{
+    if (chunks->count + 1 > chunks->capacity / 2)
+    {
+        SaveChunks old_chunks = *chunks;
+        Uint32 capacity = SDL_max(64, chunks->capacity * 2);
+        Uint64* keys = SDL_malloc(capacity * sizeof(Uint64));
+        if (!keys)
+        {
+            // a dropped key would hide saved edits, so every chunk counts as saved from now on
+            SDL_Log("Failed to allocate chunk index");
+            chunks->is_lossy = true;
+            return;
+        }
+        SDL_memset(keys, 0xFF, capacity * sizeof(Uint64));
+        chunks->keys = keys;
+        chunks->capacity = capacity;
+        chunks->count = 0;
+        for (Uint32 i = 0; i < old_chunks.capacity; i++)
+        {
+            if (old_chunks.keys[i] != EMPTY_CHUNK)
+            {
+                InsertChunkKey(chunks, old_chunks.keys[i]);
+            }
+        }
+        SDL_free(old_chunks.keys);
+    }
+    InsertChunkKey(chunks, GetChunkKey(cx, cz));
+}
+
+static bool HasChunk(const SaveChunks* chunks, int cx, int cz)
+{
+    if (chunks->is_lossy)
+    {
+        return true;
+    }
+    if (!chunks->count)
     {
-        SDL_Log("Failed to create mutex: %s", SDL_GetError());
-        sqlite3_close(handle);
-        handle = NULL;
         return false;
     }
-    if (!Execute(SCHEMA, "create schema") || !Prepare(&set_player, SET_PLAYER, "set player") ||
-        !Prepare(&get_player, GET_PLAYER, "get player") || !Prepare(&set_sky, SET_SKY, "set sky") ||
-        !Prepare(&get_sky, GET_SKY, "get sky") || !Prepare(&set_block, SET_BLOCK, "set block") ||
-        !Prepare(&get_blocks, GET_BLOCKS, "get blocks"))
+    Uint64 key = GetChunkKey(cx, cz);
+    Uint32 mask = chunks->capacity - 1;
+    Uint32 index = HashChunkKey(key) & mask;
+    while (chunks->keys[index] != EMPTY_CHUNK)
+    {
+        if (chunks->keys[index] == key)
+        {
+            return true;
+        }
+        index = (index + 1) & mask;
+    }
+    return false;
+}
+
+static void FreeChunks(SaveChunks* chunks)
+{
+    SDL_free(chunks->keys);
+    chunks->keys = NULL;
+    chunks->count = 0;
+    chunks->capacity = 0;
+    chunks->is_lossy = false;
+}
+
+static void AddChunkFunction(void* userdata, int cx, int cz)
+{
+    AddChunk(&saved_chunks, cx, cz);
+}
+
+static bool LoadChunks()
+{
+    sqlite3_stmt* get_chunks;
+    if (!Prepare(&get_chunks, GET_CHUNKS, "get chunks"))
     {
-        Save_Free();
         return false;
     }
-    sqlite3_exec(handle, "BEGIN;", NULL, NULL, NULL);
+    while (sqlite3_step(get_chunks) == SQLITE_ROW)
+    {
+        AddChunk(&saved_chunks, sqlite3_column_int(get_chunks, 0), sqlite3_column_int(get_chunks, 1));
+    }
+    sqlite3_finalize(get_chunks);
     return true;
 }
 
-void Save_Free()
+static void WritePlayer(const void* data, int size)
 {
-    if (!handle)
+    if (backend == SAVE_BACKEND_REGION)
     {
+        Region_SetPlayer(data, size);
         return;
     }
-    SDL_DestroyMutex(mutex);
+    sqlite3_bind_blob(set_player, 1, data, size, SQLITE_TRANSIENT);
+    if (sqlite3_step(set_player) != SQLITE_DONE)
+    {
+        SDL_Log("Failed to set player: %s", sqlite3_errmsg(handle));
+    }
+    sqlite3_reset(set_player);
+}
+
+static void WriteSky(float time_of_day)
+{
+    if (backend == SAVE_BACKEND_REGION)
+    {
+        Region_SetSky(time_of_day);
+        return;
+    }
+    sqlite3_bind_double(set_sky, 1, time_of_day);
+    if (sqlite3_step(set_sky) != SQLITE_DONE)
+    {
+        SDL_Log("Failed to set sky: %s", sqlite3_errmsg(handle));
+    }
+    sqlite3_reset(set_sky);
+}
+
+static void WriteBlock(const SaveEdit* edit)
+{
+    Uint64 start = SDL_GetTicksNS();
+    if (backend == SAVE_BACKEND_REGION)
+    {
+        Region_SetBlock(edit->cx, edit->cz, edit->bx, edit->by, edit->bz, edit->block);
+    }
+    else
+    {
+        sqlite3_bind_int(set_block, 1, edit->cx);
+        sqlite3_bind_int(set_block, 2, edit->cz);
+        sqlite3_bind_int(set_block, 3, edit->bx);
+        sqlite3_bind_int(set_block, 4, edit->by);
+        sqlite3_bind_int(set_block, 5, edit->bz);
+        sqlite3_bind_int(set_block, 6, edit->block);
+        if (sqlite3_step(set_block) != SQLITE_DONE)
+        {
+            SDL_Log("Failed to set block: %s", sqlite3_errmsg(handle));
+        }
+        sqlite3_reset(set_block);
+    }
+    save_ticks += SDL_GetTicksNS() - start;
+    save_blocks++;
+}
+
+// moves queued writes into the backend, with the connection lock held
+static void Drain()
+{
+    SDL_LockMutex(queue_mutex);
+    SavePending queue = pending;
+    pending = draining;
+    draining = queue;
+    pending.size = 0;
+    pending.has_player = false;
+    pending.has_sky = false;
+    SDL_UnlockMutex(queue_mutex);
+    if (draining.has_player)
+    {
+        WritePlayer(draining.player, draining.player_size);
+    }
+    if (draining.has_sky)
+    {
+        WriteSky(draining.time_of_day);
+    }
+    for (int i = 0; i < draining.size; i++)
+    {
+        WriteBlock(&draining.edits[i]);
+    }
+    draining.size = 0;
+    draining.has_player = false;
+    draining.has_sky = false;
+}
+
+static void GenerateBlockFunction(void* userdata, int bx, int by, int bz, Block block)
+{
+    SaveChunk* chunk = userdata;
+    bx -= chunk->x;
+    bz -= chunk->z;
+    if (bx >= 0 && by >= 0 && bz >= 0 && bx < CHUNK_WIDTH && by < CHUNK_HEIGHT && bz < CHUNK_WIDTH)
+    {
+        chunk->blocks[bx][by][bz] = block;
+    }
+}
+
+static int CompactChunk(SaveChunk* chunk, int (*positions)[3], int capacity)
+{
+    // terrain is generated outside the lock so edits and loads are only held up by the deletes
+    SDL_memset(chunk->blocks, 0, sizeof(chunk->blocks));
+    Rand_GetBlocks(chunk, chunk->x, chunk->z, GenerateBlockFunction);
+    SDL_LockMutex(mutex);
+    int count = 0;
+    sqlite3_bind_int(get_blocks, 1, chunk->x);
+    sqlite3_bind_int(get_blocks, 2, chunk->z);
+    while (sqlite3_step(get_blocks) == SQLITE_ROW && count < capacity)
+    {
+        int bx = sqlite3_column_int(get_blocks, 0);
+        int by = sqlite3_column_int(get_blocks, 1);
+        int bz = sqlite3_column_int(get_blocks, 2);
+        Block block = sqlite3_column_int(get_blocks, 3);
+        int x = bx - chunk->x;
+        int z = bz - chunk->z;
+        if (x < 0 || by < 0 || z < 0 || x >= CHUNK_WIDTH || by >= CHUNK_HEIGHT || z >= CHUNK_WIDTH)
+        {
+            continue;
+        }
+        if (chunk->blocks[x][by][z] == block)
+        {
+            positions[count][0] = bx;
+            positions[count][1] = by;
+            positions[count][2] = bz;
+            count++;
+        }
+    }
+    sqlite3_reset(get_blocks);
+    for (int i = 0; i < count; i++)
+    {
+        sqlite3_bind_int(delete_block, 1, chunk->x);
+        sqlite3_bind_int(delete_block, 2, chunk->z);
+        sqlite3_bind_int(delete_block, 3, positions[i][0]);
+        sqlite3_bind_int(delete_block, 4, positions[i][1]);
+        sqlite3_bind_int(delete_block, 5, positions[i][2]);
+        if (sqlite3_step(delete_block) != SQLITE_DONE)
+        {
+            SDL_Log("Failed to delete block: %s", sqlite3_errmsg(handle));
+        }
+        sqlite3_reset(delete_block);
+    }
+    SDL_UnlockMutex(mutex);
+    return count;
+}
+
+static void Vacuum()
+{
+    // saves from before incremental vacuum reuse their free pages until they're rebuilt on the next start
+    if (!is_incremental)
+    {
+        return;
+    }
+    SDL_LockMutex(mutex);
+    Execute("PRAGMA incremental_vacuum;", "vacuum");
+    SDL_UnlockMutex(mutex);
+}
+
+static void Compact()
+{
+    if (!is_compacting)
+    {
+        // a new pass over every stored chunk only starts once something was edited
+        int count = SDL_GetAtomicInt(&edits);
+        if (count == compact_edits)
+        {
+            return;
+        }
+        compact_edits = count;
+        is_compacting = true;
+    }
+    int keys[COMPACT_CHUNKS][2];
+    int count = 0;
+    SDL_LockMutex(mutex);
+    sqlite3_bind_int(get_compact_chunks, 1, compact_x);
+    sqlite3_bind_int(get_compact_chunks, 2, compact_z);
+    sqlite3_bind_int(get_compact_chunks, 3, COMPACT_CHUNKS);
+    while (count < COMPACT_CHUNKS && sqlite3_step(get_compact_chunks) == SQLITE_ROW)
+    {
+        keys[count][0] = sqlite3_column_int(get_compact_chunks, 0);
+        keys[count][1] = sqlite3_column_int(get_compact_chunks, 1);
+        count++;
+    }
+    sqlite3_reset(get_compact_chunks);
+    SDL_UnlockMutex(mutex);
+    if (!count)
+    {
+        SDL_Log("Compacted %d blocks from %d chunks", compacted_blocks, compacted_chunks);
+        compact_x = SDL_MIN_SINT32;
+        compact_z = SDL_MIN_SINT32;
+        compacted_chunks = 0;
+        compacted_blocks = 0;
+        is_compacting = false;
+        return;
+    }
+    // every cell of a chunk can be edited at most once
+    int capacity = CHUNK_WIDTH * CHUNK_HEIGHT * CHUNK_WIDTH;
+    if (!compact_chunk)
+    {
+        compact_chunk = SDL_malloc(sizeof(SaveChunk));
+    }
+    if (!compact_positions)
+    {
+        compact_positions = SDL_malloc(capacity * sizeof(int[3]));
+    }
+    if (!compact_chunk || !compact_positions)
+    {
+        SDL_Log("Failed to allocate compaction");
+        return;
+    }
+    SaveChunk* chunk = compact_chunk;
+    Uint64 start = SDL_GetTicksNS();
+    int deleted = 0;
+    for (int i = 0; i < count && SDL_GetTicksNS() - start < COMPACT_BUDGET; i++)
+    {
+        chunk->x = keys[i][0];
+        chunk->z = keys[i][1];
+        deleted += CompactChunk(chunk, compact_positions, capacity);
+        compact_x = keys[i][0];
+        compact_z = keys[i][1];
+        compacted_chunks++;
+    }
+    compacted_blocks += deleted;
+    if (deleted)
+    {
+        Vacuum();
+    }
+}
+
+static void CommitFunction(void* data)
+{
+    Uint64 start = SDL_GetTicksNS();
+    SDL_LockMutex(mutex);
+    Drain();
+    if (backend == SAVE_BACKEND_REGION)
+    {
+        Region_Commit();
+    }
+    else
+    {
+        sqlite3_exec(handle, "COMMIT;", NULL, NULL, NULL);
+        sqlite3_exec(handle, "BEGIN;", NULL, NULL, NULL);
+    }
+    SDL_UnlockMutex(mutex);
+    AddToHistogram(histogram, (SDL_GetTicksNS() - start) / 1000000);
+    if (backend == SAVE_BACKEND_SQLITE)
+    {
+        Compact();
+    }
+    // checkpoint on a separate connection so the writer is never held up
+    if (checkpoint_handle)
+    {
+        sqlite3_wal_checkpoint_v2(checkpoint_handle, NULL, SQLITE_CHECKPOINT_PASSIVE, NULL, NULL);
+    }
+}
+
+static void FreeSqlite()
+{
+    sqlite3_close(checkpoint_handle);
     sqlite3_exec(handle, "COMMIT;", NULL, NULL, NULL);
     sqlite3_finalize(set_player);
     sqlite3_finalize(get_player);
@@ -111,7 +596,14 @@ void Save_Free()
     sqlite3_finalize(get_sky);
     sqlite3_finalize(set_block);
     sqlite3_finalize(get_blocks);
+    sqlite3_finalize(delete_block);
+    sqlite3_finalize(get_compact_chunks);
     sqlite3_close(handle);
+    SDL_free(compact_chunk);
+    SDL_free(compact_positions);
+    compact_chunk = NULL;
+    compact_positions = NULL;
+    checkpoint_handle = NULL;
     handle = NULL;
     set_player = NULL;
     get_player = NULL;
@@ -119,44 +611,229 @@ void Save_Free()
     get_sky = NULL;
     set_block = NULL;
     get_blocks = NULL;
+    delete_block = NULL;
+    get_compact_chunks = NULL;
+}
+
+static bool InitSqlite(const char* pref_path)
+{
+    char path[1024] = {0};
+    SDL_snprintf(path, sizeof(path), "%s%s", pref_path, NAME);
+    if (sqlite3_open(path, &handle))
+    {
+        SDL_Log("Failed to open %s database: %s", path, sqlite3_errmsg(handle));
+        sqlite3_close(handle);
+        handle = NULL;
+        return false;
+    }
+    // only applies to new saves, older ones switch over when they're rebuilt below
+    if (!Execute("PRAGMA auto_vacuum = INCREMENTAL;", "enable incremental vacuum") ||
+        !Execute("PRAGMA journal_mode = WAL;", "enable wal") ||
+        !Execute("PRAGMA synchronous = NORMAL;", "set synchronous") ||
+        !Execute("PRAGMA wal_autocheckpoint = 0;", "disable autocheckpoint") ||
+        !Execute(SCHEMA, "create schema") || !Prepare(&set_player, SET_PLAYER, "set player") ||
+        !Prepare(&get_player, GET_PLAYER, "get player") || !Prepare(&set_sky, SET_SKY, "set sky") ||
+        !Prepare(&get_sky, GET_SKY, "get sky") || !Prepare(&set_block, SET_BLOCK, "set block") ||
+        !Prepare(&get_blocks, GET_BLOCKS, "get blocks") || !Prepare(&delete_block, DELETE_BLOCK, "delete block") ||
+        !Prepare(&get_compact_chunks, GET_COMPACT_CHUNKS, "get compact chunks") || !LoadChunks())
+    {
+        FreeSqlite();
+        return false;
+    }
+    is_incremental = GetPragma("PRAGMA auto_vacuum;") == 2;
+    int free_pages = GetPragma("PRAGMA freelist_count;");
+    if (!is_incremental && free_pages >= VACUUM_PAGES && free_pages * 4 >= GetPragma("PRAGMA page_count;"))
+    {
+        // rebuilt once on start rather than on the save worker, which also switches the save over
+        SDL_Log("Rebuilding %s database", path);
+        is_incremental = Execute("VACUUM;", "vacuum") && GetPragma("PRAGMA auto_vacuum;") == 2;
+    }
+    if (sqlite3_open(path, &checkpoint_handle))
+    {
+        SDL_Log("Failed to open %s checkpoint database: %s", path, sqlite3_errmsg(checkpoint_handle));
+        sqlite3_close(checkpoint_handle);
+        checkpoint_handle = NULL;
+    }
+    // chunks from earlier sessions are compacted too, so every save starts with a full pass
+    compact_edits = 0;
+    compact_x = SDL_MIN_SINT32;
+    compact_z = SDL_MIN_SINT32;
+    is_compacting = true;
+    compacted_chunks = 0;
+    compacted_blocks = 0;
+    SDL_SetAtomicInt(&edits, 0);
+    sqlite3_exec(handle, "BEGIN;", NULL, NULL, NULL);
+    return true;
+}
+
+static bool InitRegion(const char* pref_path)
+{
+    char path[1024] = {0};
+    SDL_snprintf(path, sizeof(path), "%s%s", pref_path, REGION_NAME);
+    if (!Region_Init(path))
+    {
+        return false;
+    }
+    Region_GetChunks(NULL, AddChunkFunction);
+    return true;
+}
+
+bool Save_Init(SaveBackend in_backend, const char* path)
+{
+    backend = in_backend;
+    char* pref_path = path ? SDL_strdup(path) : SDL_GetPrefPath(NULL, "blocks");
+    if (!pref_path)
+    {
+        SDL_Log("Failed to get pref path: %s", SDL_GetError());
+        return false;
+    }
+    mutex = SDL_CreateMutex();
+    chunk_mutex = SDL_CreateMutex();
+    queue_mutex = SDL_CreateMutex();
+    if (!mutex || !chunk_mutex || !queue_mutex)
+    {
+        SDL_Log("Failed to create mutex: %s", SDL_GetError());
+        SDL_free(pref_path);
+        Save_Free();
+        return false;
+    }
+    bool success;
+    if (backend == SAVE_BACKEND_REGION)
+    {
+        success = InitRegion(pref_path);
+    }
+    else
+    {
+        success = InitSqlite(pref_path);
+    }
+    SDL_free(pref_path);
+    if (!success)
+    {
+        Save_Free();
+        return false;
+    }
+    for (int i = 0; i < SAVE_HISTOGRAM_SIZE; i++)
+    {
+        SDL_SetAtomicInt(&histogram[i], 0);
+        SDL_SetAtomicInt(&stalls[i], 0);
+    }
+    SDL_SetAtomicInt(&max_stall, 0);
+    load_ticks = 0;
+    save_ticks = 0;
+    load_chunks = 0;
+    load_blocks = 0;
+    save_blocks = 0;
+    Worker_Init(&worker);
+    is_init = true;
+    return true;
+}
+
+void Save_Free()
+{
+    if (is_init)
+    {
+        Worker_Free(&worker);
+        Uint32 commits[SAVE_HISTOGRAM_SIZE];
+        Save_GetHistogram(commits);
+        for (int i = 0; i < SAVE_HISTOGRAM_SIZE - 1; i++)
+        {
+            SDL_Log("Commits under %d ms: %u", 1 << i, commits[i]);
+        }
+        SDL_Log("Commits over %d ms: %u", 1 << (SAVE_HISTOGRAM_SIZE - 2), commits[SAVE_HISTOGRAM_SIZE - 1]);
+        for (int i = 0; i < SAVE_HISTOGRAM_SIZE - 1; i++)
+        {
+            SDL_Log("Main thread stalls under %d ms: %d", 1 << i, SDL_GetAtomicInt(&stalls[i]));
+        }
+        SDL_Log("Main thread stalls over %d ms: %d", 1 << (SAVE_HISTOGRAM_SIZE - 2), SDL_GetAtomicInt(&stalls[SAVE_HISTOGRAM_SIZE - 1]));
+        SDL_Log("Longest main thread stall: %d us", SDL_GetAtomicInt(&max_stall));
+        SDL_Log("Skipped queries: %d", Save_GetSkippedQueries());
+        SDL_Log("Loaded %d chunks (%d blocks) in %.2f ms", load_chunks, load_blocks, load_ticks / 1000000.0);
+        SDL_Log("Saved %d blocks in %.2f ms", save_blocks, save_ticks / 1000000.0);
+    }
+    if (is_init)
+    {
+        Drain();
+    }
+    if (backend == SAVE_BACKEND_REGION)
+    {
+        if (mutex)
+        {
+            Region_Commit();
+            Region_Free();
+        }
+    }
+    else if (handle)
+    {
+        FreeSqlite();
+    }
+    SDL_DestroyMutex(mutex);
+    SDL_DestroyMutex(chunk_mutex);
+    SDL_DestroyMutex(queue_mutex);
+    FreeChunks(&saved_chunks);
+    FreePending(&pending);
+    FreePending(&draining);
     mutex = NULL;
+    chunk_mutex = NULL;
+    queue_mutex = NULL;
+    SDL_SetAtomicInt(&skipped_queries, 0);
+    is_init = false;
 }
 
 void Save_Commit()
 {
-    if (!handle)
+    if (!is_init || Worker_IsBusy(&worker))
     {
         return;
     }
-    SDL_LockMutex(mutex);
-    sqlite3_exec(handle, "COMMIT;", NULL, NULL, NULL);
-    sqlite3_exec(handle, "BEGIN;", NULL, NULL, NULL);
-    SDL_UnlockMutex(mutex);
+    Worker_Dispatch(&worker, CommitFunction, NULL);
+}
+
+void Save_GetHistogram(Uint32 commits[SAVE_HISTOGRAM_SIZE])
+{
+    for (int i = 0; i < SAVE_HISTOGRAM_SIZE; i++)
+    {
+        commits[i] = SDL_GetAtomicInt(&histogram[i]);
+    }
 }
 
 void Save_SetPlayer(const void* data, int size)
 {
-    if (!handle)
+    if (!is_init)
     {
         return;
     }
-    SDL_LockMutex(mutex);
-    sqlite3_bind_blob(set_player, 1, data, size, SQLITE_TRANSIENT);
-    if (sqlite3_step(set_player) != SQLITE_DONE)
+    LockQueue();
+    bool is_queued = SetPendingPlayer(&pending, data, size);
+    SDL_UnlockMutex(queue_mutex);
+    if (!is_queued)
     {
-        SDL_Log("Failed to set player: %s", sqlite3_errmsg(handle));
+        SDL_LockMutex(mutex);
+        WritePlayer(data, size);
+        SDL_UnlockMutex(mutex);
     }
-    sqlite3_reset(set_player);
-    SDL_UnlockMutex(mutex);
 }
 
 bool Save_GetPlayer(void* data, int size)
 {
-    if (!handle)
+    if (!is_init)
     {
         return false;
     }
+    SDL_LockMutex(queue_mutex);
+    if (pending.has_player && pending.player_size == size)
+    {
+        SDL_memcpy(data, pending.player, size);
+        SDL_UnlockMutex(queue_mutex);
+        return true;
+    }
+    SDL_UnlockMutex(queue_mutex);
     SDL_LockMutex(mutex);
+    if (backend == SAVE_BACKEND_REGION)
+    {
+        bool has_player = Region_GetPlayer(data, size);
+        SDL_UnlockMutex(mutex);
+        return has_player;
+    }
     bool has_player = sqlite3_step(get_player) == SQLITE_ROW;
     if (has_player)
     {
@@ -179,27 +856,37 @@ bool Save_GetPlayer(void* data, int size)
 
 void Save_SetSky(float time_of_day)
 {
-    if (!handle)
+    if (!is_init)
     {
         return;
     }
-    SDL_LockMutex(mutex);
-    sqlite3_bind_double(set_sky, 1, time_of_day);
-    if (sqlite3_step(set_sky) != SQLITE_DONE)
-    {
-        SDL_Log("Failed to set sky: %s", sqlite3_errmsg(handle));
-    }
-    sqlite3_reset(set_sky);
-    SDL_UnlockMutex(mutex);
+    LockQueue();
+    pending.time_of_day = time_of_day;
+    pending.has_sky = true;
+    SDL_UnlockMutex(queue_mutex);
 }
 
 bool Save_GetSky(float* time_of_day)
 {
-    if (!handle)
+    if (!is_init)
     {
         return false;
     }
+    SDL_LockMutex(queue_mutex);
+    if (pending.has_sky)
+    {
+        *time_of_day = pending.time_of_day;
+        SDL_UnlockMutex(queue_mutex);
+        return true;
+    }
+    SDL_UnlockMutex(queue_mutex);
     SDL_LockMutex(mutex);
+    if (backend == SAVE_BACKEND_REGION)
+    {
+        bool has_sky = Region_GetSky(time_of_day);
+        SDL_UnlockMutex(mutex);
+        return has_sky;
+    }
     bool has_sky = sqlite3_step(get_sky) == SQLITE_ROW;
     if (has_sky)
     {
@@ -210,44 +897,112 @@ bool Save_GetSky(float* time_of_day)
     return has_sky;
 }
 
+void Save_BeginBatch()
+{
+    if (is_init)
+    {
+        // the mutex is recursive and keeps the worker from draining half a batch
+        LockQueue();
+    }
+}
+
+void Save_EndBatch()
+{
+    if (is_init)
+    {
+        SDL_UnlockMutex(queue_mutex);
+    }
+}
+
 void Save_SetBlock(int cx, int cz, int bx, int by, int bz, Block block)
 {
-    if (!handle)
+    if (!is_init)
     {
         return;
     }
-    SDL_LockMutex(mutex);
-    sqlite3_bind_int(set_block, 1, cx);
-    sqlite3_bind_int(set_block, 2, cz);
-    sqlite3_bind_int(set_block, 3, bx);
-    sqlite3_bind_int(set_block, 4, by);
-    sqlite3_bind_int(set_block, 5, bz);
-    sqlite3_bind_int(set_block, 6, block);
-    if (sqlite3_step(set_block) != SQLITE_DONE)
+    SaveEdit edit = {cx, cz, bx, by, bz, block};
+    LockQueue();
+    bool is_queued = AppendEdit(&pending, &edit);
+    SDL_UnlockMutex(queue_mutex);
+    if (!is_queued)
     {
-        SDL_Log("Failed to set block: %s", sqlite3_errmsg(handle));
+        SDL_LockMutex(mutex);
+        WriteBlock(&edit);
+        SDL_UnlockMutex(mutex);
     }
-    sqlite3_reset(set_block);
-    SDL_UnlockMutex(mutex);
+    SDL_LockMutex(chunk_mutex);
+    AddChunk(&saved_chunks, cx, cz);
+    SDL_UnlockMutex(chunk_mutex);
+    SDL_AddAtomicInt(&edits, 1);
+}
+
+typedef struct SaveQuery
+{
+    void* userdata;
+    SaveSetBlock callback;
+    int blocks;
+} SaveQuery;
+
+static void SetBlockFunction(void* userdata, int bx, int by, int bz, Block block)
+{
+    SaveQuery* query = userdata;
+    query->callback(query->userdata, bx, by, bz, block);
+    query->blocks++;
 }
 
 void Save_GetBlocks(void* userdata, int cx, int cz, SaveSetBlock callback)
 {
-    if (!handle)
+    if (!is_init)
+    {
+        return;
+    }
+    SDL_LockMutex(chunk_mutex);
+    bool has_chunk = HasChunk(&saved_chunks, cx, cz);
+    SDL_UnlockMutex(chunk_mutex);
+    if (!has_chunk)
     {
+        SDL_AddAtomicInt(&skipped_queries, 1);
         return;
     }
+    SaveQuery query = {userdata, callback, 0};
     SDL_LockMutex(mutex);
-    sqlite3_bind_int(get_blocks, 1, cx);
-    sqlite3_bind_int(get_blocks, 2, cz);
-    while (sqlite3_step(get_blocks) == SQLITE_ROW)
+    Uint64 start = SDL_GetTicksNS();
+    if (backend == SAVE_BACKEND_REGION)
     {
-        int bx = sqlite3_column_int(get_blocks, 0);
-        int by = sqlite3_column_int(get_blocks, 1);
-        int bz = sqlite3_column_int(get_blocks, 2);
-        Block block = sqlite3_column_int(get_blocks, 3);
-        callback(userdata, bx, by, bz, block);
+        Region_GetBlocks(&query, cx, cz, SetBlockFunction);
     }
-    sqlite3_reset(get_blocks);
+    else
+    {
+        sqlite3_bind_int(get_blocks, 1, cx);
+        sqlite3_bind_int(get_blocks, 2, cz);
+        while (sqlite3_step(get_blocks) == SQLITE_ROW)
+        {
+            int bx = sqlite3_column_int(get_blocks, 0);
+            int by = sqlite3_column_int(get_blocks, 1);
+            int bz = sqlite3_column_int(get_blocks, 2);
+            Block block = sqlite3_column_int(get_blocks, 3);
+            SetBlockFunction(&query, bx, by, bz, block);
+        }
+        sqlite3_reset(get_blocks);
+    }
+    // queued edits are newer than anything stored, and none are drained while the connection lock is held
+    SDL_LockMutex(queue_mutex);
+    for (int i = 0; i < pending.size; i++)
+    {
+        const SaveEdit* edit = &pending.edits[i];
+        if (edit->cx == cx && edit->cz == cz)
+        {
+            SetBlockFunction(&query, edit->bx, edit->by, edit->bz, edit->block);
+        }
+    }
+    SDL_UnlockMutex(queue_mutex);
+    load_ticks += SDL_GetTicksNS() - start;
+    load_chunks++;
+    load_blocks += query.blocks;
     SDL_UnlockMutex(mutex);
 }
+
+int Save_GetSkippedQueries()
+{
+    return SDL_GetAtomicInt(&skipped_queries);
+}
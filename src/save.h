@@ -4,14 +4,28 @@
 
 #include "block.h"
 
+// commit durations are bucketed by powers of two milliseconds
+#define SAVE_HISTOGRAM_SIZE 8
+
+typedef enum SaveBackend
+{
+    SAVE_BACKEND_SQLITE,
+    SAVE_BACKEND_REGION,
+} SaveBackend;
+
 typedef void (*SaveSetBlock)(void* userdata, int bx, int by, int bz, Block block);
 
-bool Save_Init();
+// path is a directory ending in a separator, or null for the pref path
+bool Save_Init(SaveBackend backend, const char* path);
 void Save_Free();
 void Save_Commit();
+void Save_GetHistogram(Uint32 commits[SAVE_HISTOGRAM_SIZE]);
 void Save_SetPlayer(const void* data, int size);
 bool Save_GetPlayer(void* data, int size);
 void Save_SetSky(float time_of_day);
 bool Save_GetSky(float* time_of_day);
+void Save_BeginBatch();
+void Save_EndBatch();
 void Save_SetBlock(int cx, int cz, int bx, int by, int bz, Block block);
 void Save_GetBlocks(void* userdata, int cx, int cz, SaveSetBlock callback);
+int Save_GetSkippedQueries();
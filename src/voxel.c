@@ -99,3 +99,33 @@ Voxel Voxel_PackCube(Block block, int x, int y, int z, Direction direction, int
     const int* t = TEXCOORDS[direction][index];
     return Voxel_Pack(block, x + p[0], y + p[1], z + p[2], t[0], t[1], direction, ao);
 }
+
+// an upward facing quad covering width by depth blocks
+Voxel Voxel_PackSurface(Block block, int x, int y, int z, int width, int depth, int index)
+{
+    SDL_assert(block > BLOCK_EMPTY);
+    SDL_assert(block < BLOCK_COUNT);
+    SDL_assert(width > 0);
+    SDL_assert(depth > 0);
+    SDL_assert(index < 4);
+    const int* p = CUBE_POSITIONS[DIRECTION_UP][index];
+    const int* t = TEXCOORDS[DIRECTION_UP][index];
+    return Voxel_Pack(block, x + p[0] * width, y + p[1], z + p[2] * depth, t[0], t[1], DIRECTION_UP, AO_MASK);
+}
+
+// a face of a box covering size blocks along each axis
+Voxel Voxel_PackBox(Block block, int x, int y, int z, const int size[3], Direction direction, int index)
+{
+    SDL_assert(block > BLOCK_EMPTY);
+    SDL_assert(block < BLOCK_COUNT);
+    SDL_assert(direction < 6);
+    SDL_assert(index < 4);
+    const int* p = CUBE_POSITIONS[direction][index];
+    const int* t = TEXCOORDS[direction][index];
+    return Voxel_Pack(block, x + p[0] * size[0], y + p[1] * size[1], z + p[2] * size[2], t[0], t[1], direction, AO_MASK);
+}
+
+Uint32 Voxel_PackLight(const Uint8 light[3])
+{
+    return light[0] | (light[1] << 8) | (light[2] << 16);
+}
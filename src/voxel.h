@@ -7,7 +7,17 @@
 
 typedef Uint32 Voxel;
 
+// only used with baked lights, which are a second attribute of the same stream
+typedef struct BakedVoxel
+{
+    Voxel voxel;
+    Uint32 light;
+} BakedVoxel;
+
 void Voxel_GetPosition(Direction direction, int index, int position[3]);
 void Voxel_GetAO(const int ao[4], int order[4]);
 Voxel Voxel_PackSprite(Block block, int x, int y, int z, Direction direction, int index);
 Voxel Voxel_PackCube(Block block, int x, int y, int z, Direction direction, int index, int ao);
+Voxel Voxel_PackSurface(Block block, int x, int y, int z, int width, int depth, int index);
+Voxel Voxel_PackBox(Block block, int x, int y, int z, const int size[3], Direction direction, int index);
+Uint32 Voxel_PackLight(const Uint8 light[3]);
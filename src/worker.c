@@ -77,6 +77,16 @@ bool Worker_IsBusy(Worker* worker)
     return busy;
 }
 
+void Worker_Wait(Worker* worker)
+{
+    SDL_LockMutex(worker->mutex);
+    while (worker->task)
+    {
+        SDL_WaitCondition(worker->condition, worker->mutex);
+    }
+    SDL_UnlockMutex(worker->mutex);
+}
+
 void Worker_Dispatch(Worker* worker, WorkerTask task, void* data)
 {
     SDL_assert(!Worker_IsBusy(worker));
@@ -17,4 +17,5 @@ typedef struct Worker
 void Worker_Init(Worker* worker);
 void Worker_Free(Worker* worker);
 bool Worker_IsBusy(Worker* worker);
+void Worker_Wait(Worker* worker);
 void Worker_Dispatch(Worker* worker, WorkerTask task, void* data);
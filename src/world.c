@@ -2,8 +2,11 @@
 
 #include "block.h"
 #include "buffer.h"
+#include "cache.h"
 #include "camera.h"
+#include "light.h"
 #include "map.h"
+#include "occlusion.h"
 #include "rand.h"
 #include "save.h"
 #include "voxel.h"
@@ -12,6 +15,24 @@
 #include "world.h"
 
 #define WORKERS 4
+#define MAX_LIGHT_RADIUS 15
+#define FIELD_WIDTH (CHUNK_WIDTH + MAX_LIGHT_RADIUS * 2)
+#define FLOOD_WIDTH (MAX_LIGHT_RADIUS * 2 + 1)
+#define VOXEL_PAGE_SIZE (1 << 21)
+#define LIGHT_PAGE_SIZE (1 << 16)
+#define OCCLUDER_WIDTH 10
+#define OCCLUDER_CELLS (CHUNK_WIDTH / OCCLUDER_WIDTH)
+#define OCCLUDER_DISTANCE 3
+#define SECTION_HEIGHT 16
+#define SECTION_COUNT (CHUNK_HEIGHT / SECTION_HEIGHT)
+#define FACE_GROUP_SPRITE DIRECTION_COUNT
+#define FACE_GROUP_COUNT (DIRECTION_COUNT + 1)
+#define MESH_LODS 3
+#define MESH_LOD_HYSTERESIS 15.0f
+#define MESH_LOD_CELLS (CHUNK_WIDTH / 2 + 2)
+#define MESH_BUCKETS 1024
+// bump whenever the mesher changes so stale cached meshes are never loaded
+#define MESH_CACHE_VERSION 2
 
 typedef enum TaskType
 {
@@ -35,14 +56,67 @@ typedef struct Task
     int z;
 } Task;
 
+// light levels of the chunk and its padding, flood filled from every light in reach
+typedef struct LightField
+{
+    Uint8 levels[FIELD_WIDTH][CHUNK_HEIGHT][FIELD_WIDTH][3];
+    Uint8 distances[FLOOD_WIDTH][FLOOD_WIDTH][FLOOD_WIDTH];
+    Sint8 queue[FLOOD_WIDTH * FLOOD_WIDTH * FLOOD_WIDTH][3];
+    bool is_dirty;
+} LightField;
+
+typedef struct LightList
+{
+    Light* data;
+    int size;
+    int capacity;
+} LightList;
+
 typedef struct WorldWorker
 {
     Worker worker;
     Task task;
     CPUBuffer voxels[WORLD_MESH_TYPE_COUNT];
     CPUBuffer lights;
+    LightList nearby_lights;
+    LightField* field;
 } WorldWorker;
 
+// ranges of a chunk mesh covering SECTION_HEIGHT layers of blocks, one per face direction plus one for sprites
+// meshes are laid out by face group first and section second
+typedef struct Section
+{
+    Uint32 offsets[WORLD_MESH_TYPE_COUNT][FACE_GROUP_COUNT];
+    Uint32 sizes[WORLD_MESH_TYPE_COUNT][FACE_GROUP_COUNT];
+    Uint8 min[3];
+    Uint8 max[3];
+} Section;
+
+// a mesh shared by every chunk whose neighborhood hashes the same, freed with its last reference
+typedef struct MeshEntry
+{
+    Uint64 hash;
+    int references;
+    GPUAllocation voxels[WORLD_MESH_TYPE_COUNT];
+    Section sections[SECTION_COUNT];
+    struct MeshEntry* next;
+} MeshEntry;
+
+// layout of a mesh in the disk cache, followed by the voxels of each type
+typedef struct MeshHeader
+{
+    Uint32 sizes[WORLD_MESH_TYPE_COUNT];
+    Section sections[SECTION_COUNT];
+} MeshHeader;
+
+// copies of the entry the chunk holds a reference to, so a moved chunk can stop drawing it
+typedef struct ChunkMesh
+{
+    GPUAllocation voxels[WORLD_MESH_TYPE_COUNT];
+    Section sections[SECTION_COUNT];
+    MeshEntry* entry;
+} ChunkMesh;
+
 typedef struct Chunk
 {
     SDL_AtomicInt block_state;
@@ -58,17 +132,93 @@ typedef struct Chunk
         Sint32 position[2];
     };
     Block blocks[CHUNK_WIDTH][CHUNK_HEIGHT][CHUNK_WIDTH];
+    Uint8 columns[CHUNK_WIDTH][CHUNK_WIDTH];
+    Uint8 height;
+    Uint8 lod;
     Map lights;
-    GPUBuffer gpu_voxels[WORLD_MESH_TYPE_COUNT];
-    GPUBuffer gpu_render_lights;
-    GPUBuffer gpu_update_lights;
+    ChunkMesh render_mesh;
+    ChunkMesh update_mesh;
+    GPUAllocation render_lights;
+    GPUAllocation update_lights;
 } Chunk;
 
+typedef struct ChunkInstance
+{
+    Sint32 x;
+    Sint32 z;
+    Uint32 lights;
+    // must stay zero, it's the baked light of every vertex without baked lights
+    Uint32 padding;
+} ChunkInstance;
+
+// solid box of opaque blocks stacked up from the bottom of the world
+typedef struct Occluder
+{
+    float min[3];
+    float max[3];
+} Occluder;
+
+// consecutive indirect draws that share the same heap pages
+typedef struct DrawBatch
+{
+    Uint32 voxel_page;
+    Uint32 light_page;
+    Uint32 first;
+    Uint32 count;
+} DrawBatch;
+
+typedef struct LightDraw
+{
+    ChunkInstance instance;
+    Uint32 page;
+} LightDraw;
+
+// everything World_Render needs for one frame, so the next frame can be prepared while it renders
+typedef struct DrawList
+{
+    GPUBuffer instances;
+    GPUBuffer draws[WORLD_MESH_TYPE_COUNT][WORLD_MESH_VARIANT_COUNT];
+    DrawBatch batches[WORLD_MESH_TYPE_COUNT][WORLD_MESH_VARIANT_COUNT][WORLD_WIDTH * WORLD_WIDTH];
+    int batch_counts[WORLD_MESH_TYPE_COUNT][WORLD_MESH_VARIANT_COUNT];
+    LightDraw lights[WORLD_WIDTH * WORLD_WIDTH];
+    int light_count;
+    WorldCoverage coverage;
+} DrawList;
+
+// distance from the camera at which chunks are meshed with 2x2x2 and then 4x4x4 cells
+static const float MESH_LOD_DISTANCES[MESH_LODS - 1] = {150.0f, 240.0f};
+
 static SDL_GPUDevice* device;
 static Chunk* chunks[WORLD_WIDTH][WORLD_WIDTH];
 static WorldWorker all_workers[WORKERS];
 static GPUBuffer gpu_indices;
+static GPUHeap gpu_voxels;
+static GPUHeap gpu_lights;
+static GPUAllocation empty_lights;
+static CPUBuffer cpu_instances;
+static CPUBuffer cpu_draws[WORLD_MESH_TYPE_COUNT][WORLD_MESH_VARIANT_COUNT];
+static DrawList draw_lists[WORLD_FRAMES];
+static Worker occlusion_worker;
+static Occlusion occlusions[2];
+static Occlusion* front_occlusion = &occlusions[0];
+static Occlusion* back_occlusion = &occlusions[1];
+static Camera occlusion_camera;
+static Occluder occluders[WORLD_WIDTH * WORLD_WIDTH * OCCLUDER_CELLS * OCCLUDER_CELLS];
+static int occluder_count;
+static bool has_occlusion;
+static WorldCulling culling;
+static MeshEntry* mesh_buckets[MESH_BUCKETS];
+static SDL_Mutex* mesh_mutex;
+static SDL_AtomicInt generated_meshes;
+static SDL_AtomicInt shared_meshes;
+static SDL_AtomicInt cached_meshes;
+static float section_bounds[6][WORLD_WIDTH * WORLD_WIDTH * SECTION_COUNT];
+static bool section_visible[WORLD_WIDTH * WORLD_WIDTH * SECTION_COUNT];
+static Uint8 section_indices[WORLD_WIDTH * WORLD_WIDTH * SECTION_COUNT];
 static CPUBuffer cpu_voxels[WORLD_MESH_TYPE_COUNT];
+static LightField* cpu_field;
+static WorldLighting lighting;
+static Uint32 voxel_size;
 static int sorted_chunks[WORLD_WIDTH * WORLD_WIDTH][2];
 static int world_x;
 static int world_z;
@@ -146,32 +296,70 @@ static Chunk* CreateChunk()
     SDL_SetAtomicInt(&chunk->voxel_state, TASK_STATE_COMPLETED);
     SDL_SetAtomicInt(&chunk->light_state, TASK_STATE_COMPLETED);
     Map_Init(&chunk->lights, 8);
-    for (int i = 0; i < WORLD_MESH_TYPE_COUNT; i++)
+    return chunk;
+}
+
+static MeshEntry** FindMesh(Uint64 hash)
+{
+    MeshEntry** entry = &mesh_buckets[hash % MESH_BUCKETS];
+    while (*entry && (*entry)->hash != hash)
     {
-        GPUBuffer_Init(&chunk->gpu_voxels[i], device, SDL_GPU_BUFFERUSAGE_VERTEX);
+        entry = &(*entry)->next;
     }
-    GPUBuffer_Init(&chunk->gpu_render_lights, device, SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ);
-    GPUBuffer_Init(&chunk->gpu_update_lights, device, SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ);
-    GPUBuffer_Reserve(&chunk->gpu_render_lights, 1, sizeof(Light));
-    GPUBuffer_Reserve(&chunk->gpu_update_lights, 1, sizeof(Light));
-    return chunk;
+    return entry;
 }
 
-static void FreeChunk(Chunk* chunk)
+static MeshEntry* AcquireMesh(Uint64 hash)
+{
+    SDL_LockMutex(mesh_mutex);
+    MeshEntry* entry = *FindMesh(hash);
+    if (entry)
+    {
+        entry->references++;
+    }
+    SDL_UnlockMutex(mesh_mutex);
+    return entry;
+}
+
+static void ReleaseMesh(MeshEntry* entry)
 {
-    GPUBuffer_Free(&chunk->gpu_render_lights);
-    GPUBuffer_Free(&chunk->gpu_update_lights);
+    if (!entry)
+    {
+        return;
+    }
+    SDL_LockMutex(mesh_mutex);
+    bool is_unused = --entry->references == 0;
+    if (is_unused)
+    {
+        MeshEntry** slot = FindMesh(entry->hash);
+        SDL_assert(*slot == entry);
+        *slot = entry->next;
+    }
+    SDL_UnlockMutex(mesh_mutex);
+    if (!is_unused)
+    {
+        return;
+    }
     for (int i = 0; i < WORLD_MESH_TYPE_COUNT; i++)
     {
-        GPUBuffer_Free(&chunk->gpu_voxels[i]);
+        GPUHeap_Release(&gpu_voxels, &entry->voxels[i]);
     }
+    SDL_free(entry);
+}
+
+static void FreeChunk(Chunk* chunk)
+{
+    GPUHeap_Release(&gpu_lights, &chunk->render_lights);
+    GPUHeap_Release(&gpu_lights, &chunk->update_lights);
+    ReleaseMesh(chunk->render_mesh.entry);
+    ReleaseMesh(chunk->update_mesh.entry);
     Map_Free(&chunk->lights);
     SDL_free(chunk);
 }
 
+// only stores the block, callers decide which chunks need new voxels and lights
 static Block SetChunkBlock(Chunk* chunk, int bx, int by, int bz, Block block)
 {
-    SDL_SetAtomicInt(&chunk->voxel_state, TASK_STATE_REQUESTED);
     WorldBlockToChunkBlock(chunk, &bx, &by, &bz);
     Block old_block = chunk->blocks[bx][by][bz];
     chunk->blocks[bx][by][bz] = block;
@@ -179,7 +367,6 @@ static Block SetChunkBlock(Chunk* chunk, int bx, int by, int bz, Block block)
     {
         return old_block;
     }
-    SDL_SetAtomicInt(&chunk->light_state, TASK_STATE_REQUESTED);
     if (Block_IsLight(block))
     {
         Map_Set(&chunk->lights, bx, by, bz, block);
@@ -254,42 +441,16 @@ static Block GetGroupBlock(Chunk* chunks[3][3], int bx, int by, int bz, int dx,
     return neighbor->blocks[bx][by][bz];
 }
 
-static void UploadVoxels(Chunk* chunk, CPUBuffer voxels[WORLD_MESH_TYPE_COUNT])
-{
-    SDL_assert(SDL_GetAtomicInt(&chunk->block_state) == TASK_STATE_COMPLETED);
-    SDL_assert(SDL_GetAtomicInt(&chunk->voxel_state) == TASK_STATE_RUNNING);
-    bool has_voxels = false;
-    for (int i = 0; i < WORLD_MESH_TYPE_COUNT; i++)
-    {
-        GPUBuffer_Clear(&chunk->gpu_voxels[i]);
-        has_voxels |= voxels[i].size > 0;
-    }
-    if (!has_voxels || !GPUBuffer_BeginUpload(&chunk->gpu_voxels[0]))
-    {
-        return;
-    }
-    for (int i = 0; i < WORLD_MESH_TYPE_COUNT; i++)
-    {
-        GPUBuffer_Upload(&chunk->gpu_voxels[i], &voxels[i]);
-    }
-    GPUBuffer_EndUpload();
-}
-
 static void UploadLights(Chunk* chunk, CPUBuffer* lights)
 {
     SDL_assert(SDL_GetAtomicInt(&chunk->block_state) == TASK_STATE_COMPLETED);
     SDL_assert(SDL_GetAtomicInt(&chunk->light_state) == TASK_STATE_RUNNING);
-    GPUBuffer_Clear(&chunk->gpu_update_lights);
+    chunk->update_lights.size = 0;
     if (!lights->size)
     {
         return;
     }
-    if (!GPUBuffer_BeginUpload(&chunk->gpu_update_lights))
-    {
-        return;
-    }
-    GPUBuffer_Upload(&chunk->gpu_update_lights, lights);
-    GPUBuffer_EndUpload();
+    GPUHeap_Upload(&gpu_lights, &chunk->update_lights, lights);
 }
 
 static bool IsVisible(Block block, Block neighbor)
@@ -348,6 +509,34 @@ static int GetAO(Chunk* chunks[3][3], int bx, int by, int bz, Direction directio
     }
 }
 
+static void UpdateChunkColumn(Chunk* chunk, int bx, int bz)
+{
+    int by = 0;
+    while (by < CHUNK_HEIGHT && Block_IsOpaque(chunk->blocks[bx][by][bz]))
+    {
+        by++;
+    }
+    chunk->columns[bx][bz] = by;
+}
+
+static void UpdateChunkBounds(Chunk* chunk)
+{
+    chunk->height = 0;
+    for (int x = 0; x < CHUNK_WIDTH; x++)
+    for (int z = 0; z < CHUNK_WIDTH; z++)
+    {
+        UpdateChunkColumn(chunk, x, z);
+        for (int y = CHUNK_HEIGHT - 1; y >= chunk->height; y--)
+        {
+            if (chunk->blocks[x][y][z] != BLOCK_EMPTY)
+            {
+                chunk->height = y + 1;
+                break;
+            }
+        }
+    }
+}
+
 static void GenerateChunkBlocks(Chunk* chunk)
 {
     SDL_assert(SDL_GetAtomicInt(&chunk->block_state) == TASK_STATE_RUNNING);
@@ -357,225 +546,995 @@ static void GenerateChunkBlocks(Chunk* chunk)
     Map_Clear(&chunk->lights);
     Rand_GetBlocks(chunk, chunk->x, chunk->z, SetChunkBlockFunction);
     Save_GetBlocks(chunk, chunk->x, chunk->z, SetChunkBlockFunction);
+    UpdateChunkBounds(chunk);
     SDL_assert(SDL_GetAtomicInt(&chunk->block_state) == TASK_STATE_RUNNING);
     SDL_SetAtomicInt(&chunk->block_state, TASK_STATE_COMPLETED);
 }
 
-static void GenerateChunkVoxels(Chunk* chunks[3][3], CPUBuffer voxels[WORLD_MESH_TYPE_COUNT])
+static Block GetFieldBlock(Chunk* chunks[3][3], int bx, int by, int bz)
 {
-    Chunk* chunk = chunks[1][1];
-    SDL_assert(SDL_GetAtomicInt(&chunk->block_state) == TASK_STATE_COMPLETED);
-    SDL_assert(SDL_GetAtomicInt(&chunk->voxel_state) == TASK_STATE_RUNNING);
-    for (int bx = 0; bx < CHUNK_WIDTH; bx++)
-    for (int by = 0; by < CHUNK_HEIGHT; by++)
-    for (int bz = 0; bz < CHUNK_WIDTH; bz++)
+    SDL_assert(by >= 0 && by < CHUNK_HEIGHT);
+    int cx = 1;
+    int cz = 1;
+    if (bx < 0)
+    {
+        cx = 0;
+        bx += CHUNK_WIDTH;
+    }
+    else if (bx >= CHUNK_WIDTH)
+    {
+        cx = 2;
+        bx -= CHUNK_WIDTH;
+    }
+    if (bz < 0)
+    {
+        cz = 0;
+        bz += CHUNK_WIDTH;
+    }
+    else if (bz >= CHUNK_WIDTH)
+    {
+        cz = 2;
+        bz -= CHUNK_WIDTH;
+    }
+    SDL_assert(IsBlockInChunk(bx, by, bz));
+    return chunks[cx][cz]->blocks[bx][by][bz];
+}
+
+static bool IsBlockInField(int bx, int by, int bz)
+{
+    return bx >= -MAX_LIGHT_RADIUS && bz >= -MAX_LIGHT_RADIUS && by >= 0 &&
+        bx < CHUNK_WIDTH + MAX_LIGHT_RADIUS && bz < CHUNK_WIDTH + MAX_LIGHT_RADIUS && by < CHUNK_HEIGHT;
+}
+
+static void FloodLight(Chunk* chunks[3][3], LightField* field, const Light* light)
+{
+    int levels[3];
+    levels[0] = (light->red * light->radius + 127) / 255;
+    levels[1] = (light->green * light->radius + 127) / 255;
+    levels[2] = (light->blue * light->radius + 127) / 255;
+    int max_level = SDL_max(levels[0], SDL_max(levels[1], levels[2]));
+    if (!max_level)
     {
-        Block block = chunk->blocks[bx][by][bz];
-        if (block == BLOCK_EMPTY)
+        return;
+    }
+    SDL_memset(field->distances, 0xFF, sizeof(field->distances));
+    field->distances[MAX_LIGHT_RADIUS][MAX_LIGHT_RADIUS][MAX_LIGHT_RADIUS] = 0;
+    SDL_memset(field->queue[0], 0, sizeof(field->queue[0]));
+    int head = 0;
+    int tail = 1;
+    while (head < tail)
+    {
+        const Sint8* offset = field->queue[head++];
+        int distance = field->distances[offset[0] + MAX_LIGHT_RADIUS][offset[1] + MAX_LIGHT_RADIUS][offset[2] + MAX_LIGHT_RADIUS];
+        int bx = light->x + offset[0];
+        int by = light->y + offset[1];
+        int bz = light->z + offset[2];
+        Uint8* level = field->levels[bx + MAX_LIGHT_RADIUS][by][bz + MAX_LIGHT_RADIUS];
+        for (int i = 0; i < 3; i++)
         {
-            continue;
+            level[i] = SDL_max(level[i], SDL_max(levels[i] - distance, 0));
         }
-        if (Block_IsSprite(block))
+        if (distance + 1 >= max_level)
         {
-            for (Direction direction = 0; direction < 4; direction++)
-            for (int vertex = 0; vertex < 4; vertex++)
-            {
-                Voxel voxel = Voxel_PackSprite(block, bx, by, bz, direction, vertex);
-                CPUBuffer_Append(&voxels[WORLD_MESH_TYPE_OPAQUE], &voxel);
-            }
             continue;
         }
-        WorldMeshType type = Block_IsOpaque(block) ? WORLD_MESH_TYPE_OPAQUE : WORLD_MESH_TYPE_TRANSPARENT;
         for (Direction direction = 0; direction < DIRECTION_COUNT; direction++)
         {
-            int dx = DIRECTIONS[direction][0];
-            int dy = DIRECTIONS[direction][1];
-            int dz = DIRECTIONS[direction][2];
-            Block neighbor = GetGroupBlock(chunks, bx, by, bz, dx, dy, dz);
-            if (!IsVisible(block, neighbor))
+            int x = bx + DIRECTIONS[direction][0];
+            int y = by + DIRECTIONS[direction][1];
+            int z = bz + DIRECTIONS[direction][2];
+            // light that leaves the field is too weak to come back into the chunk
+            if (!IsBlockInField(x, y, z) || Block_IsOpaque(GetFieldBlock(chunks, x, y, z)))
             {
                 continue;
             }
-            int ao[4];
-            for (int i = 0; i < 4; i++)
-            {
-                ao[i] = GetAO(chunks, bx, by, bz, direction, i);
-            }
-            int order[4];
-            Voxel_GetAO(ao, order);
-            for (int i = 0; i < 4; i++)
+            int dx = x - light->x + MAX_LIGHT_RADIUS;
+            int dy = y - light->y + MAX_LIGHT_RADIUS;
+            int dz = z - light->z + MAX_LIGHT_RADIUS;
+            if (field->distances[dx][dy][dz] != 0xFF)
             {
-                int index = order[i];
-                Voxel voxel = Voxel_PackCube(block, bx, by, bz, direction, index, ao[index]);
-                CPUBuffer_Append(&voxels[type], &voxel);
+                continue;
             }
+            field->distances[dx][dy][dz] = distance + 1;
+            field->queue[tail][0] = x - light->x;
+            field->queue[tail][1] = y - light->y;
+            field->queue[tail][2] = z - light->z;
+            tail++;
         }
     }
-    UploadVoxels(chunk, voxels);
-    SDL_SetAtomicInt(&chunk->voxel_state, TASK_STATE_COMPLETED);
 }
 
-static void GenerateChunkLights(Chunk* chunks[3][3], CPUBuffer* lights)
+static void GenerateLightField(Chunk* chunks[3][3], LightField* field)
 {
-    Chunk* chunk = chunks[1][1];
-    SDL_assert(SDL_GetAtomicInt(&chunk->block_state) == TASK_STATE_COMPLETED);
-    SDL_assert(SDL_GetAtomicInt(&chunk->light_state) == TASK_STATE_RUNNING);
+    if (field->is_dirty)
+    {
+        SDL_memset(field->levels, 0, sizeof(field->levels));
+        field->is_dirty = false;
+    }
     for (int x = 0; x < 3; x++)
     for (int z = 0; z < 3; z++)
     {
         const Chunk* neighbor = chunks[x][z];
         SDL_assert(neighbor);
-        for (Uint32 i = 0; i < neighbor->lights.capacity; i++)
+        for (Uint32 i = 0; i < neighbor->lights.size; i++)
         {
-            if (!Map_IsRowValid(&neighbor->lights, i))
+            MapRow row = Map_GetRow(&neighbor->lights, i);
+            Light light = Block_GetLight(row.value);
+            SDL_assert(light.radius <= MAX_LIGHT_RADIUS);
+            light.x = row.x + (x - 1) * CHUNK_WIDTH;
+            light.y = row.y;
+            light.z = row.z + (z - 1) * CHUNK_WIDTH;
+            if (!IsBlockInField(light.x, light.y, light.z))
             {
                 continue;
             }
-            MapRow row = Map_GetRow(&neighbor->lights, i);
-            Block block = row.value;
-            SDL_assert(Block_IsLight(block));
-            Light light = Block_GetLight(block);
-            light.x = neighbor->x + row.x;
-            light.y = row.y;
-            light.z = neighbor->z + row.z;
-            CPUBuffer_Append(lights, &light);
+            FloodLight(chunks, field, &light);
+            field->is_dirty = true;
         }
     }
-    UploadLights(chunk, lights);
-    SDL_SetAtomicInt(&chunk->light_state, TASK_STATE_PUBLISHED);
 }
 
-static void GenerateIndexBuffer()
+static void GetVertexLight(Chunk* chunks[3][3], const LightField* field, int bx, int by, int bz, Direction direction, int vertex, Uint8 light[3])
 {
-    CPUBuffer indices;
-    CPUBuffer_Init(&indices, device, sizeof(Uint32));
-    if (!GPUBuffer_BeginUpload(&gpu_indices))
+    int position[3];
+    Voxel_GetPosition(direction, vertex, position);
+    int offsets[4][3];
+    for (int i = 0; i < 4; i++)
     {
-        CPUBuffer_Free(&indices);
-        return;
+        SDL_memcpy(offsets[i], DIRECTIONS[direction], sizeof(offsets[i]));
     }
-    static const int INDICES[] = {0, 1, 2, 3, 2, 1};
-    Uint32 max_indices = CHUNK_WIDTH * CHUNK_HEIGHT * CHUNK_WIDTH * DIRECTION_COUNT * 6;
-    for (Uint32 i = 0; i < max_indices / 6; i++)
-    for (Uint32 j = 0; j < 6; j++)
+    int sides = 0;
+    for (int i = 0; i < 3; i++)
     {
-        Uint32 index = i * 4 + INDICES[j];
-        CPUBuffer_Append(&indices, &index);
+        if (DIRECTIONS[direction][i])
+        {
+            continue;
+        }
+        int offset = position[i] ? 1 : -1;
+        offsets[sides + 1][i] = offset;
+        offsets[3][i] = offset;
+        sides++;
+    }
+    SDL_assert(sides == 2);
+    int levels[3] = {0};
+    int count = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        int x = bx + offsets[i][0];
+        int y = by + offsets[i][1];
+        int z = bz + offsets[i][2];
+        if (y < 0 || y >= CHUNK_HEIGHT || (i && Block_IsOpaque(GetFieldBlock(chunks, x, y, z))))
+        {
+            continue;
+        }
+        const Uint8* level = field->levels[x + MAX_LIGHT_RADIUS][y][z + MAX_LIGHT_RADIUS];
+        for (int j = 0; j < 3; j++)
+        {
+            levels[j] += level[j];
+        }
+        count++;
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        light[i] = count ? levels[i] * 255 / (count * MAX_LIGHT_RADIUS) : 0;
     }
-    GPUBuffer_Upload(&gpu_indices, &indices);
-    GPUBuffer_EndUpload();
-    CPUBuffer_Free(&indices);
 }
 
-static void TaskFunction(void* args)
+static void GenerateBlockVoxels(Chunk* chunks[3][3], CPUBuffer voxels[WORLD_MESH_TYPE_COUNT], const LightField* field, bool is_baked, int bx, int by, int bz, int group)
 {
-    WorldWorker* worker = args;
-    Task task = worker->task;
-    Chunk* chunk = GetChunk(task.x, task.z);
-    SDL_assert(chunk);
-    if (task.type == TASK_TYPE_BLOCKS)
+    Chunk* chunk = chunks[1][1];
+    Block block = chunk->blocks[bx][by][bz];
+    if (block == BLOCK_EMPTY || Block_IsSprite(block) != (group == FACE_GROUP_SPRITE))
     {
-        GenerateChunkBlocks(chunk);
         return;
     }
-    Chunk* chunks[3][3];
-    GetGroup(task.x, task.z, chunks);
-    if (task.type == TASK_TYPE_VOXELS)
+    if (Block_IsSprite(block))
     {
-        GenerateChunkVoxels(chunks, worker->voxels);
+        for (Direction direction = 0; direction < 4; direction++)
+        for (int vertex = 0; vertex < 4; vertex++)
+        {
+            BakedVoxel voxel = {0};
+            voxel.voxel = Voxel_PackSprite(block, bx, by, bz, direction, vertex);
+            if (is_baked)
+            {
+                const Uint8* level = field->levels[bx + MAX_LIGHT_RADIUS][by][bz + MAX_LIGHT_RADIUS];
+                Uint8 light[3];
+                for (int i = 0; i < 3; i++)
+                {
+                    light[i] = level[i] * 255 / MAX_LIGHT_RADIUS;
+                }
+                voxel.light = Voxel_PackLight(light);
+            }
+            CPUBuffer_Append(&voxels[WORLD_MESH_TYPE_OPAQUE], &voxel);
+        }
+        return;
     }
-    else if (task.type == TASK_TYPE_LIGHTS)
+    WorldMeshType type = Block_IsOpaque(block) ? WORLD_MESH_TYPE_OPAQUE : WORLD_MESH_TYPE_TRANSPARENT;
+    Direction direction = group;
+    if (block == BLOCK_WATER && direction == DIRECTION_UP && !is_baked)
     {
-        GenerateChunkLights(chunks, &worker->lights);
+        // merged by GenerateWaterVoxels
+        return;
     }
-    else
+    int dx = DIRECTIONS[direction][0];
+    int dy = DIRECTIONS[direction][1];
+    int dz = DIRECTIONS[direction][2];
+    Block neighbor = GetGroupBlock(chunks, bx, by, bz, dx, dy, dz);
+    if (!IsVisible(block, neighbor))
     {
-        SDL_assert(false);
+        return;
+    }
+    int ao[4];
+    for (int i = 0; i < 4; i++)
+    {
+        ao[i] = GetAO(chunks, bx, by, bz, direction, i);
+    }
+    int order[4];
+    Voxel_GetAO(ao, order);
+    for (int i = 0; i < 4; i++)
+    {
+        int index = order[i];
+        BakedVoxel voxel = {0};
+        voxel.voxel = Voxel_PackCube(block, bx, by, bz, direction, index, ao[index]);
+        if (is_baked)
+        {
+            Uint8 light[3];
+            GetVertexLight(chunks, field, bx, by, bz, direction, index, light);
+            voxel.light = Voxel_PackLight(light);
+        }
+        CPUBuffer_Append(&voxels[type], &voxel);
     }
 }
 
-static bool TryDispatchTask(int x, int z, WorldWorker* worker)
+static bool IsWaterSurface(Chunk* chunks[3][3], int bx, int by, int bz)
 {
-    SDL_assert(IsChunkInWorld(x, z));
-    SDL_assert(!Worker_IsBusy(&worker->worker));
-    Chunk* chunk = chunks[x][z];
-    worker->task.x = x;
-    worker->task.z = z;
-    if (SDL_GetAtomicInt(&chunk->block_state) == TASK_STATE_REQUESTED)
+    if (chunks[1][1]->blocks[bx][by][bz] != BLOCK_WATER)
     {
-        worker->task.type = TASK_TYPE_BLOCKS;
-        SDL_SetAtomicInt(&chunk->block_state, TASK_STATE_RUNNING);
+        return false;
     }
-    else
+    return IsVisible(BLOCK_WATER, GetGroupBlock(chunks, bx, by, bz, 0, 1, 0));
+}
+
+// greedily merges the exposed water tops of a section into rectangles, since
+// open water is otherwise one transparent quad per column
+static void GenerateWaterVoxels(Chunk* chunks[3][3], CPUBuffer voxels[WORLD_MESH_TYPE_COUNT], int section, Uint8 min[3], Uint8 max[3])
+{
+    for (int by = section * SECTION_HEIGHT; by < (section + 1) * SECTION_HEIGHT; by++)
     {
-        if (IsChunkOnWorldBorder(x, z))
+        bool surface[CHUNK_WIDTH][CHUNK_WIDTH];
+        bool has_surface = false;
+        for (int bx = 0; bx < CHUNK_WIDTH; bx++)
+        for (int bz = 0; bz < CHUNK_WIDTH; bz++)
         {
-            return false;
+            surface[bx][bz] = IsWaterSurface(chunks, bx, by, bz);
+            has_surface |= surface[bx][bz];
         }
-        bool voxels = SDL_GetAtomicInt(&chunk->voxel_state) == TASK_STATE_REQUESTED;
-        bool lights = SDL_GetAtomicInt(&chunk->light_state) == TASK_STATE_REQUESTED;
-        if (!voxels && !lights)
+        if (!has_surface)
         {
-            return false;
+            continue;
         }
-        Chunk* group[3][3];
-        GetGroup(x, z, group);
-        for (int i = 0; i < 3; i++)
-        for (int j = 0; j < 3; j++)
+        for (int bx = 0; bx < CHUNK_WIDTH; bx++)
+        for (int bz = 0; bz < CHUNK_WIDTH; bz++)
         {
-            if (SDL_GetAtomicInt(&group[i][j]->block_state) != TASK_STATE_COMPLETED)
+            if (!surface[bx][bz])
             {
-                return false;
+                continue;
+            }
+            int depth = 1;
+            while (bz + depth < CHUNK_WIDTH && surface[bx][bz + depth])
+            {
+                depth++;
+            }
+            int width = 1;
+            for (; bx + width < CHUNK_WIDTH; width++)
+            {
+                bool is_full = true;
+                for (int z = bz; z < bz + depth && is_full; z++)
+                {
+                    is_full = surface[bx + width][z];
+                }
+                if (!is_full)
+                {
+                    break;
+                }
+            }
+            for (int x = bx; x < bx + width; x++)
+            for (int z = bz; z < bz + depth; z++)
+            {
+                surface[x][z] = false;
+            }
+            for (int i = 0; i < 4; i++)
+            {
+                BakedVoxel voxel = {0};
+                voxel.voxel = Voxel_PackSurface(BLOCK_WATER, bx, by, bz, width, depth, i);
+                CPUBuffer_Append(&voxels[WORLD_MESH_TYPE_TRANSPARENT], &voxel);
+            }
+            const int quad_min[3] = {bx, by, bz};
+            const int quad_max[3] = {bx + width, by + 1, bz + depth};
+            for (int j = 0; j < 3; j++)
+            {
+                min[j] = SDL_min(min[j], quad_min[j]);
+                max[j] = SDL_max(max[j], quad_max[j]);
             }
-        }
-        if (voxels)
-        {
-            worker->task.type = TASK_TYPE_VOXELS;
-            SDL_SetAtomicInt(&chunk->voxel_state, TASK_STATE_RUNNING);
-        }
-        else
-        {
-            worker->task.type = TASK_TYPE_LIGHTS;
-            SDL_SetAtomicInt(&chunk->light_state, TASK_STATE_RUNNING);
         }
     }
-    Worker_Dispatch(&worker->worker, TaskFunction, worker);
-    return true;
 }
 
-static int GetWorkers(WorldWorker* workers[WORKERS])
+// cell c of a chunk covers [start, end) blocks along x or z, with the last cell clipped to the
+// chunk and cells -1 and count taken from the neighbors so their faces line up across chunks
+static void GetCellRange(int cell, int scale, int* start, int* end)
 {
-    int count = 0;
-    for (int i = 0; i < WORKERS; i++)
+    int count = (CHUNK_WIDTH + scale - 1) / scale;
+    if (cell < 0)
     {
-        if (!Worker_IsBusy(&all_workers[i].worker))
-        {
-            workers[count++] = &all_workers[i];
-        }
+        *start = (count - 1) * scale - CHUNK_WIDTH;
+        *end = 0;
+    }
+    else if (cell >= count)
+    {
+        *start = CHUNK_WIDTH;
+        *end = CHUNK_WIDTH + scale;
+    }
+    else
+    {
+        *start = cell * scale;
+        *end = SDL_min(*start + scale, CHUNK_WIDTH);
+    }
+}
+
+// the most common block of a cell, where blocks open to the sky count once per layer of the
+// cell so thin surfaces like grass keep their look. mostly empty cells stay empty, and cells
+// of a neighbor only hide faces when full since the neighbor may be meshed at another level
+static Block GetCellBlock(Chunk* chunks[3][3], int cx, int cy, int cz, int scale)
+{
+    int count = (CHUNK_WIDTH + scale - 1) / scale;
+    bool is_neighbor = cx < 0 || cz < 0 || cx >= count || cz >= count;
+    int x1, x2, z1, z2;
+    GetCellRange(cx, scale, &x1, &x2);
+    GetCellRange(cz, scale, &z1, &z2);
+    int counts[BLOCK_COUNT] = {0};
+    int filled = 0;
+    int total = 0;
+    for (int bx = x1; bx < x2; bx++)
+    for (int by = cy * scale; by < (cy + 1) * scale; by++)
+    for (int bz = z1; bz < z2; bz++)
+    {
+        Block block = GetGroupBlock(chunks, bx, by, bz, 0, 0, 0);
+        total++;
+        if (block == BLOCK_EMPTY || Block_IsSprite(block))
+        {
+            continue;
+        }
+        Block above = GetGroupBlock(chunks, bx, by, bz, 0, 1, 0);
+        bool is_surface = above == BLOCK_EMPTY || Block_IsSprite(above);
+        counts[block] += is_surface ? scale : 1;
+        filled++;
+    }
+    if (is_neighbor ? filled < total : filled * 2 < total)
+    {
+        return BLOCK_EMPTY;
+    }
+    Block dominant = BLOCK_EMPTY;
+    for (Block block = BLOCK_EMPTY + 1; block < BLOCK_COUNT; block++)
+    {
+        if (counts[block] > counts[dominant])
+        {
+            dominant = block;
+        }
+    }
+    return dominant;
+}
+
+static void GenerateCells(Chunk* chunks[3][3], Block cells[MESH_LOD_CELLS][CHUNK_HEIGHT / 2][MESH_LOD_CELLS], int scale)
+{
+    int count = (CHUNK_WIDTH + scale - 1) / scale;
+    for (int cx = -1; cx <= count; cx++)
+    for (int cy = 0; cy < CHUNK_HEIGHT / scale; cy++)
+    for (int cz = -1; cz <= count; cz++)
+    {
+        if ((cx < 0 || cx >= count) && (cz < 0 || cz >= count))
+        {
+            continue;
+        }
+        cells[cx + 1][cy][cz + 1] = GetCellBlock(chunks, cx, cy, cz, scale);
+    }
+}
+
+static Block GetCell(Block cells[MESH_LOD_CELLS][CHUNK_HEIGHT / 2][MESH_LOD_CELLS], int cx, int cy, int cz, int scale)
+{
+    // matches GetGroupBlock above and below the world
+    if (cy < 0)
+    {
+        return BLOCK_GRASS;
+    }
+    else if (cy >= CHUNK_HEIGHT / scale)
+    {
+        return BLOCK_EMPTY;
+    }
+    return cells[cx + 1][cy][cz + 1];
+}
+
+// one face per exposed cell, without ambient occlusion since a cell covers a few pixels at most
+static void GenerateCellVoxels(Block cells[MESH_LOD_CELLS][CHUNK_HEIGHT / 2][MESH_LOD_CELLS], CPUBuffer voxels[WORLD_MESH_TYPE_COUNT], const LightField* field, bool is_baked, int scale, int section, int group, Uint8 min[3], Uint8 max[3])
+{
+    if (group == FACE_GROUP_SPRITE)
+    {
+        return;
+    }
+    SDL_COMPILE_TIME_ASSERT("", SECTION_HEIGHT % 4 == 0);
+    Direction direction = group;
+    int dx = DIRECTIONS[direction][0];
+    int dy = DIRECTIONS[direction][1];
+    int dz = DIRECTIONS[direction][2];
+    int count = (CHUNK_WIDTH + scale - 1) / scale;
+    for (int cx = 0; cx < count; cx++)
+    for (int cy = section * SECTION_HEIGHT / scale; cy < (section + 1) * SECTION_HEIGHT / scale; cy++)
+    for (int cz = 0; cz < count; cz++)
+    {
+        Block block = cells[cx + 1][cy][cz + 1];
+        if (block == BLOCK_EMPTY || !IsVisible(block, GetCell(cells, cx + dx, cy + dy, cz + dz, scale)))
+        {
+            continue;
+        }
+        int position[3];
+        int end[3];
+        GetCellRange(cx, scale, &position[0], &end[0]);
+        GetCellRange(cz, scale, &position[2], &end[2]);
+        position[1] = cy * scale;
+        end[1] = position[1] + scale;
+        const int size[3] = {end[0] - position[0], end[1] - position[1], end[2] - position[2]};
+        Uint8 light[3] = {0};
+        if (is_baked)
+        {
+            // lit from the block just outside the middle of the face
+            int outside[3];
+            for (int i = 0; i < 3; i++)
+            {
+                outside[i] = DIRECTIONS[direction][i] ? (DIRECTIONS[direction][i] > 0 ? end[i] : position[i] - 1) : position[i] + size[i] / 2;
+            }
+            outside[1] = SDL_clamp(outside[1], 0, CHUNK_HEIGHT - 1);
+            const Uint8* level = field->levels[outside[0] + MAX_LIGHT_RADIUS][outside[1]][outside[2] + MAX_LIGHT_RADIUS];
+            for (int i = 0; i < 3; i++)
+            {
+                light[i] = level[i] * 255 / MAX_LIGHT_RADIUS;
+            }
+        }
+        WorldMeshType type = Block_IsOpaque(block) ? WORLD_MESH_TYPE_OPAQUE : WORLD_MESH_TYPE_TRANSPARENT;
+        for (int i = 0; i < 4; i++)
+        {
+            BakedVoxel voxel = {0};
+            voxel.voxel = Voxel_PackBox(block, position[0], position[1], position[2], size, direction, i);
+            if (is_baked)
+            {
+                voxel.light = Voxel_PackLight(light);
+            }
+            CPUBuffer_Append(&voxels[type], &voxel);
+        }
+        for (int i = 0; i < 3; i++)
+        {
+            min[i] = SDL_min(min[i], position[i]);
+            max[i] = SDL_max(max[i], end[i]);
+        }
+    }
+}
+
+static Uint32 GetVoxelCount(const CPUBuffer voxels[WORLD_MESH_TYPE_COUNT])
+{
+    Uint32 count = 0;
+    for (int i = 0; i < WORLD_MESH_TYPE_COUNT; i++)
+    {
+        count += voxels[i].size;
+    }
+    return count;
+}
+
+static void MeshChunk(Chunk* chunks[3][3], CPUBuffer voxels[WORLD_MESH_TYPE_COUNT], LightField* field, Section sections[SECTION_COUNT])
+{
+    Chunk* chunk = chunks[1][1];
+    bool is_baked = lighting == WORLD_LIGHTING_BAKED;
+    if (is_baked)
+    {
+        GenerateLightField(chunks, field);
+        is_baked = field->is_dirty;
+    }
+    SDL_COMPILE_TIME_ASSERT("", CHUNK_HEIGHT % SECTION_HEIGHT == 0);
+    Uint8 min[SECTION_COUNT][3];
+    Uint8 max[SECTION_COUNT][3] = {0};
+    for (int i = 0; i < SECTION_COUNT; i++)
+    {
+        min[i][0] = CHUNK_WIDTH;
+        min[i][1] = CHUNK_HEIGHT;
+        min[i][2] = CHUNK_WIDTH;
+    }
+    int scale = 1 << chunk->lod;
+    Block cells[MESH_LOD_CELLS][CHUNK_HEIGHT / 2][MESH_LOD_CELLS];
+    if (chunk->lod)
+    {
+        GenerateCells(chunks, cells, scale);
+    }
+    for (int group = 0; group < FACE_GROUP_COUNT; group++)
+    for (int i = 0; i < SECTION_COUNT; i++)
+    {
+        Section* section = &sections[i];
+        for (int type = 0; type < WORLD_MESH_TYPE_COUNT; type++)
+        {
+            section->offsets[type][group] = voxels[type].size;
+        }
+        if (chunk->lod)
+        {
+            GenerateCellVoxels(cells, voxels, field, is_baked, scale, i, group, min[i], max[i]);
+            for (int type = 0; type < WORLD_MESH_TYPE_COUNT; type++)
+            {
+                section->sizes[type][group] = voxels[type].size - section->offsets[type][group];
+            }
+            continue;
+        }
+        for (int bx = 0; bx < CHUNK_WIDTH; bx++)
+        for (int by = i * SECTION_HEIGHT; by < (i + 1) * SECTION_HEIGHT; by++)
+        for (int bz = 0; bz < CHUNK_WIDTH; bz++)
+        {
+            Uint32 count = GetVoxelCount(voxels);
+            GenerateBlockVoxels(chunks, voxels, field, is_baked, bx, by, bz, group);
+            if (count == GetVoxelCount(voxels))
+            {
+                continue;
+            }
+            int position[3] = {bx, by, bz};
+            for (int j = 0; j < 3; j++)
+            {
+                min[i][j] = SDL_min(min[i][j], position[j]);
+                max[i][j] = SDL_max(max[i][j], position[j] + 1);
+            }
+        }
+        if (group == DIRECTION_UP && !is_baked)
+        {
+            GenerateWaterVoxels(chunks, voxels, i, min[i], max[i]);
+        }
+        for (int type = 0; type < WORLD_MESH_TYPE_COUNT; type++)
+        {
+            section->sizes[type][group] = voxels[type].size - section->offsets[type][group];
+        }
+    }
+    for (int i = 0; i < SECTION_COUNT; i++)
+    for (int j = 0; j < 3; j++)
+    {
+        sections[i].min[j] = SDL_min(min[i][j], max[i][j]);
+        sections[i].max[j] = max[i][j];
+    }
+}
+
+static Uint64 HashBytes(Uint64 hash, const Uint8* data, int size)
+{
+    for (int i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+// covers everything the mesher reads: a block of padding for faces and ambient occlusion,
+// a cell for downsampled meshes and the whole group when light is baked into the voxels
+static Uint64 HashNeighborhood(Chunk* chunks[3][3], int lod)
+{
+    int pad = lighting == WORLD_LIGHTING_BAKED ? CHUNK_WIDTH : 1 << lod;
+    const Uint8 key[3] = {MESH_CACHE_VERSION, lighting, lod};
+    Uint64 hash = HashBytes(0xCBF29CE484222325ull, key, sizeof(key));
+    for (int bx = -pad; bx < CHUNK_WIDTH + pad; bx++)
+    {
+        int cx = bx < 0 ? 0 : bx >= CHUNK_WIDTH ? 2 : 1;
+        int x = bx - (cx - 1) * CHUNK_WIDTH;
+        for (int by = 0; by < CHUNK_HEIGHT; by++)
+        {
+            hash = HashBytes(hash, &chunks[cx][0]->blocks[x][by][CHUNK_WIDTH - pad], pad);
+            hash = HashBytes(hash, chunks[cx][1]->blocks[x][by], CHUNK_WIDTH);
+            hash = HashBytes(hash, chunks[cx][2]->blocks[x][by], pad);
+        }
+    }
+    return hash;
+}
+
+static void SaveMesh(Uint64 hash, const CPUBuffer voxels[WORLD_MESH_TYPE_COUNT], const Section sections[SECTION_COUNT])
+{
+    int size = sizeof(MeshHeader) + GetVoxelCount(voxels) * voxel_size;
+    Uint8* data = SDL_malloc(size);
+    if (!data)
+    {
+        SDL_Log("Failed to allocate cached mesh");
+        return;
+    }
+    MeshHeader* header = (MeshHeader*) data;
+    SDL_memcpy(header->sections, sections, sizeof(header->sections));
+    int offset = sizeof(MeshHeader);
+    for (int i = 0; i < WORLD_MESH_TYPE_COUNT; i++)
+    {
+        header->sizes[i] = voxels[i].size;
+        if (voxels[i].size)
+        {
+            SDL_memcpy(data + offset, voxels[i].data, voxels[i].size * voxel_size);
+        }
+        offset += voxels[i].size * voxel_size;
+    }
+    Cache_Set(hash, data, size);
+    SDL_free(data);
+}
+
+static bool LoadMesh(Uint64 hash, CPUBuffer voxels[WORLD_MESH_TYPE_COUNT], Section sections[SECTION_COUNT])
+{
+    int size;
+    Uint8* data = Cache_Get(hash, &size);
+    if (!data)
+    {
+        return false;
+    }
+    MeshHeader header;
+    Uint64 expected = sizeof(MeshHeader);
+    if (size >= (int) sizeof(MeshHeader))
+    {
+        SDL_memcpy(&header, data, sizeof(MeshHeader));
+        for (int i = 0; i < WORLD_MESH_TYPE_COUNT; i++)
+        {
+            expected += (Uint64) header.sizes[i] * voxel_size;
+        }
+    }
+    if (size < (int) sizeof(MeshHeader) || expected != (Uint64) size)
+    {
+        SDL_Log("Failed to load cached mesh: unexpected size %d", size);
+        SDL_free(data);
+        return false;
+    }
+    SDL_memcpy(sections, header.sections, sizeof(header.sections));
+    int offset = sizeof(MeshHeader);
+    for (int i = 0; i < WORLD_MESH_TYPE_COUNT; i++)
+    for (Uint32 j = 0; j < header.sizes[i]; j++)
+    {
+        BakedVoxel voxel;
+        SDL_memcpy(&voxel, data + offset, voxel_size);
+        CPUBuffer_Append(&voxels[i], &voxel);
+        offset += voxel_size;
+    }
+    SDL_free(data);
+    return true;
+}
+
+static MeshEntry* CreateMesh(Uint64 hash, CPUBuffer voxels[WORLD_MESH_TYPE_COUNT], const Section sections[SECTION_COUNT])
+{
+    MeshEntry* entry = SDL_calloc(1, sizeof(MeshEntry));
+    if (!entry || !GetVoxelCount(voxels))
+    {
+        if (!entry)
+        {
+            SDL_Log("Failed to allocate mesh");
+        }
+        for (int i = 0; i < WORLD_MESH_TYPE_COUNT; i++)
+        {
+            voxels[i].size = 0;
+        }
+        SDL_free(entry);
+        return NULL;
+    }
+    entry->hash = hash;
+    entry->references = 1;
+    SDL_memcpy(entry->sections, sections, sizeof(entry->sections));
+    for (int i = 0; i < WORLD_MESH_TYPE_COUNT; i++)
+    {
+        GPUHeap_Upload(&gpu_voxels, &entry->voxels[i], &voxels[i]);
+    }
+    // another worker may have built the same mesh in the meantime
+    SDL_LockMutex(mesh_mutex);
+    MeshEntry** slot = FindMesh(hash);
+    MeshEntry* other = *slot;
+    if (other)
+    {
+        other->references++;
+    }
+    else
+    {
+        *slot = entry;
+    }
+    SDL_UnlockMutex(mesh_mutex);
+    if (!other)
+    {
+        return entry;
+    }
+    for (int i = 0; i < WORLD_MESH_TYPE_COUNT; i++)
+    {
+        GPUHeap_Release(&gpu_voxels, &entry->voxels[i]);
+    }
+    SDL_free(entry);
+    return other;
+}
+
+static void GenerateChunkVoxels(Chunk* chunks[3][3], CPUBuffer voxels[WORLD_MESH_TYPE_COUNT], LightField* field)
+{
+    Chunk* chunk = chunks[1][1];
+    SDL_assert(SDL_GetAtomicInt(&chunk->block_state) == TASK_STATE_COMPLETED);
+    SDL_assert(SDL_GetAtomicInt(&chunk->voxel_state) == TASK_STATE_RUNNING);
+    Uint64 hash = HashNeighborhood(chunks, chunk->lod);
+    MeshEntry* entry = AcquireMesh(hash);
+    if (entry)
+    {
+        SDL_AddAtomicInt(&shared_meshes, 1);
+    }
+    else
+    {
+        Section sections[SECTION_COUNT];
+        if (LoadMesh(hash, voxels, sections))
+        {
+            SDL_AddAtomicInt(&cached_meshes, 1);
+        }
+        else
+        {
+            MeshChunk(chunks, voxels, field, sections);
+            SaveMesh(hash, voxels, sections);
+            SDL_AddAtomicInt(&generated_meshes, 1);
+        }
+        entry = CreateMesh(hash, voxels, sections);
+    }
+    // the update mesh stopped being drawn when it was last swapped out in PublishVoxels
+    ReleaseMesh(chunk->update_mesh.entry);
+    chunk->update_mesh.entry = entry;
+    if (entry)
+    {
+        SDL_memcpy(chunk->update_mesh.voxels, entry->voxels, sizeof(entry->voxels));
+        SDL_memcpy(chunk->update_mesh.sections, entry->sections, sizeof(entry->sections));
+    }
+    else
+    {
+        SDL_zeroa(chunk->update_mesh.voxels);
+        SDL_zeroa(chunk->update_mesh.sections);
+    }
+    SDL_SetAtomicInt(&chunk->voxel_state, TASK_STATE_PUBLISHED);
+}
+
+static void GetNearbyLights(Chunk* chunks[3][3], LightList* nearby)
+{
+    const Chunk* chunk = chunks[1][1];
+    nearby->size = 0;
+    for (int i = 0; i < 3; i++)
+    for (int j = 0; j < 3; j++)
+    {
+        const Chunk* neighbor = chunks[i][j];
+        SDL_assert(neighbor);
+        for (Uint32 k = 0; k < neighbor->lights.size; k++)
+        {
+            MapRow row = Map_GetRow(&neighbor->lights, k);
+            Block block = row.value;
+            SDL_assert(Block_IsLight(block));
+            Light light = Block_GetLight(block);
+            light.x = neighbor->x + row.x;
+            light.y = row.y;
+            light.z = neighbor->z + row.z;
+            if (!Light_IsInChunk(&light, chunk->x, chunk->z))
+            {
+                continue;
+            }
+            if (nearby->size == nearby->capacity)
+            {
+                int capacity = SDL_max(16, nearby->capacity * 2);
+                Light* data = SDL_realloc(nearby->data, capacity * sizeof(Light));
+                if (!data)
+                {
+                    SDL_Log("Failed to allocate nearby lights");
+                    return;
+                }
+                nearby->data = data;
+                nearby->capacity = capacity;
+            }
+            nearby->data[nearby->size++] = light;
+        }
+    }
+}
+
+static void AddLightFunction(void* userdata, const Light* light)
+{
+    CPUBuffer_Append(userdata, light);
+}
+
+static void GenerateChunkLights(Chunk* chunks[3][3], CPUBuffer* lights, LightList* nearby)
+{
+    Chunk* chunk = chunks[1][1];
+    SDL_assert(SDL_GetAtomicInt(&chunk->block_state) == TASK_STATE_COMPLETED);
+    SDL_assert(SDL_GetAtomicInt(&chunk->light_state) == TASK_STATE_RUNNING);
+    nearby->size = 0;
+    if (lighting == WORLD_LIGHTING_DYNAMIC)
+    {
+        GetNearbyLights(chunks, nearby);
+    }
+    Light_GenerateGrid(lights, nearby->data, nearby->size, chunk->x, chunk->z, AddLightFunction);
+    UploadLights(chunk, lights);
+    SDL_SetAtomicInt(&chunk->light_state, TASK_STATE_PUBLISHED);
+}
+
+static void GenerateIndexBuffer()
+{
+    CPUBuffer indices;
+    CPUBuffer_Init(&indices, sizeof(Uint32));
+    static const int INDICES[] = {0, 1, 2, 3, 2, 1};
+    Uint32 max_indices = CHUNK_WIDTH * CHUNK_HEIGHT * CHUNK_WIDTH * DIRECTION_COUNT * 6;
+    for (Uint32 i = 0; i < max_indices / 6; i++)
+    for (Uint32 j = 0; j < 6; j++)
+    {
+        Uint32 index = i * 4 + INDICES[j];
+        CPUBuffer_Append(&indices, &index);
+    }
+    GPUBuffer_Upload(&gpu_indices, &indices);
+    CPUBuffer_Free(&indices);
+}
+
+static void GenerateEmptyLights()
+{
+    CPUBuffer lights;
+    CPUBuffer_Init(&lights, sizeof(Light));
+    Light header = {0};
+    for (int i = 0; i < LIGHT_GRID_SIZE; i++)
+    {
+        CPUBuffer_Append(&lights, &header);
+    }
+    GPUHeap_Upload(&gpu_lights, &empty_lights, &lights);
+    CPUBuffer_Free(&lights);
+}
+
+static void TaskFunction(void* args)
+{
+    WorldWorker* worker = args;
+    Task task = worker->task;
+    Chunk* chunk = GetChunk(task.x, task.z);
+    SDL_assert(chunk);
+    if (task.type == TASK_TYPE_BLOCKS)
+    {
+        GenerateChunkBlocks(chunk);
+        return;
+    }
+    Chunk* chunks[3][3];
+    GetGroup(task.x, task.z, chunks);
+    if (task.type == TASK_TYPE_VOXELS)
+    {
+        GenerateChunkVoxels(chunks, worker->voxels, worker->field);
+    }
+    else if (task.type == TASK_TYPE_LIGHTS)
+    {
+        GenerateChunkLights(chunks, &worker->lights, &worker->nearby_lights);
+    }
+    else
+    {
+        SDL_assert(false);
+    }
+}
+
+static bool TryDispatchTask(int x, int z, WorldWorker* worker)
+{
+    SDL_assert(IsChunkInWorld(x, z));
+    SDL_assert(!Worker_IsBusy(&worker->worker));
+    Chunk* chunk = chunks[x][z];
+    worker->task.x = x;
+    worker->task.z = z;
+    if (SDL_GetAtomicInt(&chunk->block_state) == TASK_STATE_REQUESTED)
+    {
+        worker->task.type = TASK_TYPE_BLOCKS;
+        SDL_SetAtomicInt(&chunk->block_state, TASK_STATE_RUNNING);
+    }
+    else
+    {
+        if (IsChunkOnWorldBorder(x, z))
+        {
+            return false;
+        }
+        bool voxels = SDL_GetAtomicInt(&chunk->voxel_state) == TASK_STATE_REQUESTED;
+        bool lights = SDL_GetAtomicInt(&chunk->light_state) == TASK_STATE_REQUESTED;
+        if (!voxels && !lights)
+        {
+            return false;
+        }
+        Chunk* group[3][3];
+        GetGroup(x, z, group);
+        for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+        {
+            if (SDL_GetAtomicInt(&group[i][j]->block_state) != TASK_STATE_COMPLETED)
+            {
+                return false;
+            }
+        }
+        if (voxels)
+        {
+            worker->task.type = TASK_TYPE_VOXELS;
+            SDL_SetAtomicInt(&chunk->voxel_state, TASK_STATE_RUNNING);
+        }
+        else
+        {
+            worker->task.type = TASK_TYPE_LIGHTS;
+            SDL_SetAtomicInt(&chunk->light_state, TASK_STATE_RUNNING);
+        }
+    }
+    Worker_Dispatch(&worker->worker, TaskFunction, worker);
+    return true;
+}
+
+static int GetWorkers(WorldWorker* workers[WORKERS])
+{
+    int count = 0;
+    for (int i = 0; i < WORKERS; i++)
+    {
+        if (!Worker_IsBusy(&all_workers[i].worker))
+        {
+            workers[count++] = &all_workers[i];
+        }
     }
     return count;
 }
 
-void World_Init(SDL_GPUDevice* in_device)
+static LightField* CreateLightField()
+{
+    if (lighting != WORLD_LIGHTING_BAKED)
+    {
+        return NULL;
+    }
+    LightField* field = SDL_calloc(1, sizeof(LightField));
+    if (!field)
+    {
+        SDL_Log("Failed to allocate light field");
+        lighting = WORLD_LIGHTING_DYNAMIC;
+    }
+    return field;
+}
+
+void World_Init(SDL_GPUDevice* in_device, WorldLighting in_lighting)
 {
+    SDL_COMPILE_TIME_ASSERT("", LIGHT_CELL_WIDTH * LIGHT_GRID_WIDTH == CHUNK_WIDTH);
+    SDL_COMPILE_TIME_ASSERT("", LIGHT_CELL_HEIGHT * LIGHT_GRID_HEIGHT == CHUNK_HEIGHT);
     device = in_device;
+    lighting = in_lighting;
+    // stays the same if the light fields fail to allocate since the pipelines are already made
+    voxel_size = lighting == WORLD_LIGHTING_BAKED ? sizeof(BakedVoxel) : sizeof(Voxel);
     world_x = SDL_MAX_SINT32;
     world_z = SDL_MAX_SINT32;
     GPUBuffer_Init(&gpu_indices, device, SDL_GPU_BUFFERUSAGE_INDEX);
+    GPUHeap_Init(&gpu_voxels, device, SDL_GPU_BUFFERUSAGE_VERTEX, voxel_size, VOXEL_PAGE_SIZE);
+    GPUHeap_Init(&gpu_lights, device, SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ, sizeof(Light), LIGHT_PAGE_SIZE);
+    CPUBuffer_Init(&cpu_instances, sizeof(ChunkInstance));
     for (int i = 0; i < WORLD_MESH_TYPE_COUNT; i++)
     {
-        CPUBuffer_Init(&cpu_voxels[i], device, sizeof(Voxel));
+        CPUBuffer_Init(&cpu_voxels[i], voxel_size);
+        for (int j = 0; j < WORLD_MESH_VARIANT_COUNT; j++)
+        {
+            CPUBuffer_Init(&cpu_draws[i][j], sizeof(SDL_GPUIndexedIndirectDrawCommand));
+        }
+    }
+    for (int i = 0; i < WORLD_FRAMES; i++)
+    {
+        DrawList* list = &draw_lists[i];
+        GPUBuffer_Init(&list->instances, device, SDL_GPU_BUFFERUSAGE_VERTEX);
+        for (int j = 0; j < WORLD_MESH_TYPE_COUNT; j++)
+        for (int k = 0; k < WORLD_MESH_VARIANT_COUNT; k++)
+        {
+            GPUBuffer_Init(&list->draws[j][k], device, SDL_GPU_BUFFERUSAGE_INDIRECT);
+            list->batch_counts[j][k] = 0;
+        }
+        list->light_count = 0;
     }
     for (int i = 0; i < WORKERS; i++)
     {
         WorldWorker* worker = &all_workers[i];
         for (int j = 0; j < WORLD_MESH_TYPE_COUNT; j++)
         {
-            CPUBuffer_Init(&worker->voxels[j], device, sizeof(Voxel));
+            CPUBuffer_Init(&worker->voxels[j], voxel_size);
         }
-        CPUBuffer_Init(&worker->lights, device, sizeof(Light));
+        CPUBuffer_Init(&worker->lights, sizeof(Light));
+        worker->field = CreateLightField();
         Worker_Init(&worker->worker);
     }
+    Worker_Init(&occlusion_worker);
+    has_occlusion = false;
+    mesh_mutex = SDL_CreateMutex();
+    if (!mesh_mutex)
+    {
+        SDL_Log("Failed to create mutex: %s", SDL_GetError());
+    }
+    SDL_SetAtomicInt(&generated_meshes, 0);
+    SDL_SetAtomicInt(&shared_meshes, 0);
+    SDL_SetAtomicInt(&cached_meshes, 0);
+    cpu_field = CreateLightField();
     for (int x = 0; x < WORLD_WIDTH; x++)
     for (int z = 0; z < WORLD_WIDTH; z++)
     {
@@ -587,10 +1546,12 @@ void World_Init(SDL_GPUDevice* in_device)
     int center = WORLD_WIDTH / 2;
     SDL_qsort_r(sorted_chunks, WORLD_WIDTH * WORLD_WIDTH, sizeof(int) * 2, SortFunction, &center);
     GenerateIndexBuffer();
+    GenerateEmptyLights();
 }
 
 void World_Free()
 {
+    Worker_Free(&occlusion_worker);
     for (int i = 0; i < WORKERS; i++)
     {
         WorldWorker* worker = &all_workers[i];
@@ -600,160 +1561,587 @@ void World_Free()
             CPUBuffer_Free(&worker->voxels[i]);
         }
         CPUBuffer_Free(&worker->lights);
+        SDL_free(worker->nearby_lights.data);
+        SDL_free(worker->field);
+        SDL_zero(worker->nearby_lights);
+        worker->field = NULL;
     }
+    SDL_free(cpu_field);
+    cpu_field = NULL;
     for (int x = 0; x < WORLD_WIDTH; x++)
     for (int z = 0; z < WORLD_WIDTH; z++)
     {
         FreeChunk(chunks[x][z]);
     }
+    SDL_DestroyMutex(mesh_mutex);
+    mesh_mutex = NULL;
     GPUBuffer_Free(&gpu_indices);
+    CPUBuffer_Free(&cpu_instances);
     for (int i = 0; i < WORLD_MESH_TYPE_COUNT; i++)
     {
         CPUBuffer_Free(&cpu_voxels[i]);
+        for (int j = 0; j < WORLD_MESH_VARIANT_COUNT; j++)
+        {
+            CPUBuffer_Free(&cpu_draws[i][j]);
+        }
+    }
+    for (int i = 0; i < WORLD_FRAMES; i++)
+    {
+        DrawList* list = &draw_lists[i];
+        GPUBuffer_Free(&list->instances);
+        for (int j = 0; j < WORLD_MESH_TYPE_COUNT; j++)
+        for (int k = 0; k < WORLD_MESH_VARIANT_COUNT; k++)
+        {
+            GPUBuffer_Free(&list->draws[j][k]);
+            list->batch_counts[j][k] = 0;
+        }
+        list->light_count = 0;
+    }
+    GPUHeap_Release(&gpu_lights, &empty_lights);
+    GPUHeap_Free(&gpu_voxels);
+    GPUHeap_Free(&gpu_lights);
+}
+
+static void Shuffle(int dx, int dz)
+{
+    world_x += dx;
+    world_z += dz;
+    Chunk* kept[WORLD_WIDTH][WORLD_WIDTH] = {0};
+    Chunk* recycled[WORLD_WIDTH * WORLD_WIDTH] = {0};
+    int count = 0;
+    for (int x = 0; x < WORLD_WIDTH; x++)
+    for (int z = 0; z < WORLD_WIDTH; z++)
+    {
+        SDL_assert(chunks[x][z]);
+        int new_x = x - dx;
+        int new_z = z - dz;
+        if (IsChunkInWorld(new_x, new_z))
+        {
+            kept[new_x][new_z] = chunks[x][z];
+        }
+        else
+        {
+            recycled[count++] = chunks[x][z];
+        }
+        chunks[x][z] = NULL;
+    }
+    SDL_memcpy(chunks, kept, sizeof(kept));
+    for (int x = 0; x < WORLD_WIDTH; x++)
+    for (int z = 0; z < WORLD_WIDTH; z++)
+    {
+        if (!chunks[x][z])
+        {
+            SDL_assert(count > 0);
+            Chunk* chunk = recycled[--count];
+            SDL_SetAtomicInt(&chunk->block_state, TASK_STATE_REQUESTED);
+            SDL_SetAtomicInt(&chunk->voxel_state, TASK_STATE_REQUESTED);
+            SDL_SetAtomicInt(&chunk->light_state, TASK_STATE_REQUESTED);
+            chunk->render_lights.size = 0;
+            chunk->update_lights.size = 0;
+            for (int i = 0; i < WORLD_MESH_TYPE_COUNT; i++)
+            {
+                chunk->render_mesh.voxels[i].size = 0;
+                chunk->update_mesh.voxels[i].size = 0;
+            }
+            SDL_zeroa(chunk->render_mesh.sections);
+            chunks[x][z] = chunk;
+        }
+        Chunk* chunk = chunks[x][z];
+        chunk->x = (world_x + x) * CHUNK_WIDTH;
+        chunk->z = (world_z + z) * CHUNK_WIDTH;
+    }
+    SDL_assert(!count);
+}
+
+static bool TryMoveChunks(const Camera* camera)
+{
+    const int dx = FloorChunkIndex(camera->x) - WORLD_WIDTH / 2 - world_x;
+    const int dz = FloorChunkIndex(camera->z) - WORLD_WIDTH / 2 - world_z;
+    if (!dx && !dz)
+    {
+        return true;
+    }
+    WorldWorker* workers[WORKERS];
+    if (GetWorkers(workers) != WORKERS)
+    {
+        return false;
+    }
+    Shuffle(dx, dz);
+    return true;
+}
+
+// coarser levels are entered a little past their distance and left a little before it,
+// so a camera moving back and forth over a boundary does not remesh the chunk every time
+static int GetChunkLod(const Chunk* chunk, const Camera* camera)
+{
+    float dx = chunk->x + CHUNK_WIDTH / 2.0f - camera->x;
+    float dz = chunk->z + CHUNK_WIDTH / 2.0f - camera->z;
+    float distance = SDL_sqrtf(dx * dx + dz * dz);
+    int lod = 0;
+    for (int i = 0; i < MESH_LODS - 1; i++)
+    {
+        float threshold = MESH_LOD_DISTANCES[i];
+        threshold += i >= chunk->lod ? MESH_LOD_HYSTERESIS : -MESH_LOD_HYSTERESIS;
+        if (distance >= threshold)
+        {
+            lod = i + 1;
+        }
+    }
+    return lod;
+}
+
+static void UpdateChunkLods(const Camera* camera)
+{
+    for (int x = 1; x < WORLD_WIDTH - 1; x++)
+    for (int z = 1; z < WORLD_WIDTH - 1; z++)
+    {
+        Chunk* chunk = chunks[x][z];
+        int state = SDL_GetAtomicInt(&chunk->voxel_state);
+        if (state != TASK_STATE_REQUESTED && state != TASK_STATE_COMPLETED)
+        {
+            continue;
+        }
+        int lod = GetChunkLod(chunk, camera);
+        if (lod != chunk->lod)
+        {
+            chunk->lod = lod;
+            SDL_SetAtomicInt(&chunk->voxel_state, TASK_STATE_REQUESTED);
+        }
+    }
+}
+
+void World_Update(const Camera* camera)
+{
+    if (!TryMoveChunks(camera))
+    {
+        return;
+    }
+    UpdateChunkLods(camera);
+    WorldWorker* workers[WORKERS] = {0};
+    int count = GetWorkers(workers);
+    for (int i = 0; i < WORLD_WIDTH * WORLD_WIDTH; i++)
+    {
+        if (!count)
+        {
+            return;
+        }
+        int cx = sorted_chunks[i][0];
+        int cz = sorted_chunks[i][1];
+        WorldWorker* worker = workers[count - 1];
+        if (TryDispatchTask(cx, cz, worker))
+        {
+            count--;
+        }
+    }
+}
+
+static void PublishLights(Chunk* chunk)
+{
+    if (SDL_GetAtomicInt(&chunk->light_state) == TASK_STATE_PUBLISHED)
+    {
+        GPUAllocation lights = chunk->render_lights;
+        chunk->render_lights = chunk->update_lights;
+        chunk->update_lights = lights;
+        SDL_SetAtomicInt(&chunk->light_state, TASK_STATE_COMPLETED);
+    }
+}
+
+// the render mesh is only ever swapped here, so workers never write to a mesh a frame in flight still draws
+static void PublishVoxels(Chunk* chunk)
+{
+    if (SDL_GetAtomicInt(&chunk->voxel_state) == TASK_STATE_PUBLISHED)
+    {
+        ChunkMesh mesh = chunk->render_mesh;
+        chunk->render_mesh = chunk->update_mesh;
+        chunk->update_mesh = mesh;
+        SDL_SetAtomicInt(&chunk->voxel_state, TASK_STATE_COMPLETED);
+    }
+}
+
+static bool IsChunkRenderable(int cx, int cz)
+{
+    if (IsChunkOnWorldBorder(cx, cz))
+    {
+        return false;
+    }
+    return SDL_GetAtomicInt(&chunks[cx][cz]->block_state) == TASK_STATE_COMPLETED;
+}
+
+static bool IsChunkVisible(const Chunk* chunk, const Camera* camera)
+{
+    return Camera_IsVisible(camera, chunk->x, 0.0f, chunk->z, CHUNK_WIDTH, CHUNK_HEIGHT, CHUNK_WIDTH);
+}
+
+static bool IsChunkOccluded(const Chunk* chunk)
+{
+    float min[3] = {chunk->x, 0.0f, chunk->z};
+    float max[3] = {chunk->x + CHUNK_WIDTH, chunk->height, chunk->z + CHUNK_WIDTH};
+    return !Occlusion_IsVisible(front_occlusion, min, max);
+}
+
+static void OcclusionFunction(void* args)
+{
+    Occlusion* occlusion = args;
+    Occlusion_Clear(occlusion, &occlusion_camera);
+    for (int i = 0; i < occluder_count; i++)
+    {
+        Occlusion_AddBox(occlusion, occluders[i].min, occluders[i].max);
     }
 }
 
-static void Shuffle(int dx, int dz)
+static void AddOccluders(const Chunk* chunk)
 {
-    world_x += dx;
-    world_z += dz;
-    Chunk* kept[WORLD_WIDTH][WORLD_WIDTH] = {0};
-    Chunk* recycled[WORLD_WIDTH * WORLD_WIDTH] = {0};
-    int count = 0;
-    for (int x = 0; x < WORLD_WIDTH; x++)
-    for (int z = 0; z < WORLD_WIDTH; z++)
+    for (int i = 0; i < OCCLUDER_CELLS; i++)
+    for (int j = 0; j < OCCLUDER_CELLS; j++)
     {
-        SDL_assert(chunks[x][z]);
-        int new_x = x - dx;
-        int new_z = z - dz;
-        if (IsChunkInWorld(new_x, new_z))
+        int height = CHUNK_HEIGHT;
+        for (int x = 0; x < OCCLUDER_WIDTH; x++)
+        for (int z = 0; z < OCCLUDER_WIDTH; z++)
         {
-            kept[new_x][new_z] = chunks[x][z];
+            height = SDL_min(height, chunk->columns[i * OCCLUDER_WIDTH + x][j * OCCLUDER_WIDTH + z]);
         }
-        else
+        if (!height)
         {
-            recycled[count++] = chunks[x][z];
+            continue;
         }
-        chunks[x][z] = NULL;
+        Occluder* occluder = &occluders[occluder_count++];
+        occluder->min[0] = chunk->x + i * OCCLUDER_WIDTH;
+        occluder->min[1] = 0.0f;
+        occluder->min[2] = chunk->z + j * OCCLUDER_WIDTH;
+        occluder->max[0] = occluder->min[0] + OCCLUDER_WIDTH;
+        occluder->max[1] = height;
+        occluder->max[2] = occluder->min[2] + OCCLUDER_WIDTH;
     }
-    SDL_memcpy(chunks, kept, sizeof(kept));
-    for (int x = 0; x < WORLD_WIDTH; x++)
-    for (int z = 0; z < WORLD_WIDTH; z++)
-    {
-        if (!chunks[x][z])
+}
+
+// rasterizes this frame's occluders on a worker while the frame renders, for the next frame to test against
+static void DispatchOcclusion(const Camera* camera)
+{
+    int center_x = FloorChunkIndex(camera->x) - world_x;
+    int center_z = FloorChunkIndex(camera->z) - world_z;
+    occluder_count = 0;
+    for (int x = center_x - OCCLUDER_DISTANCE; x <= center_x + OCCLUDER_DISTANCE; x++)
+    for (int z = center_z - OCCLUDER_DISTANCE; z <= center_z + OCCLUDER_DISTANCE; z++)
+    {
+        Chunk* chunk = GetChunk(x, z);
+        if (!chunk || SDL_GetAtomicInt(&chunk->block_state) != TASK_STATE_COMPLETED)
         {
-            SDL_assert(count > 0);
-            Chunk* chunk = recycled[--count];
-            SDL_SetAtomicInt(&chunk->block_state, TASK_STATE_REQUESTED);
-            SDL_SetAtomicInt(&chunk->voxel_state, TASK_STATE_REQUESTED);
-            SDL_SetAtomicInt(&chunk->light_state, TASK_STATE_REQUESTED);
-            GPUBuffer_Clear(&chunk->gpu_render_lights);
-            GPUBuffer_Clear(&chunk->gpu_update_lights);
-            chunks[x][z] = chunk;
+            continue;
+        }
+        if (IsChunkVisible(chunk, camera))
+        {
+            AddOccluders(chunk);
         }
-        Chunk* chunk = chunks[x][z];
-        chunk->x = (world_x + x) * CHUNK_WIDTH;
-        chunk->z = (world_z + z) * CHUNK_WIDTH;
     }
-    SDL_assert(!count);
+    occlusion_camera = *camera;
+    Worker_Dispatch(&occlusion_worker, OcclusionFunction, back_occlusion);
 }
 
-static bool TryMoveChunks(const Camera* camera)
+static void AppendDraw(DrawList* list, WorldMeshType type, WorldMeshVariant variant, const GPUAllocation* voxels, Uint32 offset, Uint32 size, const GPUAllocation* lights, Uint32 instance)
 {
-    const int dx = FloorChunkIndex(camera->x) - WORLD_WIDTH / 2 - world_x;
-    const int dz = FloorChunkIndex(camera->z) - WORLD_WIDTH / 2 - world_z;
-    if (!dx && !dz)
-    {
-        return true;
-    }
-    WorldWorker* workers[WORKERS];
-    if (GetWorkers(workers) != WORKERS)
+    SDL_assert(offset + size <= voxels->size);
+    SDL_GPUIndexedIndirectDrawCommand command = {0};
+    command.num_indices = size / 4 * 6;
+    command.num_instances = 1;
+    command.vertex_offset = voxels->offset + offset;
+    command.first_instance = instance;
+    // unlit draws never bind the light buffer so only the voxel page splits them
+    Uint32 light_page = variant == WORLD_MESH_VARIANT_LIT ? lights->page : 0;
+    DrawBatch* batch = NULL;
+    int count = list->batch_counts[type][variant];
+    if (count)
+    {
+        batch = &list->batches[type][variant][count - 1];
+    }
+    if (!batch || batch->voxel_page != voxels->page || batch->light_page != light_page)
+    {
+        batch = &list->batches[type][variant][list->batch_counts[type][variant]++];
+        batch->voxel_page = voxels->page;
+        batch->light_page = light_page;
+        batch->first = cpu_draws[type][variant].size;
+        batch->count = 0;
+    }
+    CPUBuffer_Append(&cpu_draws[type][variant], &command);
+    batch->count++;
+}
+
+static bool IsSectionEmpty(const Section* section)
+{
+    for (int type = 0; type < WORLD_MESH_TYPE_COUNT; type++)
+    for (int group = 0; group < FACE_GROUP_COUNT; group++)
     {
-        return false;
+        if (section->sizes[type][group])
+        {
+            return false;
+        }
     }
-    Shuffle(dx, dz);
     return true;
 }
 
-void World_Update(const Camera* camera)
+// faces pointing away from the camera for the whole section are culled by the opaque pipeline anyway
+static bool IsFaceGroupVisible(WorldMeshType type, int group, int section, const Camera* camera)
 {
-    if (!TryMoveChunks(camera))
+    if (type != WORLD_MESH_TYPE_OPAQUE || group == FACE_GROUP_SPRITE)
     {
-        return;
+        return true;
     }
-    WorldWorker* workers[WORKERS] = {0};
-    int count = GetWorkers(workers);
-    for (int i = 0; i < WORLD_WIDTH * WORLD_WIDTH; i++)
+    const float position[3] = {camera->x, camera->y, camera->z};
+    for (int i = 0; i < 3; i++)
     {
-        if (!count)
+        if (DIRECTIONS[group][i] > 0 && position[i] <= section_bounds[i][section])
         {
-            return;
+            return false;
         }
-        int cx = sorted_chunks[i][0];
-        int cz = sorted_chunks[i][1];
-        WorldWorker* worker = workers[count - 1];
-        if (TryDispatchTask(cx, cz, worker))
+        if (DIRECTIONS[group][i] < 0 && position[i] >= section_bounds[i + 3][section])
         {
-            count--;
+            return false;
         }
     }
+    return true;
 }
 
-static void Render(Chunk* chunk, WorldMeshType type, SDL_GPUCommandBuffer* command_buffer, SDL_GPURenderPass* render_pass)
+static void AppendChunk(DrawList* list, Chunk* chunk, int first, int last, const Camera* camera, bool is_occluding)
 {
-    GPUBuffer* voxels = &chunk->gpu_voxels[type];
-    if (!voxels->size)
+    bool is_visible = false;
+    for (int i = first; i < last; i++)
     {
-        return;
+        is_visible |= section_visible[i];
     }
-    if (SDL_GetAtomicInt(&chunk->light_state) == TASK_STATE_PUBLISHED)
+    if (!is_visible)
     {
-        GPUBuffer lights = chunk->gpu_render_lights;
-        chunk->gpu_render_lights = chunk->gpu_update_lights;
-        chunk->gpu_update_lights = lights;
-        SDL_SetAtomicInt(&chunk->light_state, TASK_STATE_COMPLETED);
+        culling.culled++;
+        return;
     }
-    SDL_GPUBufferBinding voxel_binding = {0};
-    SDL_GPUBufferBinding index_binding = {0};
-    voxel_binding.buffer = voxels->buffer;
-    index_binding.buffer = gpu_indices.buffer;
-    SDL_GPUBuffer* lights = chunk->gpu_render_lights.buffer;
-    Sint32 light_count = chunk->gpu_render_lights.size;
-    if (!lights)
+    if (is_occluding && IsChunkOccluded(chunk))
     {
+        culling.occluded++;
         return;
     }
-    SDL_PushGPUFragmentUniformData(command_buffer, 0, &light_count, sizeof(light_count));
-    SDL_BindGPUFragmentStorageBuffers(render_pass, 1, &lights, 1);
-    SDL_PushGPUVertexUniformData(command_buffer, 2, chunk->position, sizeof(chunk->position));
-    SDL_BindGPUVertexBuffers(render_pass, 0, &voxel_binding, 1);
-    SDL_BindGPUIndexBuffer(render_pass, &index_binding, SDL_GPU_INDEXELEMENTSIZE_32BIT);
-    SDL_DrawGPUIndexedPrimitives(render_pass, voxels->size / 4 * 6, 1, 0, 0, 0);
+    culling.drawn++;
+    PublishLights(chunk);
+    const GPUAllocation* lights = &chunk->render_lights;
+    if (!lights->size)
+    {
+        lights = &empty_lights;
+    }
+    // a light buffer holding only the cell headers has no lights in any cell
+    WorldMeshVariant variant = WORLD_MESH_VARIANT_UNLIT;
+    if (lights->size > LIGHT_GRID_SIZE)
+    {
+        variant = WORLD_MESH_VARIANT_LIT;
+    }
+    bool has_draws = false;
+    for (int type = 0; type < WORLD_MESH_TYPE_COUNT; type++)
+    {
+        const GPUAllocation* voxels = &chunk->render_mesh.voxels[type];
+        if (!voxels->size)
+        {
+            continue;
+        }
+        // visible ranges are merged whenever they are adjacent in the mesh
+        Uint32 offset = 0;
+        Uint32 size = 0;
+        for (int group = 0; group < FACE_GROUP_COUNT; group++)
+        for (int i = first; i < last; i++)
+        {
+            const Section* section = &chunk->render_mesh.sections[section_indices[i]];
+            Uint32 range_offset = section->offsets[type][group];
+            Uint32 range_size = section->sizes[type][group];
+            if (!range_size || !section_visible[i] || !IsFaceGroupVisible(type, group, i, camera))
+            {
+                continue;
+            }
+            if (size && offset + size != range_offset)
+            {
+                AppendDraw(list, type, variant, voxels, offset, size, lights, cpu_instances.size);
+                has_draws = true;
+                size = 0;
+            }
+            if (!size)
+            {
+                offset = range_offset;
+            }
+            size += range_size;
+        }
+        if (size)
+        {
+            AppendDraw(list, type, variant, voxels, offset, size, lights, cpu_instances.size);
+            has_draws = true;
+        }
+    }
+    if (has_draws)
+    {
+        ChunkInstance instance = {chunk->x, chunk->z, lights->offset};
+        CPUBuffer_Append(&cpu_instances, &instance);
+    }
 }
 
-void World_Render(const Camera* camera, WorldMeshType type, SDL_GPUCommandBuffer* command_buffer, SDL_GPURenderPass* render_pass)
+static void AppendLights(DrawList* list, const Camera* camera)
 {
-    SDL_PushGPUVertexUniformData(command_buffer, 0, camera->proj, sizeof(camera->proj));
-    SDL_PushGPUVertexUniformData(command_buffer, 1, camera->view, sizeof(camera->view));
+    list->light_count = 0;
     for (int i = 0; i < WORLD_WIDTH * WORLD_WIDTH; i++)
     {
         int cx = sorted_chunks[i][0];
         int cz = sorted_chunks[i][1];
-        if (IsChunkOnWorldBorder(cx, cz))
+        if (!IsChunkRenderable(cx, cz))
         {
             continue;
         }
-        Chunk* chunk = chunks[cx][cz];
-        if (SDL_GetAtomicInt(&chunk->voxel_state) != TASK_STATE_COMPLETED)
+        const Chunk* chunk = chunks[cx][cz];
+        if (!IsChunkVisible(chunk, camera))
+        {
+            continue;
+        }
+        const GPUAllocation* lights = &chunk->render_lights;
+        if (lights->size <= LIGHT_GRID_SIZE)
         {
             continue;
         }
-        if (!Camera_IsVisible(camera, chunk->x, 0.0f, chunk->z, CHUNK_WIDTH, CHUNK_HEIGHT, CHUNK_WIDTH))
+        LightDraw* draw = &list->lights[list->light_count++];
+        draw->instance.x = chunk->x;
+        draw->instance.z = chunk->z;
+        draw->instance.lights = lights->offset;
+        draw->instance.padding = 0;
+        draw->page = lights->page;
+    }
+}
+
+void World_Prepare(const Camera* camera, int frame)
+{
+    SDL_assert(frame >= 0 && frame < WORLD_FRAMES);
+    DrawList* list = &draw_lists[frame];
+    Worker_Wait(&occlusion_worker);
+    Occlusion* occlusion = front_occlusion;
+    front_occlusion = back_occlusion;
+    back_occlusion = occlusion;
+    bool is_occluding = has_occlusion && Occlusion_IsValid(front_occlusion, camera);
+    SDL_zero(culling);
+    for (int i = 0; i < WORLD_MESH_TYPE_COUNT; i++)
+    for (int j = 0; j < WORLD_MESH_VARIANT_COUNT; j++)
+    {
+        list->batch_counts[i][j] = 0;
+    }
+    SDL_zero(list->coverage);
+    list->coverage.x = world_x * CHUNK_WIDTH;
+    list->coverage.z = world_z * CHUNK_WIDTH;
+    list->coverage.cell_width = CHUNK_WIDTH;
+    list->coverage.cell_count = WORLD_WIDTH;
+    Chunk* section_chunks[WORLD_WIDTH * WORLD_WIDTH];
+    int section_firsts[WORLD_WIDTH * WORLD_WIDTH + 1];
+    int chunk_count = 0;
+    int section_count = 0;
+    for (int i = 0; i < WORLD_WIDTH * WORLD_WIDTH; i++)
+    {
+        int cx = sorted_chunks[i][0];
+        int cz = sorted_chunks[i][1];
+        if (!IsChunkRenderable(cx, cz))
         {
             continue;
         }
-        Render(chunk, type, command_buffer, render_pass);
+        Chunk* chunk = chunks[cx][cz];
+        PublishVoxels(chunk);
+        if (chunk->render_mesh.voxels[WORLD_MESH_TYPE_OPAQUE].size || chunk->render_mesh.voxels[WORLD_MESH_TYPE_TRANSPARENT].size)
+        {
+            int index = (FloorChunkIndex(chunk->x) - world_x) * WORLD_WIDTH + FloorChunkIndex(chunk->z) - world_z;
+            list->coverage.mask[index / 32] |= 1u << (index % 32);
+        }
+        int first = section_count;
+        for (int j = 0; j < SECTION_COUNT; j++)
+        {
+            const Section* section = &chunk->render_mesh.sections[j];
+            if (IsSectionEmpty(section))
+            {
+                continue;
+            }
+            section_bounds[0][section_count] = chunk->x + section->min[0];
+            section_bounds[1][section_count] = section->min[1];
+            section_bounds[2][section_count] = chunk->z + section->min[2];
+            section_bounds[3][section_count] = chunk->x + section->max[0];
+            section_bounds[4][section_count] = section->max[1];
+            section_bounds[5][section_count] = chunk->z + section->max[2];
+            section_indices[section_count++] = j;
+        }
+        if (section_count > first)
+        {
+            section_chunks[chunk_count] = chunk;
+            section_firsts[chunk_count++] = first;
+        }
     }
+    section_firsts[chunk_count] = section_count;
+    const float* const min[3] = {section_bounds[0], section_bounds[1], section_bounds[2]};
+    const float* const max[3] = {section_bounds[3], section_bounds[4], section_bounds[5]};
+    Camera_AreVisible(camera, min, max, section_count, section_visible);
+    for (int i = 0; i < chunk_count; i++)
+    {
+        AppendChunk(list, section_chunks[i], section_firsts[i], section_firsts[i + 1], camera, is_occluding);
+    }
+    AppendLights(list, camera);
+    DispatchOcclusion(camera);
+    has_occlusion = true;
+    if (!cpu_instances.size)
+    {
+        return;
+    }
+    GPUBuffer_Upload(&list->instances, &cpu_instances);
+    for (int i = 0; i < WORLD_MESH_TYPE_COUNT; i++)
+    for (int j = 0; j < WORLD_MESH_VARIANT_COUNT; j++)
+    {
+        GPUBuffer_Upload(&list->draws[i][j], &cpu_draws[i][j]);
+    }
+}
+
+void World_Render(const Camera* camera, int frame, WorldMeshType type, WorldMeshVariant variant, SDL_GPUCommandBuffer* command_buffer, SDL_GPURenderPass* render_pass)
+{
+    SDL_assert(frame >= 0 && frame < WORLD_FRAMES);
+    const DrawList* list = &draw_lists[frame];
+    if (!list->batch_counts[type][variant])
+    {
+        return;
+    }
+    SDL_PushGPUVertexUniformData(command_buffer, 0, camera->proj, sizeof(camera->proj));
+    SDL_PushGPUVertexUniformData(command_buffer, 1, camera->view, sizeof(camera->view));
+    SDL_GPUBufferBinding index_binding = {0};
+    index_binding.buffer = gpu_indices.buffer;
+    SDL_BindGPUIndexBuffer(render_pass, &index_binding, SDL_GPU_INDEXELEMENTSIZE_32BIT);
+    for (int i = 0; i < list->batch_counts[type][variant]; i++)
+    {
+        const DrawBatch* batch = &list->batches[type][variant][i];
+        SDL_GPUBufferBinding vertex_bindings[2] = {0};
+        vertex_bindings[0].buffer = GPUHeap_GetBuffer(&gpu_voxels, batch->voxel_page);
+        vertex_bindings[1].buffer = list->instances.buffer;
+        Uint32 offset = batch->first * sizeof(SDL_GPUIndexedIndirectDrawCommand);
+        SDL_BindGPUVertexBuffers(render_pass, 0, vertex_bindings, 2);
+        if (variant == WORLD_MESH_VARIANT_LIT)
+        {
+            SDL_GPUBuffer* lights = GPUHeap_GetBuffer(&gpu_lights, batch->light_page);
+            SDL_BindGPUFragmentStorageBuffers(render_pass, 1, &lights, 1);
+        }
+        SDL_DrawGPUIndexedPrimitivesIndirect(render_pass, list->draws[type][variant].buffer, offset, batch->count);
+    }
+}
+
+void World_RenderLights(const Camera* camera, int frame, SDL_GPUCommandBuffer* command_buffer, SDL_GPURenderPass* render_pass)
+{
+    SDL_assert(frame >= 0 && frame < WORLD_FRAMES);
+    const DrawList* list = &draw_lists[frame];
+    SDL_PushGPUVertexUniformData(command_buffer, 0, camera->proj, sizeof(camera->proj));
+    SDL_PushGPUVertexUniformData(command_buffer, 1, camera->view, sizeof(camera->view));
+    for (int i = 0; i < list->light_count; i++)
+    {
+        const LightDraw* draw = &list->lights[i];
+        const Sint32 position[2] = {draw->instance.x, draw->instance.z};
+        SDL_GPUBuffer* buffer = GPUHeap_GetBuffer(&gpu_lights, draw->page);
+        SDL_PushGPUFragmentUniformData(command_buffer, 0, &draw->instance, sizeof(draw->instance));
+        SDL_BindGPUFragmentStorageBuffers(render_pass, 0, &buffer, 1);
+        SDL_PushGPUVertexUniformData(command_buffer, 2, position, sizeof(position));
+        SDL_DrawGPUPrimitives(render_pass, 36, 1, 0, 0);
+    }
+}
+
+WorldCoverage World_GetCoverage(int frame)
+{
+    SDL_assert(frame >= 0 && frame < WORLD_FRAMES);
+    return draw_lists[frame].coverage;
 }
 
 static Chunk* GetWorldChunk(const int position[3])
@@ -776,7 +2164,7 @@ static Chunk* GetWorldChunk(const int position[3])
         return NULL;
     }
     bool blocks = SDL_GetAtomicInt(&chunk->block_state) == TASK_STATE_COMPLETED;
-    bool voxels = SDL_GetAtomicInt(&chunk->voxel_state) == TASK_STATE_COMPLETED;
+    bool voxels = SDL_GetAtomicInt(&chunk->voxel_state) >= TASK_STATE_PUBLISHED;
     if (blocks && voxels)
     {
         return chunk;
@@ -787,7 +2175,67 @@ static Chunk* GetWorldChunk(const int position[3])
     }
 }
 
-void World_SetBlock(const int position[3], Block block)
+typedef enum BatchState
+{
+    BATCH_STATE_UNKNOWN,
+    BATCH_STATE_READY,
+    BATCH_STATE_BUSY,
+} BatchState;
+
+// chunk states are only changed in FlushBatch, so readiness is checked once per chunk and batch
+typedef struct Batch
+{
+    Uint8 states[WORLD_WIDTH][WORLD_WIDTH];
+    bool voxels[WORLD_WIDTH][WORLD_WIDTH];
+    bool lights[WORLD_WIDTH][WORLD_WIDTH];
+    bool has_edits;
+} Batch;
+
+static bool IsBatchReady(Batch* batch, int cx, int cz)
+{
+    if (batch->states[cx][cz] == BATCH_STATE_UNKNOWN)
+    {
+        batch->states[cx][cz] = BATCH_STATE_READY;
+        for (int dx = -1; dx <= 1; dx++)
+        for (int dz = -1; dz <= 1; dz++)
+        {
+            Chunk* neighbor = GetChunk(cx + dx, cz + dz);
+            if (!neighbor ||
+                SDL_GetAtomicInt(&neighbor->block_state) != TASK_STATE_COMPLETED ||
+                SDL_GetAtomicInt(&neighbor->voxel_state) < TASK_STATE_PUBLISHED ||
+                SDL_GetAtomicInt(&neighbor->light_state) < TASK_STATE_PUBLISHED)
+            {
+                batch->states[cx][cz] = BATCH_STATE_BUSY;
+                break;
+            }
+        }
+    }
+    return batch->states[cx][cz] == BATCH_STATE_READY;
+}
+
+static bool IsLightInReach(int cx, int cz, const int position[3])
+{
+    for (int dx = -1; dx <= 1; dx++)
+    for (int dz = -1; dz <= 1; dz++)
+    {
+        const Chunk* chunk = chunks[cx + dx][cz + dz];
+        for (Uint32 i = 0; i < chunk->lights.size; i++)
+        {
+            MapRow row = Map_GetRow(&chunk->lights, i);
+            int distance = 0;
+            distance += SDL_abs(chunk->x + row.x - position[0]);
+            distance += SDL_abs(row.y - position[1]);
+            distance += SDL_abs(chunk->z + row.z - position[2]);
+            if (distance <= Block_GetLight(row.value).radius)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static void ApplyEdit(Batch* batch, const int position[3], Block block)
 {
     Chunk* chunk = GetWorldChunk(position);
     if (!chunk)
@@ -796,19 +2244,14 @@ void World_SetBlock(const int position[3], Block block)
     }
     int cx = chunk->x / CHUNK_WIDTH - world_x;
     int cz = chunk->z / CHUNK_WIDTH - world_z;
-    Chunk* group[3][3] = {0};
-    for (int dx = -1; dx <= 1; dx++)
-    for (int dz = -1; dz <= 1; dz++)
+    if (!IsBatchReady(batch, cx, cz))
     {
-        Chunk* neighbor = GetChunk(cx + dx, cz + dz);
-        if (!neighbor ||
-            SDL_GetAtomicInt(&neighbor->block_state) != TASK_STATE_COMPLETED ||
-            SDL_GetAtomicInt(&neighbor->voxel_state) != TASK_STATE_COMPLETED ||
-            SDL_GetAtomicInt(&neighbor->light_state) < TASK_STATE_PUBLISHED)
-        {
-            return;
-        }
-        group[dx + 1][dz + 1] = neighbor;
+        return;
+    }
+    if (!batch->has_edits)
+    {
+        Save_BeginBatch();
+        batch->has_edits = true;
     }
     Save_SetBlock(chunk->x, chunk->z, position[0], position[1], position[2], block);
     int bx = position[0];
@@ -816,37 +2259,118 @@ void World_SetBlock(const int position[3], Block block)
     int bz = position[2];
     WorldBlockToChunkBlock(chunk, &bx, &by, &bz);
     Block old_block = SetChunkBlock(chunk, position[0], position[1], position[2], block);
-    int min_x = bx == 0 ? -1 : 0;
-    int max_x = bx == CHUNK_WIDTH - 1 ? 1 : 0;
-    int min_z = bz == 0 ? -1 : 0;
-    int max_z = bz == CHUNK_WIDTH - 1 ? 1 : 0;
+    UpdateChunkColumn(chunk, bx, bz);
+    if (block != BLOCK_EMPTY)
+    {
+        chunk->height = SDL_max(chunk->height, by + 1);
+    }
+    // baked light reaches at most the radius of the brightest light
+    int reach = 1;
+    if (lighting == WORLD_LIGHTING_BAKED && (Block_IsLight(old_block) || IsLightInReach(cx, cz, position)))
+    {
+        reach = MAX_LIGHT_RADIUS;
+    }
+    int min_x = bx - reach < 0 ? -1 : 0;
+    int max_x = bx + reach >= CHUNK_WIDTH ? 1 : 0;
+    int min_z = bz - reach < 0 ? -1 : 0;
+    int max_z = bz + reach >= CHUNK_WIDTH ? 1 : 0;
     for (int dx = min_x; dx <= max_x; dx++)
     for (int dz = min_z; dz <= max_z; dz++)
     {
-        int x = cx + dx;
-        int z = cz + dz;
-        SDL_assert(IsChunkInWorld(x, z));
+        SDL_assert(IsChunkInWorld(cx + dx, cz + dz));
+        batch->voxels[cx + dx][cz + dz] = true;
+    }
+    if (!Block_IsLight(block) && !Block_IsLight(old_block))
+    {
+        return;
+    }
+    batch->lights[cx][cz] = true;
+    if (lighting == WORLD_LIGHTING_BAKED)
+    {
+        return;
+    }
+    Light light = Block_GetLight(Block_IsLight(block) ? block : old_block);
+    light.x = position[0];
+    light.y = position[1];
+    light.z = position[2];
+    if (Block_IsLight(block) && Block_IsLight(old_block))
+    {
+        light.radius = SDL_max(light.radius, Block_GetLight(old_block).radius);
+    }
+    for (int dx = -1; dx <= 1; dx++)
+    for (int dz = -1; dz <= 1; dz++)
+    {
+        const Chunk* neighbor = chunks[cx + dx][cz + dz];
+        if (Light_IsInChunk(&light, neighbor->x, neighbor->z))
+        {
+            batch->lights[cx + dx][cz + dz] = true;
+        }
+    }
+}
+
+static void FlushBatch(Batch* batch)
+{
+    if (!batch->has_edits)
+    {
+        return;
+    }
+    Save_EndBatch();
+    for (int x = 0; x < WORLD_WIDTH; x++)
+    for (int z = 0; z < WORLD_WIDTH; z++)
+    {
+        if (!batch->voxels[x][z])
+        {
+            continue;
+        }
         if (!IsChunkOnWorldBorder(x, z))
         {
             Chunk* chunks[3][3] = {0};
             GetGroup(x, z, chunks);
             SDL_SetAtomicInt(&chunks[1][1]->voxel_state, TASK_STATE_RUNNING);
-            GenerateChunkVoxels(chunks, cpu_voxels);
+            GenerateChunkVoxels(chunks, cpu_voxels, cpu_field);
         }
         else
         {
-            SDL_SetAtomicInt(&group[dx + 1][dz + 1]->voxel_state, TASK_STATE_REQUESTED);
+            SDL_SetAtomicInt(&chunks[x][z]->voxel_state, TASK_STATE_REQUESTED);
         }
     }
-    if (!Block_IsLight(block) && !Block_IsLight(old_block))
+    for (int x = 0; x < WORLD_WIDTH; x++)
+    for (int z = 0; z < WORLD_WIDTH; z++)
     {
-        return;
+        if (batch->lights[x][z])
+        {
+            SDL_SetAtomicInt(&chunks[x][z]->light_state, TASK_STATE_REQUESTED);
+        }
+    }
+}
+
+void World_SetBlock(const int position[3], Block block)
+{
+    WorldEdit edit = {{position[0], position[1], position[2]}, block};
+    World_SetBlocks(&edit, 1);
+}
+
+void World_SetBlocks(const WorldEdit* edits, int count)
+{
+    Batch batch = {0};
+    for (int i = 0; i < count; i++)
+    {
+        ApplyEdit(&batch, edits[i].position, edits[i].block);
     }
-    for (int dx = 0; dx < 3; dx++)
-    for (int dz = 0; dz < 3; dz++)
+    FlushBatch(&batch);
+}
+
+void World_FillBlocks(const int min[3], const int max[3], Block block)
+{
+    Batch batch = {0};
+    int position[3];
+    for (position[0] = min[0]; position[0] <= max[0]; position[0]++)
+    for (position[2] = min[2]; position[2] <= max[2]; position[2]++)
+    for (position[1] = min[1]; position[1] <= max[1]; position[1]++)
     {
-        SDL_SetAtomicInt(&group[dx][dz]->light_state, TASK_STATE_REQUESTED);
+        ApplyEdit(&batch, position, block);
     }
+    FlushBatch(&batch);
 }
 
 Block World_GetBlock(const int position[3])
@@ -862,6 +2386,26 @@ Block World_GetBlock(const int position[3])
     }
 }
 
+void World_GetStats(BufferStats* stats)
+{
+    GPUHeap_GetStats(&gpu_voxels, stats);
+    GPUHeap_GetStats(&gpu_lights, stats);
+}
+
+WorldMeshStats World_GetMeshStats()
+{
+    WorldMeshStats stats;
+    stats.generated = SDL_GetAtomicInt(&generated_meshes);
+    stats.shared = SDL_GetAtomicInt(&shared_meshes);
+    stats.cached = SDL_GetAtomicInt(&cached_meshes);
+    return stats;
+}
+
+WorldCulling World_GetCulling()
+{
+    return culling;
+}
+
 WorldQuery World_Raycast(const Camera* camera, float max_distance)
 {
     WorldQuery query = {0};
@@ -7,7 +7,9 @@
 #define CHUNK_WIDTH 30
 #define CHUNK_HEIGHT 240
 #define WORLD_WIDTH 20
+#define WORLD_FRAMES 2
 
+typedef struct BufferStats BufferStats;
 typedef struct Camera Camera;
 
 typedef enum WorldMeshType
@@ -17,6 +19,20 @@ typedef enum WorldMeshType
     WORLD_MESH_TYPE_COUNT,
 } WorldMeshType;
 
+// unlit draws come from chunks without lights in reach and skip the light buffer entirely
+typedef enum WorldMeshVariant
+{
+    WORLD_MESH_VARIANT_UNLIT,
+    WORLD_MESH_VARIANT_LIT,
+    WORLD_MESH_VARIANT_COUNT,
+} WorldMeshVariant;
+
+typedef enum WorldLighting
+{
+    WORLD_LIGHTING_DYNAMIC,
+    WORLD_LIGHTING_BAKED,
+} WorldLighting;
+
 typedef struct WorldQuery
 {
     Block block;
@@ -24,10 +40,50 @@ typedef struct WorldQuery
     int previous[3];
 } WorldQuery;
 
-void World_Init(SDL_GPUDevice* device);
+typedef struct WorldCulling
+{
+    int drawn;
+    int culled;
+    int occluded;
+} WorldCulling;
+
+// meshes built from scratch, shared with a loaded chunk with the same neighborhood, or read from disk
+typedef struct WorldMeshStats
+{
+    int generated;
+    int shared;
+    int cached;
+} WorldMeshStats;
+
+// square grid of cells starting at x and z, one bit per cell that is already drawn in full
+// detail, laid out to be pushed to shaders as an int4 and four uint4
+typedef struct WorldCoverage
+{
+    Sint32 x;
+    Sint32 z;
+    Sint32 cell_width;
+    Sint32 cell_count;
+    Uint32 mask[(WORLD_WIDTH * WORLD_WIDTH + 127) / 128 * 4];
+} WorldCoverage;
+
+typedef struct WorldEdit
+{
+    int position[3];
+    Block block;
+} WorldEdit;
+
+void World_Init(SDL_GPUDevice* device, WorldLighting lighting);
 void World_Free();
 void World_Update(const Camera* camera);
-void World_Render(const Camera* camera, WorldMeshType type, SDL_GPUCommandBuffer* command_buffer, SDL_GPURenderPass* render_pass);
+void World_Prepare(const Camera* camera, int frame);
+void World_Render(const Camera* camera, int frame, WorldMeshType type, WorldMeshVariant variant, SDL_GPUCommandBuffer* command_buffer, SDL_GPURenderPass* render_pass);
+void World_RenderLights(const Camera* camera, int frame, SDL_GPUCommandBuffer* command_buffer, SDL_GPURenderPass* render_pass);
 void World_SetBlock(const int position[3], Block block);
+void World_SetBlocks(const WorldEdit* edits, int count);
+void World_FillBlocks(const int min[3], const int max[3], Block block);
 Block World_GetBlock(const int position[3]);
+void World_GetStats(BufferStats* stats);
+WorldCulling World_GetCulling();
+WorldMeshStats World_GetMeshStats();
+WorldCoverage World_GetCoverage(int frame);
 WorldQuery World_Raycast(const Camera* camera, float max_distance);
@@ -0,0 +1,194 @@
+#include <SDL3/SDL.h>
+
+#include "block.h"
+#include "light.h"
+#include "voxel.inc"
+#include "world.h"
+
+#define TRIALS 8
+#define LIGHTS 48
+
+static const int CHUNKS[TRIALS][2] = {{0, 0}, {30, 0}, {0, -30}, {-60, 90}, {300, -300}, {-30, -30}, {90, 60}, {-900, 1200}};
+
+typedef struct Grid
+{
+    Light data[LIGHT_GRID_SIZE + LIGHTS * LIGHT_GRID_SIZE];
+    int size;
+} Grid;
+
+static void AddLightFunction(void* userdata, const Light* light)
+{
+    Grid* grid = userdata;
+    SDL_assert(grid->size < SDL_arraysize(grid->data));
+    grid->data[grid->size++] = *light;
+}
+
+static int GetIndex(int cx, int cy, int cz)
+{
+    return (cx * LIGHT_GRID_HEIGHT + cy) * LIGHT_GRID_WIDTH + cz;
+}
+
+static double GetDistance(const Light* light, int x, int z, const double min[3], const double max[3])
+{
+    // independent of light.c: closest point of the box to the origin used by GetLight in shader.hlsl
+    double position[3] = {light->x - x + 0.5, light->y + 1.0, light->z - z + 0.5};
+    double distance = 0.0;
+    for (int i = 0; i < 3; i++)
+    {
+        double offset = 0.0;
+        if (position[i] < min[i])
+        {
+            offset = min[i] - position[i];
+        }
+        else if (position[i] > max[i])
+        {
+            offset = position[i] - max[i];
+        }
+        distance += offset * offset;
+    }
+    return SDL_sqrt(distance);
+}
+
+static bool CheckCell(const Light* lights, const Light* grid, int x, int z, int cx, int cy, int cz)
+{
+    const Light* header = &grid[GetIndex(cx, cy, cz)];
+    bool listed[LIGHTS] = {0};
+    for (int i = 0; i < header->y; i++)
+    {
+        const Light* light = &grid[header->x + i];
+        int index = -1;
+        for (int j = 0; j < LIGHTS && index < 0; j++)
+        {
+            if (!listed[j] && !SDL_memcmp(light, &lights[j], sizeof(Light)))
+            {
+                index = j;
+            }
+        }
+        if (index < 0)
+        {
+            SDL_Log("Cell (%d, %d, %d) lists an unknown or duplicate light", cx, cy, cz);
+            return false;
+        }
+        listed[index] = true;
+    }
+    double min[3] = {cx * LIGHT_CELL_WIDTH, cy * LIGHT_CELL_HEIGHT, cz * LIGHT_CELL_WIDTH};
+    double max[3] = {min[0] + LIGHT_CELL_WIDTH, min[1] + LIGHT_CELL_HEIGHT, min[2] + LIGHT_CELL_WIDTH};
+    for (int i = 0; i < LIGHTS; i++)
+    {
+        bool expected = GetDistance(&lights[i], x, z, min, max) < lights[i].radius;
+        if (listed[i] != expected)
+        {
+            SDL_Log("Cell (%d, %d, %d) %s light %d at (%d, %d, %d) with radius %d",
+                cx, cy, cz, expected ? "misses" : "wrongly lists", i,
+                lights[i].x, lights[i].y, lights[i].z, lights[i].radius);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool CheckBlocks(const Light* lights, const Light* grid, int x, int z)
+{
+    // every light reaching a block must be in the cell GetLight in shader.hlsl reads for it
+    for (int i = 0; i < LIGHTS; i++)
+    {
+        const Light* light = &lights[i];
+        for (int bx = 0; bx < CHUNK_WIDTH; bx++)
+        for (int by = 0; by < CHUNK_HEIGHT; by++)
+        for (int bz = 0; bz < CHUNK_WIDTH; bz++)
+        {
+            double min[3] = {bx, by, bz};
+            double max[3] = {bx + 1, by + 1, bz + 1};
+            if (GetDistance(light, x, z, min, max) >= light->radius)
+            {
+                continue;
+            }
+            const Light* header = &grid[GetIndex(bx / LIGHT_CELL_WIDTH, by / LIGHT_CELL_HEIGHT, bz / LIGHT_CELL_WIDTH)];
+            bool found = false;
+            for (int j = 0; j < header->y && !found; j++)
+            {
+                found = !SDL_memcmp(&grid[header->x + j], light, sizeof(Light));
+            }
+            if (!found)
+            {
+                SDL_Log("Block (%d, %d, %d) misses light %d", bx, by, bz, i);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool Run(int trial)
+{
+    int x = CHUNKS[trial][0];
+    int z = CHUNKS[trial][1];
+    Light lights[LIGHTS];
+    for (int i = 0; i < LIGHTS; i++)
+    {
+        // lights from the neighboring chunks too, some of them out of reach
+        Light* light = &lights[i];
+        light->x = x - CHUNK_WIDTH / 2 + SDL_rand(CHUNK_WIDTH * 2);
+        light->y = SDL_rand(CHUNK_HEIGHT);
+        light->z = z - CHUNK_WIDTH / 2 + SDL_rand(CHUNK_WIDTH * 2);
+        light->red = SDL_rand(256);
+        light->green = SDL_rand(256);
+        light->blue = SDL_rand(256);
+        light->radius = 1 + SDL_rand(15);
+    }
+    // the cell corners are the hardest cases
+    lights[0].x = x + LIGHT_CELL_WIDTH - 1;
+    lights[0].y = LIGHT_CELL_HEIGHT - 1;
+    lights[0].z = z + LIGHT_CELL_WIDTH - 1;
+    lights[0].radius = 1;
+    lights[1].x = x - 1;
+    lights[1].y = 0;
+    lights[1].z = z - 1;
+    lights[1].radius = 15;
+    static Grid buffer;
+    buffer.size = 0;
+    Light_GenerateGrid(&buffer, lights, LIGHTS, x, z, AddLightFunction);
+    const Light* grid = buffer.data;
+    bool ok = true;
+    Sint32 offset = LIGHT_GRID_SIZE;
+    for (int cx = 0; cx < LIGHT_GRID_WIDTH && ok; cx++)
+    for (int cy = 0; cy < LIGHT_GRID_HEIGHT && ok; cy++)
+    for (int cz = 0; cz < LIGHT_GRID_WIDTH && ok; cz++)
+    {
+        const Light* header = &grid[GetIndex(cx, cy, cz)];
+        if (header->x != offset)
+        {
+            SDL_Log("Cell (%d, %d, %d) starts at %d instead of %d", cx, cy, cz, header->x, offset);
+            ok = false;
+            break;
+        }
+        offset += header->y;
+        ok = CheckCell(lights, grid, x, z, cx, cy, cz);
+    }
+    if (ok && buffer.size != offset)
+    {
+        SDL_Log("Grid has %d lights instead of %d", buffer.size, offset);
+        ok = false;
+    }
+    ok = ok && CheckBlocks(lights, grid, x, z);
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    SDL_srand(0);
+    int status = 0;
+    for (int i = 0; i < TRIALS; i++)
+    {
+        if (!Run(i))
+        {
+            SDL_Log("Failed light grid trial %d", i);
+            status = 1;
+        }
+    }
+    if (!status)
+    {
+        SDL_Log("Passed %d light grid trials", TRIALS);
+    }
+    return status;
+}
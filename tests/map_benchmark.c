@@ -0,0 +1,96 @@
+#include <SDL3/SDL.h>
+
+#include "map.h"
+#include "world.h"
+
+#define ROUNDS 200
+#define ROWS 2000
+#define KEPT 10
+#define ITERATIONS 50
+
+// mirrors a chunk filling up with lights, being relit, then mostly cleared
+static int Iterate(const Map* map)
+{
+    int sum = 0;
+    for (int i = 0; i < ITERATIONS; i++)
+    for (Uint32 j = 0; j < map->size; j++)
+    {
+        sum += Map_GetRow(map, j).value;
+    }
+    return sum;
+}
+
+int main(int argc, char** argv)
+{
+    static int positions[ROWS][3];
+    SDL_srand(0);
+    int size = 0;
+    while (size < ROWS)
+    {
+        int x = SDL_rand(CHUNK_WIDTH);
+        int y = SDL_rand(CHUNK_HEIGHT);
+        int z = SDL_rand(CHUNK_WIDTH);
+        bool is_unique = true;
+        for (int i = 0; i < size && is_unique; i++)
+        {
+            is_unique = positions[i][0] != x || positions[i][1] != y || positions[i][2] != z;
+        }
+        if (is_unique)
+        {
+            positions[size][0] = x;
+            positions[size][1] = y;
+            positions[size][2] = z;
+            size++;
+        }
+    }
+    Uint64 set_ns = 0;
+    Uint64 remove_ns = 0;
+    Uint64 iterate_ns = 0;
+    int status = 0;
+    for (int i = 0; i < ROUNDS; i++)
+    {
+        Map map;
+        Map_Init(&map, 8);
+        Uint64 start = SDL_GetTicksNS();
+        for (int j = 0; j < ROWS; j++)
+        {
+            Map_Set(&map, positions[j][0], positions[j][1], positions[j][2], 1 + j % 255);
+        }
+        set_ns += SDL_GetTicksNS() - start;
+        start = SDL_GetTicksNS();
+        int sum = Iterate(&map);
+        iterate_ns += SDL_GetTicksNS() - start;
+        start = SDL_GetTicksNS();
+        for (int j = KEPT; j < ROWS; j++)
+        {
+            Map_Remove(&map, positions[j][0], positions[j][1], positions[j][2]);
+        }
+        remove_ns += SDL_GetTicksNS() - start;
+        start = SDL_GetTicksNS();
+        sum += Iterate(&map);
+        iterate_ns += SDL_GetTicksNS() - start;
+        int expected = 0;
+        for (int j = 0; j < ROWS; j++)
+        {
+            expected += (1 + j % 255) * ITERATIONS * (j < KEPT ? 2 : 1);
+        }
+        if (map.size != KEPT || sum != expected)
+        {
+            SDL_Log("Failed round %d: %d rows and a sum of %d instead of %d", i, map.size, sum, expected);
+            status = 1;
+        }
+        for (int j = 0; j < KEPT; j++)
+        {
+            if (Map_Get(&map, positions[j][0], positions[j][1], positions[j][2]) != 1 + j % 255)
+            {
+                SDL_Log("Failed round %d: lost row %d", i, j);
+                status = 1;
+            }
+        }
+        Map_Free(&map);
+    }
+    SDL_Log("%d rounds of %d rows: set %.2f ms, iterate %.2f ms, remove %.2f ms, total %.2f ms",
+        ROUNDS, ROWS, set_ns / 1000000.0, iterate_ns / 1000000.0, remove_ns / 1000000.0,
+        (set_ns + iterate_ns + remove_ns) / 1000000.0);
+    return status;
+}
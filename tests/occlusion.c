@@ -0,0 +1,224 @@
+#include <SDL3/SDL.h>
+
+#include "camera.h"
+#include "occlusion.h"
+
+#define QUERIES 4000
+#define SAMPLES 8
+
+typedef struct Box
+{
+    float min[3];
+    float max[3];
+} Box;
+
+// a ground slab reaching behind the camera, a wall ahead and a pillar beside the camera,
+// so the ground and the pillar both cross the near plane
+static const Box OCCLUDERS[] =
+{
+    {{-200.0f, -10.0f, -200.0f}, {200.0f, 0.0f, 200.0f}},
+    {{-20.0f, 0.0f, -30.0f}, {20.0f, 20.0f, -28.0f}},
+    {{1.0f, 0.0f, -3.0f}, {2.0f, 10.0f, 3.0f}},
+};
+
+typedef struct Case
+{
+    const char* name;
+    Box box;
+    bool is_visible;
+} Case;
+
+static const Case CASES[] =
+{
+    {"behind the wall", {{-5.0f, 2.0f, -60.0f}, {5.0f, 8.0f, -40.0f}}, false},
+    {"in front of the wall", {{-2.0f, 1.0f, -15.0f}, {2.0f, 3.0f, -10.0f}}, true},
+    {"above the wall", {{-2.0f, 40.0f, -60.0f}, {2.0f, 45.0f, -55.0f}}, true},
+    {"beside the wall", {{-45.0f, 2.0f, -60.0f}, {-40.0f, 6.0f, -55.0f}}, true},
+    {"inside the wall shadow edge", {{-26.0f, 2.0f, -60.0f}, {-18.0f, 6.0f, -50.0f}}, false},
+    {"under the ground", {{-5.0f, -9.0f, -40.0f}, {5.0f, -5.0f, -20.0f}}, false},
+    {"under the ground near the camera", {{-1.0f, -9.0f, -8.0f}, {1.0f, -5.0f, -6.0f}}, false},
+    {"behind the pillar", {{4.0f, 1.0f, -4.0f}, {5.0f, 3.0f, -3.0f}}, false},
+    {"in the sky", {{-5.0f, 10.0f, -25.0f}, {5.0f, 14.0f, -20.0f}}, true},
+    {"across the near plane", {{-0.5f, 1.0f, -1.0f}, {-0.2f, 3.0f, 1.0f}}, true},
+    {"on the ground", {{-1.0f, 0.0f, -20.0f}, {1.0f, 0.25f, -19.0f}}, true},
+};
+
+static const float POSITION[3] = {0.0f, 2.0f, 0.0f};
+static const float PITCH = -0.2f;
+
+static void Transform(const Camera* camera, const float point[3], float clip[4])
+{
+    for (int i = 0; i < 4; i++)
+    {
+        clip[i] = camera->matrix[0][i] * point[0] + camera->matrix[1][i] * point[1] + camera->matrix[2][i] * point[2] + camera->matrix[3][i];
+    }
+}
+
+static bool IsBlocked(const Camera* camera, const float from[3], const float to[3])
+{
+    for (int i = 0; i < SDL_arraysize(OCCLUDERS); i++)
+    {
+        const Box* box = &OCCLUDERS[i];
+        float near = 0.0f;
+        float far = 1.0f;
+        for (int j = 0; j < 3 && near <= far; j++)
+        {
+            float direction = to[j] - from[j];
+            if (SDL_fabsf(direction) < SDL_FLT_EPSILON)
+            {
+                if (from[j] < box->min[j] || from[j] > box->max[j])
+                {
+                    far = -1.0f;
+                }
+                continue;
+            }
+            float t1 = (box->min[j] - from[j]) / direction;
+            float t2 = (box->max[j] - from[j]) / direction;
+            near = SDL_max(near, SDL_min(t1, t2));
+            far = SDL_min(far, SDL_max(t1, t2));
+        }
+        // grazing the occluder or ending on its surface doesn't hide the point
+        if (near >= far || near >= 0.999f)
+        {
+            continue;
+        }
+        // neither does entering it before the near plane, since that face is clipped
+        float entry[3];
+        float clip[4];
+        for (int j = 0; j < 3; j++)
+        {
+            entry[j] = from[j] + (to[j] - from[j]) * near;
+        }
+        Transform(camera, entry, clip);
+        if (clip[2] >= 0.0f)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool IsOnScreen(const Camera* camera, const float point[3])
+{
+    float clip[4];
+    Transform(camera, point, clip);
+    if (clip[3] <= 0.0f || clip[2] < 0.0f || clip[2] > clip[3])
+    {
+        return false;
+    }
+    return SDL_fabsf(clip[0]) <= clip[3] && SDL_fabsf(clip[1]) <= clip[3];
+}
+
+// brute force: a box is visible if a ray from the camera reaches any point sampled on its surface
+static bool IsVisible(const Camera* camera, const Box* box)
+{
+    for (int axis = 0; axis < 3; axis++)
+    for (int side = 0; side < 2; side++)
+    for (int i = 0; i <= SAMPLES; i++)
+    for (int j = 0; j <= SAMPLES; j++)
+    {
+        int u = (axis + 1) % 3;
+        int v = (axis + 2) % 3;
+        float point[3];
+        point[axis] = side ? box->max[axis] : box->min[axis];
+        point[u] = box->min[u] + (box->max[u] - box->min[u]) * i / SAMPLES;
+        point[v] = box->min[v] + (box->max[v] - box->min[v]) * j / SAMPLES;
+        if (IsOnScreen(camera, point) && !IsBlocked(camera, camera->position, point))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void Build(Occlusion* occlusion, Camera* camera, int width, int height)
+{
+    Camera_Init(camera, CAMERA_TYPE_PERSPECTIVE);
+    Camera_Resize(camera, width, height);
+    camera->x = POSITION[0];
+    camera->y = POSITION[1];
+    camera->z = POSITION[2];
+    camera->pitch = PITCH;
+    Camera_Update(camera);
+    Occlusion_Clear(occlusion, camera);
+    for (int i = 0; i < SDL_arraysize(OCCLUDERS); i++)
+    {
+        Occlusion_AddBox(occlusion, OCCLUDERS[i].min, OCCLUDERS[i].max);
+    }
+}
+
+static bool TestCases(const Occlusion* occlusion, const Camera* camera)
+{
+    bool ok = true;
+    for (int i = 0; i < SDL_arraysize(CASES); i++)
+    {
+        const Case* test = &CASES[i];
+        if (IsVisible(camera, &test->box) != test->is_visible)
+        {
+            SDL_Log("Scene disagrees with the %s case", test->name);
+            ok = false;
+            continue;
+        }
+        if (Occlusion_IsVisible(occlusion, test->box.min, test->box.max) != test->is_visible)
+        {
+            SDL_Log("Box %s is %s", test->name, test->is_visible ? "culled" : "drawn");
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// culling a box that any ray reaches is never allowed, keeping a hidden box is only a missed cull
+static bool TestQueries(const Occlusion* occlusion, const Camera* camera)
+{
+    int culled = 0;
+    int hidden = 0;
+    for (int i = 0; i < QUERIES; i++)
+    {
+        Box box;
+        box.min[0] = SDL_randf() * 120.0f - 60.0f;
+        box.min[1] = SDL_randf() * 40.0f - 10.0f;
+        box.min[2] = SDL_randf() * -80.0f - 2.0f;
+        for (int j = 0; j < 3; j++)
+        {
+            box.max[j] = box.min[j] + 0.25f + SDL_randf() * 8.0f;
+        }
+        bool is_visible = IsVisible(camera, &box);
+        if (!is_visible)
+        {
+            hidden++;
+        }
+        if (Occlusion_IsVisible(occlusion, box.min, box.max))
+        {
+            continue;
+        }
+        culled++;
+        if (is_visible)
+        {
+            SDL_Log("Culled visible box (%.2f, %.2f, %.2f) to (%.2f, %.2f, %.2f)",
+                box.min[0], box.min[1], box.min[2], box.max[0], box.max[1], box.max[2]);
+            return false;
+        }
+    }
+    SDL_Log("Culled %d of %d boxes hidden or off screen", culled, hidden);
+    return culled > 0;
+}
+
+int main(int argc, char** argv)
+{
+    static const int SIZES[][2] = {{OCCLUSION_WIDTH, OCCLUSION_HEIGHT}, {1920, 1080}, {1024, 768}};
+    static Occlusion occlusion;
+    SDL_srand(0);
+    int status = 0;
+    for (int i = 0; i < SDL_arraysize(SIZES); i++)
+    {
+        Camera camera;
+        Build(&occlusion, &camera, SIZES[i][0], SIZES[i][1]);
+        if (!TestCases(&occlusion, &camera) || !TestQueries(&occlusion, &camera))
+        {
+            SDL_Log("Failed occlusion at %dx%d", SIZES[i][0], SIZES[i][1]);
+            status = 1;
+        }
+    }
+    return status;
+}
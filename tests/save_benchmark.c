@@ -0,0 +1,118 @@
+#include <SDL3/SDL.h>
+
+#include "block.h"
+#include "save.h"
+#include "world.h"
+
+#define CHUNKS 16
+#define EDITS 512
+
+static const char* DIRECTORY = "save_benchmark/";
+static const char* NAMES[] = {"sqlite", "region"};
+
+typedef struct Result
+{
+    double save_ms;
+    double load_ms;
+    double stall_us;
+    int blocks;
+} Result;
+
+static void SetBlockFunction(void* userdata, int bx, int by, int bz, Block block)
+{
+    int* blocks = userdata;
+    (*blocks)++;
+}
+
+static SDL_EnumerationResult SDLCALL RemoveFunction(void* userdata, const char* dirname, const char* fname)
+{
+    char path[1024] = {0};
+    SDL_snprintf(path, sizeof(path), "%s%s", dirname, fname);
+    SDL_PathInfo info;
+    if (SDL_GetPathInfo(path, &info) && info.type == SDL_PATHTYPE_DIRECTORY)
+    {
+        SDL_EnumerateDirectory(path, RemoveFunction, NULL);
+    }
+    SDL_RemovePath(path);
+    return SDL_ENUM_CONTINUE;
+}
+
+static bool Run(SaveBackend backend, Result* result)
+{
+    char path[1024] = {0};
+    SDL_snprintf(path, sizeof(path), "%s%s/", DIRECTORY, NAMES[backend]);
+    SDL_EnumerateDirectory(path, RemoveFunction, NULL);
+    if (!SDL_CreateDirectory(path))
+    {
+        SDL_Log("Failed to create %s directory: %s", path, SDL_GetError());
+        return false;
+    }
+    // every edit lands on its own cell with a block terrain never has, so compaction keeps them all and the expected count is exact
+    Uint64 start = SDL_GetTicksNS();
+    if (!Save_Init(backend, path))
+    {
+        return false;
+    }
+    // one batch per chunk with a commit after each, like the game does, to time the writer against commits
+    Uint64 stall = 0;
+    for (int i = 0; i < CHUNKS; i++)
+    for (int j = 0; j < CHUNKS; j++)
+    {
+        Uint64 batch = SDL_GetTicksNS();
+        Save_BeginBatch();
+        for (int k = 0; k < EDITS; k++)
+        {
+            int cx = i * CHUNK_WIDTH;
+            int cz = j * CHUNK_WIDTH;
+            int bx = cx + k % CHUNK_WIDTH;
+            int by = 64 + k / CHUNK_WIDTH;
+            int bz = cz + (k * 7) % CHUNK_WIDTH;
+            Save_SetBlock(cx, cz, bx, by, bz, BLOCK_PLANKS);
+        }
+        Save_EndBatch();
+        stall = SDL_max(stall, SDL_GetTicksNS() - batch);
+        Save_Commit();
+    }
+    Save_Free();
+    result->stall_us = stall / 1000.0;
+    result->save_ms = (SDL_GetTicksNS() - start) / 1000000.0;
+    start = SDL_GetTicksNS();
+    if (!Save_Init(backend, path))
+    {
+        return false;
+    }
+    result->blocks = 0;
+    for (int i = 0; i < CHUNKS; i++)
+    for (int j = 0; j < CHUNKS; j++)
+    {
+        Save_GetBlocks(&result->blocks, i * CHUNK_WIDTH, j * CHUNK_WIDTH, SetBlockFunction);
+    }
+    Save_Free();
+    result->load_ms = (SDL_GetTicksNS() - start) / 1000000.0;
+    return result->blocks == CHUNKS * CHUNKS * EDITS;
+}
+
+int main(int argc, char** argv)
+{
+    if (!SDL_CreateDirectory(DIRECTORY))
+    {
+        SDL_Log("Failed to create %s directory: %s", DIRECTORY, SDL_GetError());
+        return 1;
+    }
+    int status = 0;
+    for (int i = 0; i < SDL_arraysize(NAMES); i++)
+    {
+        Result result;
+        if (!Run(i, &result))
+        {
+            SDL_Log("Failed to run %s benchmark", NAMES[i]);
+            status = 1;
+            continue;
+        }
+        double blocks = CHUNKS * CHUNKS * EDITS;
+        SDL_Log("%s: saved %d blocks in %.2f ms (%.0f blocks/s), loaded in %.2f ms (%.0f blocks/s), longest batch of %d edits %.0f us",
+            NAMES[i], result.blocks, result.save_ms, blocks / result.save_ms * 1000.0,
+            result.load_ms, blocks / result.load_ms * 1000.0, EDITS, result.stall_us);
+    }
+    return status;
+}